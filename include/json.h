@@ -2,6 +2,7 @@
 #define JSON_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #define JSON_INVALID 0
 #define JSON_FALSE   1
@@ -12,24 +13,255 @@
 #define JSON_ARRAY   32
 #define JSON_OBJECT  64
 
+#define JSON_PRINT_COMPACT 0
+#define JSON_PRINT_PRETTY  1
+
+// Deepest nesting accepted by the scanner and the writer
+#define JSON_MAX_DEPTH 1024
+
+// Tokens returned by json_scanner_next
+#define JSON_TOKEN_INCOMPLETE   (-2)
+#define JSON_TOKEN_ERROR        (-1)
+#define JSON_TOKEN_END          0
+#define JSON_TOKEN_OBJECT_BEGIN 1
+#define JSON_TOKEN_OBJECT_END   2
+#define JSON_TOKEN_ARRAY_BEGIN  3
+#define JSON_TOKEN_ARRAY_END    4
+#define JSON_TOKEN_KEY          5
+#define JSON_TOKEN_STRING       6
+#define JSON_TOKEN_NUMBER       7
+#define JSON_TOKEN_TRUE         8
+#define JSON_TOKEN_FALSE        9
+#define JSON_TOKEN_NULL         10
+
+// Room needed by the number formatters, including the NUL terminator
+#define JSON_NUMBER_BUFFER_SIZE 32
+
+// Output sink for streaming writers; returns 0 on success, -1 on failure
+typedef int (*json_write_fn)(void *ctx, const char *data, size_t len);
+
+typedef struct json_writer json_writer_t;
+typedef struct json_document json_document_t;
+typedef struct json_arena json_arena_t;
+
+// Pull scanner over a text buffer. Each token's raw text (strings and keys
+// including their quotes) is at token/token_length; pos is the error
+// position after JSON_TOKEN_ERROR. The other fields are private.
+//
+// For input arriving in blocks, pass each block to json_scanner_feed. A
+// token cut off by the end of a non-last block yields JSON_TOKEN_INCOMPLETE
+// without being consumed: carry json[pos..length) over to the front of the
+// next block.
+typedef struct {
+    const char *json;
+    size_t pos;
+    size_t length;
+    const char *token;
+    size_t token_length;
+    int partial;
+    int state;
+    int depth;
+    unsigned char stack[JSON_MAX_DEPTH / 8];
+} json_scanner_t;
+
+// Read-only value inside a binary document (see json_save_binary). Only
+// type is public; views are small and meant to be copied.
+typedef struct {
+    int type;
+    int flags;
+    size_t count;
+    uint64_t payload;
+    const unsigned char *base;
+    size_t nodes_end;
+    const unsigned char *strings;
+    size_t strings_size;
+} json_view_t;
+
+// Children of a container are linked through next, head to tail and
+// ending in NULL, and back through prev; the head's prev is the tail
 typedef struct json {
     struct json *next;      
     struct json *prev;      
     struct json *child;     
     int type;             
+    uint32_t hash;          // Cached by json_hash; 0 until computed
     char *valuestring;     
     double valuenumber;     
     char *string;          
 } json_t;
 
+// Allocator for library memory; ctx is passed back on every call and all
+// three functions are required
+typedef struct {
+    void* (*malloc_fn)(void *ctx, size_t size);
+    void* (*realloc_fn)(void *ctx, void *ptr, size_t size);
+    void (*free_fn)(void *ctx, void *ptr);
+    void *ctx;
+} json_allocator_t;
+
+// Filled in by json_parse_ex when options->stats is set. Type counts,
+// string bytes and depth describe the finished tree, so they stay zero
+// when the parse fails; allocations and timings cover the attempt either
+// way. Set timing before the call to also time the phases: it adds a
+// clock read around every string copy and number conversion.
+typedef struct {
+    int timing;                 // In: nonzero to fill the *_ns fields
+    size_t objects;
+    size_t arrays;
+    size_t strings;
+    size_t numbers;
+    size_t booleans;
+    size_t nulls;
+    size_t keys;
+    size_t string_bytes;        // Decoded bytes of string values and keys
+    int max_depth;              // Deepest container nesting; 0 for a scalar
+    size_t allocations;         // malloc and realloc calls
+    size_t allocated_bytes;
+    uint64_t total_ns;
+    uint64_t scan_ns;           // Structure and whitespace: the remainder
+    uint64_t string_ns;         // Copying and unescaping strings
+    uint64_t number_ns;         // Converting numbers
+} json_parse_stats_t;
+
+typedef struct {
+    const json_allocator_t *allocator;  // NULL selects the global allocator
+    json_parse_stats_t *stats;          // NULL skips all bookkeeping
+    int hash;                           // Nonzero to fill in json_hash as values are built
+} json_parse_options_t;
+
+// Parse one value with the grammar json_validate checks: whitespace may
+// surround it, but trailing content, leading zeros and malformed UTF-8
+// make the parse fail and return NULL
 json_t* json_parse(const char *text);
+json_t* json_parse_length(const char *text, size_t length);
 void json_delete(json_t *json);
 char* json_print(const json_t *json);
+char* json_print_compact(const json_t *json);
+
+// Replace the global allocator used by json_parse, json_delete, the
+// printers and the writer (NULL restores malloc/realloc/free). The
+// struct is copied. Not thread-safe: set it before creating any tree.
+void json_set_allocator(const json_allocator_t *allocator);
+// Parse with per-call options. A tree built with options->allocator must
+// be released by json_delete_ex with the same allocator.
+json_t* json_parse_ex(const char *text, size_t length, const json_parse_options_t *options);
+void json_delete_ex(json_t *json, const json_allocator_t *allocator);
+// Release text returned by json_print and json_print_compact
+void json_free(void *ptr);
+
+// Documents keep the source span of every value for editors that re-parse
+// as the text changes. After old_len bytes of text are replaced, starting
+// at edit_start, by new_len bytes, json_reparse_range re-parses only the
+// innermost value whose span holds the edit, widening to its enclosing
+// containers while the new text there is not a single value, and splices
+// the result into the tree. Nodes outside the re-parsed value are kept, so
+// pointers into them stay valid. text is the whole new text.
+//
+// On failure (the text no longer parses) the root stays the last tree that
+// did, and the next call parses the whole text. Document trees use the
+// global allocator and must not be changed or freed other than through
+// these functions.
+json_document_t* json_document_parse(const char *text, size_t length);
+int json_reparse_range(json_document_t *doc, const char *text, size_t edit_start,
+                       size_t old_len, size_t new_len);
+json_t* json_document_root(const json_document_t *doc);
+// Innermost value whose span holds offset, with that span; NULL if none
+// or while the last reparse failed. Spans cover values, not keys.
+json_t* json_document_at(const json_document_t *doc, size_t offset, size_t *start, size_t *length);
+void json_document_free(json_document_t *doc);
+// Print into caller memory without allocating; returns the length written
+// (excluding the NUL terminator), or 0 if it did not fit in cap bytes
+size_t json_print_buffered(const json_t *json, char *buf, size_t cap, int format);
+
+void json_scanner_init(json_scanner_t *s, const char *json, size_t length);
+void json_scanner_feed(json_scanner_t *s, const char *json, size_t length, int last);
+int json_scanner_next(json_scanner_t *s);
+
+// Check grammar and UTF-8 in one pass without allocating; returns 1 if valid
+int json_validate(const char *json, size_t length);
+
+// Streaming writer. Output goes through a fixed buffer of buffer_size bytes
+// that is flushed to the callback (or fd) when full; call json_writer_flush
+// before json_writer_free. Calls return 0 on success and -1 once an error
+// occurred; debug builds also reject structurally invalid call sequences.
+json_writer_t* json_writer_new(json_write_fn write, void *ctx, size_t buffer_size, int format);
+json_writer_t* json_writer_new_fd(int fd, size_t buffer_size, int format);
+int json_writer_flush(json_writer_t *w);
+void json_writer_free(json_writer_t *w);
+
+int json_writer_begin_object(json_writer_t *w);
+int json_writer_end_object(json_writer_t *w);
+int json_writer_begin_array(json_writer_t *w);
+int json_writer_end_array(json_writer_t *w);
+int json_writer_key(json_writer_t *w, const char *key);
+int json_writer_string(json_writer_t *w, const char *str);
+int json_writer_string_len(json_writer_t *w, const char *str, size_t len);
+int json_writer_number(json_writer_t *w, double value);
+int json_writer_integer(json_writer_t *w, long long value);
+int json_writer_bool(json_writer_t *w, int value);
+int json_writer_null(json_writer_t *w);
 
 json_t* json_object_get(const json_t *object, const char *key);
 json_t* json_array_get(const json_t *array, int index);
 int json_array_size(const json_t *array);
 
+// Structural hashes and equality. A hash depends only on the value: arrays
+// combine their elements in order, objects their members in any order.
+// json_hash caches the hash in every node of the subtree, so later calls
+// and the unchanged parts of a modified tree cost O(1). The functions
+// below that change a container clear its own hash, but nodes have no
+// parent link: set hash to 0 on its ancestors, or on every changed value
+// when editing by hand, or call json_hash_clear on the root.
+uint32_t json_hash(const json_t *json);
+void json_hash_clear(json_t *json);
+// Deep equality; objects match regardless of member order. Values whose
+// cached hashes differ are rejected without being walked, but equal hashes
+// are always confirmed.
+int json_equal(const json_t *a, const json_t *b);
+
+// Arenas hand out memory from large blocks and release it all at once.
+// block_size 0 selects 64 KiB; larger requests get a block of their own.
+json_arena_t* json_arena_new(size_t block_size);
+void json_arena_free(json_arena_t *arena);
+// Deep copy of json, key included, into one contiguous block: nodes in
+// document order followed by their strings. With an arena the copy lives
+// until json_arena_free; with NULL it comes from the global allocator and
+// is released by json_free(copy), never json_delete. NULL if out of memory.
+json_t* json_duplicate(const json_t *json, json_arena_t *arena);
+
+// Building and changing trees. arena is where the tree lives: new nodes
+// and keys are allocated there, or from the global allocator when NULL.
+// Values replaced or removed are freed with json_delete unless the tree
+// lives in an arena. Arena trees must never be passed to json_delete, and
+// the two kinds must not be mixed in one tree. Creators return NULL when
+// out of memory; the rest return 0, or -1 if the container has the wrong
+// type, the index or key is missing, the new value is already in a
+// container (detach it first), or the container is the new value or
+// inside it (which would make a cycle).
+json_t* json_create_null(json_arena_t *arena);
+json_t* json_create_bool(int value, json_arena_t *arena);
+json_t* json_create_number(double value, json_arena_t *arena);
+json_t* json_create_string(const char *value, json_arena_t *arena);
+json_t* json_create_array(json_arena_t *arena);
+json_t* json_create_object(json_arena_t *arena);
+// O(1) through the tail link
+int json_array_append(json_t *array, json_t *item);
+// O(1); no check for an existing member with the same key
+int json_object_add(json_t *object, const char *key, json_t *value, json_arena_t *arena);
+// Replaces the first member with that key in place, or adds one
+int json_object_set(json_t *object, const char *key, json_t *value, json_arena_t *arena);
+int json_array_replace(json_t *array, int index, json_t *item, json_arena_t *arena);
+int json_array_remove(json_t *array, int index, json_arena_t *arena);
+int json_object_remove(json_t *object, const char *key, json_arena_t *arena);
+// Unlink and return a value, which the caller then owns; NULL if missing
+json_t* json_array_detach(json_t *array, int index);
+json_t* json_object_detach(json_t *object, const char *key);
+
+// Shortest text that reads back to the same double ("null" for NaN and
+// infinity) and plain integer formatting; both return the length written
+int json_format_double(double value, char *buf);
+int json_format_integer(long long value, char *buf);
+
 int json_is_false(const json_t *json);
 int json_is_true(const json_t *json);
 int json_is_bool(const json_t *json);
@@ -39,4 +271,39 @@ int json_is_string(const json_t *json);
 int json_is_array(const json_t *json);
 int json_is_object(const json_t *json);
 
+// Binary documents. json_save_binary encodes a tree as a position-
+// independent image: fixed-size value records addressed by offsets from
+// the start of the image, arrays of numbers packed as doubles, and each
+// distinct string stored once in a trailing string table. The image is
+// read in place through json_view_t, for example straight from mmap, so
+// loading costs only the pages that are touched. Images use the host
+// byte order and are rejected by hosts that differ. Returns 0 or -1.
+int json_save_binary(const json_t *json, json_write_fn write, void *ctx);
+// Check an image's header and view its root. Records are bounds-checked
+// as they are visited, so a corrupt image makes lookups fail instead of
+// reading outside it. data must be 8-byte aligned and outlive the views.
+int json_load_binary(const void *data, size_t length, json_view_t *root);
+// Members or elements of a container, 0 for anything else
+size_t json_view_size(const json_view_t *view);
+int json_view_array_get(const json_view_t *array, size_t index, json_view_t *out);
+int json_view_object_get(const json_view_t *object, const char *key, json_view_t *out);
+// Member by position, for iteration; *key points into the image
+int json_view_member(const json_view_t *object, size_t index, const char **key, json_view_t *out);
+// NUL-terminated string in the image, or NULL if view is not a string
+const char* json_view_string(const json_view_t *view, size_t *length);
+double json_view_number(const json_view_t *view);
+
+// Transcoding between JSON text and MessagePack or CBOR without building a
+// tree. Integers that fit 64 bits keep an integer encoding and other
+// numbers become doubles. Invalid input produces no output from the
+// json_to_* functions; json_from_* reject binary values with no JSON form
+// (byte strings, extension types, non-string keys, text that is not
+// UTF-8) and trailing bytes, and may have written part of the text by
+// then. CBOR tags are dropped; open-ended CBOR text is joined.
+// format is JSON_PRINT_COMPACT or JSON_PRINT_PRETTY. All return 0 or -1.
+int json_to_msgpack(const char *json, size_t length, json_write_fn write, void *ctx);
+int json_to_cbor(const char *json, size_t length, json_write_fn write, void *ctx);
+int json_from_msgpack(const void *data, size_t length, json_write_fn write, void *ctx, int format);
+int json_from_cbor(const void *data, size_t length, json_write_fn write, void *ctx, int format);
+
 #endif
\ No newline at end of file
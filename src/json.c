@@ -1,15 +1,54 @@
 // src/json.c
+#define _POSIX_C_SOURCE 200809L
 #include "json.h"
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Children of wide containers in a document are indexed in blocks, so an
+// edit neither walks nor renumbers more than one block of siblings
+#define SPAN_BLOCK 64
+
+typedef struct {
+    json_t *first;  // First child in the block
+    size_t shift;   // Added to the offset of every child in the block
+} span_block_t;
+
+typedef struct {
+    size_t count;
+    span_block_t blocks[];
+} span_index_t;
+
+// Nodes of a document tree (json_document_parse) carry the source span
+// of their value behind the json_t
+typedef struct {
+    json_t node;
+    size_t offset;          // From the parent's start; from the text start for the root
+    size_t length;
+    span_index_t *index;    // Containers with more than SPAN_BLOCK children
+} span_node_t;
 
 // Parsing context (tracks position in JSON string)
 typedef struct {
     const char *json;
     size_t pos;
     size_t length;
+    const json_allocator_t *alloc;
+    json_parse_stats_t *timing;  // Set only when phase timing was requested
+    int spans;                   // Allocate span_node_t and record spans
+    int hash;                    // Hash each value once it is complete
+    int depth;                   // Containers open around the position
 } parse_context_t;
 
 // Forward declarations for recursive parsing
@@ -18,20 +57,72 @@ static json_t* parse_object(parse_context_t *ctx);
 static json_t* parse_array(parse_context_t *ctx);
 static json_t* parse_string(parse_context_t *ctx);
 static json_t* parse_number(parse_context_t *ctx);
+static uint32_t hash_node(const json_t *json);
+
+// Default allocator: the C library
+static void* system_malloc(void *ctx, size_t size) {
+    (void)ctx;
+    return malloc(size);
+}
+
+static void* system_realloc(void *ctx, void *ptr, size_t size) {
+    (void)ctx;
+    return realloc(ptr, size);
+}
+
+static void system_free(void *ctx, void *ptr) {
+    (void)ctx;
+    free(ptr);
+}
+
+static const json_allocator_t system_allocator = { system_malloc, system_realloc, system_free, NULL };
+static json_allocator_t global_allocator = { system_malloc, system_realloc, system_free, NULL };
+
+void json_set_allocator(const json_allocator_t *allocator) {
+    global_allocator = allocator ? *allocator : system_allocator;
+}
+
+static void* mem_alloc(const json_allocator_t *a, size_t size) {
+    return a->malloc_fn(a->ctx, size);
+}
+
+static void mem_free(const json_allocator_t *a, void *ptr) {
+    if (ptr) a->free_fn(a->ctx, ptr);
+}
+
+void json_free(void *ptr) {
+    mem_free(&global_allocator, ptr);
+}
+
+static void delete_tree(json_t *json, const json_allocator_t *a);
+
+static uint64_t clock_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
 
 // Memory management helpers
-static json_t* json_new(void) {
-    json_t *item = malloc(sizeof(json_t));
+static json_t* json_new(const parse_context_t *ctx) {
+    size_t size = ctx->spans ? sizeof(span_node_t) : sizeof(json_t);
+    json_t *item = mem_alloc(ctx->alloc, size);
     if (item) {
-        memset(item, 0, sizeof(json_t));  // Zero out all fields
+        memset(item, 0, size);  // Zero out all fields
     }
     return item;
 }
 
+static span_node_t* span_of(const json_t *json) {
+    return (span_node_t *)json;
+}
+
 // Skip whitespace in JSON
+static int is_json_space(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
 static void skip_whitespace(parse_context_t *ctx) {
-    while (ctx->pos < ctx->length && 
-           isspace(ctx->json[ctx->pos])) {
+    while (ctx->pos < ctx->length && is_json_space(ctx->json[ctx->pos])) {
         ctx->pos++;
     }
 }
@@ -50,35 +141,319 @@ static char next_char(parse_context_t *ctx) {
     return ctx->json[ctx->pos++];
 }
 
+// Escape class of every byte: 0 = copy verbatim, 'u' = \u00XX, else the
+// character that follows the backslash
+static const char escape_table[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+};
+
+#if defined(__SSE2__)
+static inline __m128i bytes_at_least(__m128i x, unsigned char k) {
+    return _mm_cmpeq_epi8(_mm_max_epu8(x, _mm_set1_epi8((char)k)), x);
+}
+
+static inline __m128i bytes_at_most(__m128i x, unsigned char k) {
+    return _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8((char)k)), x);
+}
+
+static inline __m128i bytes_equal(__m128i x, unsigned char k) {
+    return _mm_cmpeq_epi8(x, _mm_set1_epi8((char)k));
+}
+
+// Bytes of chunk that break UTF-8, given the 16 bytes before it: a
+// continuation byte out of place or missing, bytes UTF-8 never uses, and
+// second bytes that make a sequence overlong, a surrogate or too large
+static inline unsigned utf8_errors(__m128i chunk, __m128i before) {
+    __m128i prev1 = _mm_or_si128(_mm_slli_si128(chunk, 1), _mm_srli_si128(before, 15));
+    __m128i prev2 = _mm_or_si128(_mm_slli_si128(chunk, 2), _mm_srli_si128(before, 14));
+    __m128i prev3 = _mm_or_si128(_mm_slli_si128(chunk, 3), _mm_srli_si128(before, 13));
+    
+    __m128i is_cont = _mm_cmplt_epi8(chunk, _mm_set1_epi8((char)0xC0));  // Signed: 0x80..0xBF
+    __m128i needs_cont = _mm_or_si128(_mm_or_si128(bytes_at_least(prev1, 0xC0), bytes_at_least(prev2, 0xE0)),
+                                      bytes_at_least(prev3, 0xF0));
+    __m128i errors = _mm_xor_si128(is_cont, needs_cont);
+    
+    errors = _mm_or_si128(errors, bytes_equal(_mm_and_si128(chunk, _mm_set1_epi8((char)0xFE)), 0xC0));
+    errors = _mm_or_si128(errors, bytes_at_least(chunk, 0xF5));
+    errors = _mm_or_si128(errors, _mm_and_si128(bytes_equal(prev1, 0xE0), bytes_at_most(chunk, 0x9F)));
+    errors = _mm_or_si128(errors, _mm_and_si128(bytes_equal(prev1, 0xED), bytes_at_least(chunk, 0xA0)));
+    errors = _mm_or_si128(errors, _mm_and_si128(bytes_equal(prev1, 0xF0), bytes_at_most(chunk, 0x8F)));
+    errors = _mm_or_si128(errors, _mm_and_si128(bytes_equal(prev1, 0xF4), bytes_at_least(chunk, 0x90)));
+    return (unsigned)_mm_movemask_epi8(errors);
+}
+#endif
+
+// Find the first byte at or after s that a JSON string cannot hold
+// verbatim ('"', '\\' or a control character), or end if there is none.
+// Clean runs are skipped a whole vector at a time. With validate set,
+// the 16-byte loop also checks UTF-8 and returns NULL if it is
+// malformed; bytes >= 0x80 past the last full vector stop the scan so
+// the caller can check them.
+static inline const char* scan_string_bytes(const char *s, const char *end, int validate) {
+#if defined(__AVX2__)
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1F);
+    while (end - s >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)s);
+        __m256i special = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash)),
+            _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, control), control));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(special);
+        if (validate && _mm256_movemask_epi8(chunk)) break;  // Non-ASCII: validated below
+        if (mask) return s + __builtin_ctz(mask);
+        s += 32;
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i quote16 = _mm_set1_epi8('"');
+    const __m128i backslash16 = _mm_set1_epi8('\\');
+    const __m128i control16 = _mm_set1_epi8(0x1F);
+    __m128i before = _mm_setzero_si128();
+    unsigned before_high = 0;
+    while (end - s >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)s);
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote16), _mm_cmpeq_epi8(chunk, backslash16)),
+            _mm_cmpeq_epi8(_mm_max_epu8(chunk, control16), control16));
+        unsigned mask = (unsigned)_mm_movemask_epi8(special);
+        if (validate) {
+            unsigned high = (unsigned)_mm_movemask_epi8(chunk);
+            if (high | before_high) {
+                unsigned errors = utf8_errors(chunk, before);
+                // Up to the stop, which also catches a sequence it cuts short
+                if (mask) errors &= (2u << __builtin_ctz(mask)) - 1;
+                if (errors) return NULL;
+            }
+            before = chunk;
+            before_high = high;
+        }
+        if (mask) return s + __builtin_ctz(mask);
+        s += 16;
+    }
+    // Hand a sequence cut by the last vector to the caller's check
+    if (before_high) {
+        if ((unsigned char)s[-1] >= 0xC0) s -= 1;
+        else if ((unsigned char)s[-2] >= 0xE0) s -= 2;
+        else if ((unsigned char)s[-3] >= 0xF0) s -= 3;
+    }
+#endif
+    // Scalar fallback, and the tail shorter than one vector
+    while (s < end && !escape_table[(unsigned char)*s] &&
+           !(validate && (unsigned char)*s >= 0x80)) {
+        s++;
+    }
+    return s;
+}
+
+static const char* scan_plain(const char *s, const char *end) {
+    return scan_string_bytes(s, end, 0);
+}
+
+// UTF-8 automaton (after Hoehrmann): the first 256 entries give each
+// byte's class, the rest the next state for state + class. Overlong
+// forms, surrogates and code points above U+10FFFF are rejected.
+#define UTF8_ACCEPT 0
+#define UTF8_REJECT 12
+static const unsigned char utf8_dfa[256 + 108] = {
+    // Byte classes
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,
+    7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7, 7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
+    8,8,2,2,2,2,2,2,2,2,2,2,2,2,2,2, 2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+    10,3,3,3,3,3,3,3,3,3,3,3,3,4,3,3, 11,6,6,6,5,8,8,8,8,8,8,8,8,8,8,8,
+    // Transitions: state + class
+    0,12,24,36,60,96,84,12,12,12,48,72, 12,12,12,12,12,12,12,12,12,12,12,12,
+    12,0,12,12,12,12,12,0,12,0,12,12, 12,24,12,12,12,12,12,24,12,24,12,12,
+    12,12,12,12,12,12,12,24,12,12,12,12, 12,24,12,12,12,12,12,12,12,24,12,12,
+    12,12,12,12,12,12,12,36,12,36,12,12, 12,36,12,12,12,12,12,36,12,36,12,12,
+    12,36,12,12,12,12,12,12,12,12,12,12,
+};
+
+// Validate the text from p, which starts a multi-byte sequence, up to
+// the first byte a string cannot hold verbatim or malformed input. Used
+// for the tail the vector loop leaves, so one lookup per byte is fine.
+// *state is UTF8_ACCEPT when it stops between characters, UTF8_REJECT on
+// malformed input, and otherwise means the text ended mid-sequence.
+static const char* scan_utf8_run(const char *p, const char *end, unsigned *state) {
+    unsigned st = UTF8_ACCEPT;
+    
+    for (; p < end; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c < 0x80 && st == UTF8_ACCEPT) {
+            if (escape_table[c]) break;
+            continue;
+        }
+        st = utf8_dfa[256 + st + utf8_dfa[c]];
+        if (st == UTF8_REJECT) break;
+    }
+    *state = st;
+    return p;
+}
+
+// Append a code point to a UTF-8 buffer, returns bytes written
+static size_t encode_utf8(unsigned int cp, char *out) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// Parse the four hex digits of a \u escape, returns -1 if invalid
+static long parse_hex4(const char *p) {
+    long value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+        else return -1;
+    }
+    return value;
+}
+
+// Decode the escaped string body in[0..len) into out, returns decoded length
+// or (size_t)-1 on a malformed escape. out must hold at least len bytes.
+static size_t decode_string(const char *in, size_t len, char *out) {
+    size_t i = 0, o = 0;
+    
+    while (i < len) {
+        // Copy the run up to the next escape in one go
+        const char *esc = memchr(&in[i], '\\', len - i);
+        size_t run = esc ? (size_t)(esc - &in[i]) : len - i;
+        memcpy(&out[o], &in[i], run);
+        i += run;
+        o += run;
+        if (!esc) break;
+        
+        if (i + 1 >= len) return (size_t)-1;
+        char c = in[i + 1];
+        i += 2;
+        switch (c) {
+            case '"':  out[o++] = '"';  break;
+            case '\\': out[o++] = '\\'; break;
+            case '/':  out[o++] = '/';  break;
+            case 'b':  out[o++] = '\b'; break;
+            case 'f':  out[o++] = '\f'; break;
+            case 'n':  out[o++] = '\n'; break;
+            case 'r':  out[o++] = '\r'; break;
+            case 't':  out[o++] = '\t'; break;
+            case 'u': {
+                if (i + 4 > len) return (size_t)-1;
+                long cp = parse_hex4(&in[i]);
+                if (cp < 0) return (size_t)-1;
+                i += 4;
+                
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    // High surrogate must be followed by a low surrogate
+                    if (i + 6 > len || in[i] != '\\' || in[i + 1] != 'u') return (size_t)-1;
+                    long lo = parse_hex4(&in[i + 2]);
+                    if (lo < 0xDC00 || lo > 0xDFFF) return (size_t)-1;
+                    i += 6;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    return (size_t)-1;  // Lone low surrogate
+                }
+                
+                // A \uXXXX escape is 6 bytes and never encodes to more than that
+                o += encode_utf8((unsigned int)cp, &out[o]);
+                break;
+            }
+            default:
+                return (size_t)-1;
+        }
+    }
+    
+    return o;
+}
+
 // Parse a JSON string value
 static json_t* parse_string(parse_context_t *ctx) {
     if (next_char(ctx) != '"') return NULL;  // Must start with quote
     
     size_t start = ctx->pos;
+    int has_escapes = 0;
     
-    // Find closing quote (simplified - no escape handling yet)
-    while (ctx->pos < ctx->length && ctx->json[ctx->pos] != '"') {
+    // Find closing quote, stepping over escape sequences and checking
+    // UTF-8 as json_validate does
+    const char *end = ctx->json + ctx->length;
+    while (ctx->pos < ctx->length) {
+        const char *p = scan_string_bytes(&ctx->json[ctx->pos], end, 1);
+        if (!p) return NULL;  // Malformed UTF-8
+        ctx->pos = (size_t)(p - ctx->json);
+        if (ctx->pos >= ctx->length) break;
+        
+        unsigned char c = (unsigned char)ctx->json[ctx->pos];
+        if (c == '"') break;
+        if (c >= 0x80) {
+            unsigned state;
+            p = scan_utf8_run(p, end, &state);
+            if (state != UTF8_ACCEPT) return NULL;  // Malformed or cut short
+            ctx->pos = (size_t)(p - ctx->json);
+            continue;
+        }
+        if (c < 0x20) return NULL;  // Control characters must be escaped
+        if (c == '\\') {
+            has_escapes = 1;
+            ctx->pos++;
+        }
         ctx->pos++;
     }
     
     if (ctx->pos >= ctx->length) return NULL;  // Unclosed string
     
     // Create JSON string node
-    json_t *item = json_new();
+    json_t *item = json_new(ctx);
     if (!item) return NULL;
     
     item->type = JSON_STRING;
     
-    // Copy string value
+    // Copy string value, decoding escapes if there are any
+    uint64_t started = ctx->timing ? clock_ns() : 0;
     size_t len = ctx->pos - start;
-    item->valuestring = malloc(len + 1);
+    item->valuestring = mem_alloc(ctx->alloc, len + 1);
     if (!item->valuestring) {
-        free(item);
+        mem_free(ctx->alloc, item);
         return NULL;
     }
     
-    strncpy(item->valuestring, &ctx->json[start], len);
+    if (has_escapes) {
+        len = decode_string(&ctx->json[start], len, item->valuestring);
+        if (len == (size_t)-1) {
+            mem_free(ctx->alloc, item->valuestring);
+            mem_free(ctx->alloc, item);
+            return NULL;
+        }
+    } else {
+        memcpy(item->valuestring, &ctx->json[start], len);
+    }
     item->valuestring[len] = '\0';
+    if (ctx->timing) ctx->timing->string_ns += clock_ns() - started;
     
     ctx->pos++;  // Skip closing quote
     return item;
@@ -89,67 +464,96 @@ static json_t* parse_number(parse_context_t *ctx) {
     size_t start = ctx->pos;
     
     // Handle negative
-    if (ctx->json[ctx->pos] == '-') {
+    if (ctx->pos < ctx->length && ctx->json[ctx->pos] == '-') {
         ctx->pos++;
     }
     
-    // Parse integer part
-    if (!isdigit(ctx->json[ctx->pos])) return NULL;
+    // Parse integer part; a leading zero stands alone
+    if (ctx->pos >= ctx->length || !isdigit((unsigned char)ctx->json[ctx->pos])) return NULL;
     
-    while (ctx->pos < ctx->length && isdigit(ctx->json[ctx->pos])) {
+    if (ctx->json[ctx->pos] == '0') {
+        ctx->pos++;
+        if (ctx->pos < ctx->length && isdigit((unsigned char)ctx->json[ctx->pos])) return NULL;
+    }
+    while (ctx->pos < ctx->length && isdigit((unsigned char)ctx->json[ctx->pos])) {
         ctx->pos++;
     }
     
-    // Handle decimal part (simplified)
+    // Handle decimal part
     if (ctx->pos < ctx->length && ctx->json[ctx->pos] == '.') {
         ctx->pos++;
-        while (ctx->pos < ctx->length && isdigit(ctx->json[ctx->pos])) {
+        if (ctx->pos >= ctx->length || !isdigit((unsigned char)ctx->json[ctx->pos])) return NULL;
+        while (ctx->pos < ctx->length && isdigit((unsigned char)ctx->json[ctx->pos])) {
+            ctx->pos++;
+        }
+    }
+    
+    // Handle exponent part
+    if (ctx->pos < ctx->length && (ctx->json[ctx->pos] == 'e' || ctx->json[ctx->pos] == 'E')) {
+        ctx->pos++;
+        if (ctx->pos < ctx->length && (ctx->json[ctx->pos] == '+' || ctx->json[ctx->pos] == '-')) {
+            ctx->pos++;
+        }
+        if (ctx->pos >= ctx->length || !isdigit((unsigned char)ctx->json[ctx->pos])) return NULL;
+        while (ctx->pos < ctx->length && isdigit((unsigned char)ctx->json[ctx->pos])) {
             ctx->pos++;
         }
     }
     
     // Create JSON number node
-    json_t *item = json_new();
+    json_t *item = json_new(ctx);
     if (!item) return NULL;
     
     item->type = JSON_NUMBER;
     
-    // Copy number string and convert to double
+    // Copy number string and convert to double; short numbers avoid the heap
+    uint64_t started = ctx->timing ? clock_ns() : 0;
     size_t len = ctx->pos - start;
-    char *number_str = malloc(len + 1);
-    if (!number_str) {
-        free(item);
-        return NULL;
+    char local[64];
+    char *number_str = local;
+    if (len >= sizeof(local)) {
+        number_str = mem_alloc(ctx->alloc, len + 1);
+        if (!number_str) {
+            mem_free(ctx->alloc, item);
+            return NULL;
+        }
     }
     
-    strncpy(number_str, &ctx->json[start], len);
+    memcpy(number_str, &ctx->json[start], len);
     number_str[len] = '\0';
     
-    item->valuenumber = atof(number_str);
-    free(number_str);  // Clean up temporary string
+    item->valuenumber = strtod(number_str, NULL);
+    if (number_str != local) mem_free(ctx->alloc, number_str);  // Clean up temporary string
+    if (ctx->timing) ctx->timing->number_ns += clock_ns() - started;
     
     return item;
 }
 
+// Does the input at the current position start with the given word?
+static int match_word(parse_context_t *ctx, const char *word, size_t len) {
+    return ctx->length - ctx->pos >= len &&
+           memcmp(&ctx->json[ctx->pos], word, len) == 0;
+}
+
 // Parse JSON literals (true, false, null)
 static json_t* parse_literal(parse_context_t *ctx) {
-    if (strncmp(&ctx->json[ctx->pos], "true", 4) == 0) {
+    if (match_word(ctx, "true", 4)) {
         ctx->pos += 4;
-        json_t *item = json_new();
+        json_t *item = json_new(ctx);
         if (item) item->type = JSON_TRUE;
         return item;
     }
     
-    if (strncmp(&ctx->json[ctx->pos], "false", 5) == 0) {
+    if (match_word(ctx, "false", 5)) {
         ctx->pos += 5;
-        json_t *item = json_new();
+        json_t *item = json_new(ctx);
         if (item) item->type = JSON_FALSE;
         return item;
     }
     
-    if (strncmp(&ctx->json[ctx->pos], "null", 4) == 0) {
+    if (match_word(ctx, "null", 4)) {
         ctx->pos += 4;
-        json_t *item = json_new();
+        json_t *item = json_new(ctx);
         if (item) item->type = JSON_NULL;
         return item;
     }
@@ -160,27 +564,43 @@ static json_t* parse_literal(parse_context_t *ctx) {
 // Main value parser (dispatches to specific parsers)
 static json_t* parse_value(parse_context_t *ctx) {
     char c = peek_char(ctx);
+    size_t start = ctx->pos;
+    json_t *item;
     
     switch (c) {
-        case '"':  return parse_string(ctx);
-        case '{':  return parse_object(ctx);
-        case '[':  return parse_array(ctx);
+        case '"':  item = parse_string(ctx); break;
+        case '{':
+        case '[':
+            // The same bound as json_validate, and it keeps the recursion
+            // off the end of the stack
+            if (ctx->depth >= JSON_MAX_DEPTH) return NULL;
+            ctx->depth++;
+            item = c == '{' ? parse_object(ctx) : parse_array(ctx);
+            ctx->depth--;
+            break;
         case 't':
         case 'f':
-        case 'n':  return parse_literal(ctx);
+        case 'n':  item = parse_literal(ctx); break;
         default:
-            if (c == '-' || isdigit(c)) {
-                return parse_number(ctx);
-            }
-            return NULL;  // Invalid character
+            if (c != '-' && !isdigit((unsigned char)c)) return NULL;  // Invalid character
+            item = parse_number(ctx);
+            break;
     }
+    
+    // Absolute for now; documents make them relative to the parent
+    if (item && ctx->spans) {
+        span_of(item)->offset = start;
+        span_of(item)->length = ctx->pos - start;
+    }
+    if (item && ctx->hash) item->hash = hash_node(item);
+    return item;
 }
 
 // Parse a JSON object
 static json_t* parse_object(parse_context_t *ctx) {
     if (next_char(ctx) != '{') return NULL;  // Must start with '{'
     
-    json_t *object = json_new();
+    json_t *object = json_new(ctx);
     if (!object) return NULL;
     object->type = JSON_OBJECT;
     
@@ -196,27 +616,27 @@ static json_t* parse_object(parse_context_t *ctx) {
         // Parse key (must be a string)
         json_t *key_item = parse_string(ctx);
         if (!key_item) {
-            json_delete(object);
+            delete_tree(object, ctx->alloc);
             return NULL;
         }
         
         // Key becomes the property name, not a separate value
         char *key = key_item->valuestring;
         key_item->valuestring = NULL;  // Transfer ownership
-        json_delete(key_item);
+        delete_tree(key_item, ctx->alloc);
         
         // Expect colon
         if (next_char(ctx) != ':') {
-            free(key);
-            json_delete(object);
+            mem_free(ctx->alloc, key);
+            delete_tree(object, ctx->alloc);
             return NULL;
         }
         
         // Parse value
         json_t *value_item = parse_value(ctx);
         if (!value_item) {
-            free(key);
-            json_delete(object);
+            mem_free(ctx->alloc, key);
+            delete_tree(object, ctx->alloc);
             return NULL;
         }
         
@@ -245,11 +665,12 @@ static json_t* parse_object(parse_context_t *ctx) {
             continue;
         } else {
             // Invalid character
-            json_delete(object);
+            delete_tree(object, ctx->alloc);
             return NULL;
         }
     }
     
+    object->child->prev = current_child;  // The head links to the tail
     return object;
 }
 
@@ -257,7 +678,7 @@ static json_t* parse_object(parse_context_t *ctx) {
 static json_t* parse_array(parse_context_t *ctx) {
     if (next_char(ctx) != '[') return NULL;  // Must start with '['
     
-    json_t *array = json_new();
+    json_t *array = json_new(ctx);
     if (!array) return NULL;
     array->type = JSON_ARRAY;
     
@@ -273,7 +694,7 @@ static json_t* parse_array(parse_context_t *ctx) {
         // Parse value
         json_t *value_item = parse_value(ctx);
         if (!value_item) {
-            json_delete(array);
+            delete_tree(array, ctx->alloc);
             return NULL;
         }
         
@@ -299,45 +720,2570 @@ static json_t* parse_array(parse_context_t *ctx) {
             continue;
         } else {
             // Invalid character
-            json_delete(array);
+            delete_tree(array, ctx->alloc);
             return NULL;
         }
     }
     
+    array->child->prev = current_child;  // The head links to the tail
     return array;
 }
 
+// One value and nothing but whitespace around it
+static json_t* parse_root(parse_context_t *ctx) {
+    json_t *json = parse_value(ctx);
+    if (!json) return NULL;
+    skip_whitespace(ctx);
+    if (ctx->pos != ctx->length) {
+        delete_tree(json, ctx->alloc);
+        return NULL;  // Trailing content
+    }
+    return json;
+}
+
 // Main parsing function
 json_t* json_parse(const char *text) {
     if (!text) return NULL;
+    return json_parse_length(text, strlen(text));
+}
+
+// Parse exactly length bytes; the text need not be NUL-terminated
+json_t* json_parse_length(const char *text, size_t length) {
+    return json_parse_ex(text, length, NULL);
+}
+
+// Allocator that counts on behalf of json_parse_stats_t and forwards to
+// the caller's allocator, so the tree can be freed with that one
+typedef struct {
+    const json_allocator_t *inner;
+    json_parse_stats_t *stats;
+} stats_allocator_t;
+
+static void* stats_malloc(void *ctx, size_t size) {
+    stats_allocator_t *s = ctx;
+    s->stats->allocations++;
+    s->stats->allocated_bytes += size;
+    return s->inner->malloc_fn(s->inner->ctx, size);
+}
+
+static void* stats_realloc(void *ctx, void *ptr, size_t size) {
+    stats_allocator_t *s = ctx;
+    s->stats->allocations++;
+    s->stats->allocated_bytes += size;
+    return s->inner->realloc_fn(s->inner->ctx, ptr, size);
+}
+
+static void stats_free(void *ctx, void *ptr) {
+    stats_allocator_t *s = ctx;
+    s->inner->free_fn(s->inner->ctx, ptr);
+}
+
+// Tally the finished tree; depth counts the containers enclosing json
+static void collect_stats(const json_t *json, int depth, json_parse_stats_t *stats) {
+    for (; json; json = json->next) {
+        if (json->string) {
+            stats->keys++;
+            stats->string_bytes += strlen(json->string);
+        }
+        switch (json->type) {
+            case JSON_OBJECT: stats->objects++; break;
+            case JSON_ARRAY:  stats->arrays++; break;
+            case JSON_STRING:
+                stats->strings++;
+                stats->string_bytes += strlen(json->valuestring);
+                break;
+            case JSON_NUMBER: stats->numbers++; break;
+            case JSON_TRUE:
+            case JSON_FALSE:  stats->booleans++; break;
+            case JSON_NULL:   stats->nulls++; break;
+        }
+        if (json->type == JSON_OBJECT || json->type == JSON_ARRAY) {
+            if (depth + 1 > stats->max_depth) stats->max_depth = depth + 1;
+            collect_stats(json->child, depth + 1, stats);
+        }
+    }
+}
+
+json_t* json_parse_ex(const char *text, size_t length, const json_parse_options_t *options) {
+    if (!text) return NULL;
     
     parse_context_t ctx = {
         .json = text,
         .pos = 0,
-        .length = strlen(text)
+        .length = length,
+        .alloc = options && options->allocator ? options->allocator : &global_allocator,
+        .timing = NULL,
+        .spans = 0,
+        .hash = options && options->hash,
+        .depth = 0
     };
     
-    return parse_value(&ctx);
+    json_parse_stats_t *stats = options ? options->stats : NULL;
+    if (!stats) return parse_root(&ctx);
+    
+    int timing = stats->timing;
+    memset(stats, 0, sizeof(*stats));
+    stats->timing = timing;
+    
+    stats_allocator_t counter = { ctx.alloc, stats };
+    json_allocator_t counting = { stats_malloc, stats_realloc, stats_free, &counter };
+    ctx.alloc = &counting;
+    if (timing) ctx.timing = stats;
+    
+    uint64_t started = timing ? clock_ns() : 0;
+    json_t *json = parse_root(&ctx);
+    if (timing) {
+        stats->total_ns = clock_ns() - started;
+        uint64_t phases = stats->string_ns + stats->number_ns;
+        stats->scan_ns = stats->total_ns > phases ? stats->total_ns - phases : 0;
+    }
+    
+    if (json) collect_stats(json, 0, stats);
+    return json;
 }
 
 // Memory cleanup
-void json_delete(json_t *json) {
+static void delete_tree(json_t *json, const json_allocator_t *a) {
     if (!json) return;
     
     // Recursively delete children
     json_t *child = json->child;
     while (child) {
         json_t *next = child->next;
-        json_delete(child);
+        delete_tree(child, a);
         child = next;
     }
     
     // Free string data
-    if (json->valuestring) free(json->valuestring);
-    if (json->string) free(json->string);
+    mem_free(a, json->valuestring);
+    mem_free(a, json->string);
     
     // Free the node itself
-    free(json);
+    mem_free(a, json);
+}
+
+void json_delete(json_t *json) {
+    delete_tree(json, &global_allocator);
+}
+
+void json_delete_ex(json_t *json, const json_allocator_t *allocator) {
+    delete_tree(json, allocator ? allocator : &global_allocator);
+}
+
+// Child lists: next runs head to tail and ends in NULL; prev runs back
+// from each node, and the head's prev is the tail so appends are O(1)
+static void append_child(json_t *parent, json_t *item) {
+    json_t *head = parent->child;
+    item->next = NULL;
+    if (head) {
+        item->prev = head->prev;
+        head->prev->next = item;
+        head->prev = item;
+    } else {
+        item->prev = item;
+        parent->child = item;
+    }
+}
+
+// Put item where old is; old is left unlinked
+static void relink_child(json_t *parent, json_t *old, json_t *item) {
+    item->next = old->next;
+    item->prev = old->prev == old ? item : old->prev;
+    if (parent->child == old) parent->child = item;
+    else item->prev->next = item;
+    if (item->next) item->next->prev = item;
+    else parent->child->prev = item;
+    old->next = NULL;
+    old->prev = NULL;
+}
+
+static void unlink_child(json_t *parent, json_t *item) {
+    json_t *head = parent->child;
+    if (item == head) {
+        parent->child = item->next;
+        if (item->next) item->next->prev = item->prev;
+    } else {
+        item->prev->next = item->next;
+        if (item->next) item->next->prev = item->prev;
+        else head->prev = item->prev;
+    }
+    item->next = NULL;
+    item->prev = NULL;
+}
+
+// Documents: trees that remember the source span of every value, so an
+// edit to the text re-parses only the innermost value that contains it.
+// Spans are relative to the parent's start, which leaves the values
+// after an edit untouched apart from the siblings along the path.
+struct json_document {
+    json_t *root;
+    size_t length;  // Of the text the tree describes
+    int stale;      // The last reparse failed; the next parses everything
+};
+
+static void index_children(json_t *json, size_t count) {
+    size_t blocks = (count + SPAN_BLOCK - 1) / SPAN_BLOCK;
+    span_index_t *index = mem_alloc(&global_allocator, sizeof(span_index_t) + blocks * sizeof(span_block_t));
+    if (!index) return;  // Lookups fall back to walking the children
+    
+    size_t i = 0;
+    for (json_t *child = json->child; child; child = child->next, i++) {
+        if (i % SPAN_BLOCK == 0) {
+            index->blocks[i / SPAN_BLOCK].first = child;
+            index->blocks[i / SPAN_BLOCK].shift = 0;
+        }
+    }
+    index->count = blocks;
+    span_of(json)->index = index;
+}
+
+static void relative_spans(json_t *json) {
+    size_t count = 0;
+    for (json_t *child = json->child; child; child = child->next) {
+        relative_spans(child);
+        span_of(child)->offset -= span_of(json)->offset;
+        count++;
+    }
+    if (count > SPAN_BLOCK) index_children(json, count);
+}
+
+static void delete_spans(json_t *json) {
+    for (json_t *child = json->child; child; child = child->next) {
+        if (child->child) delete_spans(child);
+    }
+    mem_free(&global_allocator, span_of(json)->index);
+    span_of(json)->index = NULL;
+}
+
+static void delete_document_tree(json_t *json) {
+    delete_spans(json);
+    delete_tree(json, &global_allocator);
+}
+
+// One value and nothing but whitespace around it, inside depth open
+// containers. The root's offset is from the start of text, its
+// descendants' from their parents.
+static json_t* parse_spans(const char *text, size_t length, int depth) {
+    parse_context_t ctx = {
+        .json = text,
+        .pos = 0,
+        .length = length,
+        .alloc = &global_allocator,
+        .timing = NULL,
+        .spans = 1,
+        .hash = 0,
+        .depth = depth
+    };
+    
+    json_t *json = parse_root(&ctx);
+    if (!json) return NULL;
+    relative_spans(json);
+    return json;
+}
+
+// The last child of json (which starts at base) that starts at or before
+// offset, or NULL. *start is its absolute start and *block its block in
+// json's index.
+static json_t* child_at(const json_t *json, size_t base, size_t offset, size_t *start, size_t *block) {
+    const span_index_t *index = span_of(json)->index;
+    json_t *child = json->child;
+    const json_t *stop = NULL;
+    size_t shift = 0;
+    size_t b = 0;
+    
+    if (index) {
+        size_t lo = 0, hi = index->count;
+        while (hi - lo > 1) {
+            size_t mid = lo + (hi - lo) / 2;
+            const span_block_t *blk = &index->blocks[mid];
+            if (base + span_of(blk->first)->offset + blk->shift <= offset) lo = mid;
+            else hi = mid;
+        }
+        b = lo;
+        child = index->blocks[b].first;
+        shift = index->blocks[b].shift;
+        if (b + 1 < index->count) stop = index->blocks[b + 1].first;
+    }
+    
+    json_t *found = NULL;
+    for (; child != stop; child = child->next) {
+        size_t child_start = base + span_of(child)->offset + shift;
+        if (child_start > offset) break;
+        found = child;
+        *start = child_start;
+    }
+    *block = b;
+    return found;
+}
+
+json_document_t* json_document_parse(const char *text, size_t length) {
+    if (!text) return NULL;
+    
+    json_document_t *doc = mem_alloc(&global_allocator, sizeof(json_document_t));
+    if (!doc) return NULL;
+    doc->root = parse_spans(text, length, 0);
+    if (!doc->root) {
+        mem_free(&global_allocator, doc);
+        return NULL;
+    }
+    doc->length = length;
+    doc->stale = 0;
+    return doc;
+}
+
+json_t* json_document_root(const json_document_t *doc) {
+    return doc ? doc->root : NULL;
+}
+
+void json_document_free(json_document_t *doc) {
+    if (!doc) return;
+    delete_document_tree(doc->root);
+    mem_free(&global_allocator, doc);
+}
+
+json_t* json_document_at(const json_document_t *doc, size_t offset, size_t *start, size_t *length) {
+    if (!doc || doc->stale) return NULL;
+    
+    json_t *node = doc->root;
+    size_t node_start = span_of(node)->offset;
+    if (offset < node_start || offset >= node_start + span_of(node)->length) return NULL;
+    
+    while (node->child) {
+        size_t child_start, block;
+        json_t *child = child_at(node, node_start, offset, &child_start, &block);
+        if (!child || offset >= child_start + span_of(child)->length) break;
+        node = child;
+        node_start = child_start;
+    }
+    
+    if (start) *start = node_start;
+    if (length) *length = span_of(node)->length;
+    return node;
+}
+
+// Values from the root down to the one being replaced
+typedef struct {
+    json_t *nodes[JSON_MAX_DEPTH + 1];
+    size_t starts[JSON_MAX_DEPTH + 1];
+    size_t blocks[JSON_MAX_DEPTH + 1];  // Of each node in its parent's index
+    int depth;
+} span_path_t;
+
+// Move the siblings after path->nodes[level] by delta, within its block
+// and then block by block
+static void shift_siblings(span_path_t *path, int level, size_t delta) {
+    span_index_t *index = span_of(path->nodes[level - 1])->index;
+    size_t block = path->blocks[level];
+    const json_t *stop = index && block + 1 < index->count ? index->blocks[block + 1].first : NULL;
+    
+    for (json_t *sibling = path->nodes[level]->next; sibling != stop; sibling = sibling->next) {
+        span_of(sibling)->offset += delta;
+    }
+    for (size_t b = block + 1; index && b < index->count; b++) {
+        index->blocks[b].shift += delta;
+    }
+}
+
+// Put json in place of the last value on the path and move everything
+// after the edit by delta. Offsets are unsigned; adding the two's
+// complement of a shrinking edit wraps around to the right value.
+static void splice_value(json_document_t *doc, span_path_t *path, json_t *json, size_t delta) {
+    int last = path->depth - 1;
+    json_t *old = path->nodes[last];
+    json_t *parent = last > 0 ? path->nodes[last - 1] : NULL;
+    
+    if (parent) {
+        span_index_t *index = span_of(parent)->index;
+        span_of(json)->offset -= path->starts[last - 1];
+        if (index) {
+            span_block_t *block = &index->blocks[path->blocks[last]];
+            span_of(json)->offset -= block->shift;
+            if (block->first == old) block->first = json;
+        }
+    }
+    json->string = old->string;  // The key is outside the span
+    old->string = NULL;
+    if (parent) relink_child(parent, old, json);
+    else doc->root = json;
+    delete_document_tree(old);
+    
+    path->nodes[last] = json;
+    for (int level = 0; level < last; level++) {
+        path->nodes[level]->hash = 0;  // Its contents changed
+    }
+    if (delta == 0) return;
+    for (int level = last; level > 0; level--) {
+        shift_siblings(path, level, delta);
+        span_of(path->nodes[level - 1])->length += delta;
+    }
+}
+
+int json_reparse_range(json_document_t *doc, const char *text, size_t edit_start,
+                       size_t old_len, size_t new_len) {
+    if (!doc || !text || edit_start > doc->length || old_len > doc->length - edit_start) return -1;
+    
+    size_t edit_end = edit_start + old_len;
+    size_t delta = new_len - old_len;
+    doc->length += delta;
+    
+    span_path_t path;
+    path.depth = 0;
+    
+    // Innermost value whose span holds the whole edit; an edit touching
+    // only its first or last byte still counts. Parsing keeps documents
+    // within JSON_MAX_DEPTH containers, so the path holds every level.
+    json_t *node = doc->root;
+    size_t node_start = span_of(node)->offset;
+    if (!doc->stale && node_start <= edit_start && edit_end <= node_start + span_of(node)->length) {
+        path.nodes[0] = node;
+        path.starts[0] = node_start;
+        path.blocks[0] = 0;
+        path.depth = 1;
+        while (node->child && path.depth <= JSON_MAX_DEPTH) {
+            size_t child_start, block;
+            json_t *child = child_at(node, node_start, edit_start, &child_start, &block);
+            if (!child || edit_end > child_start + span_of(child)->length) break;
+            node = child;
+            node_start = child_start;
+            path.nodes[path.depth] = node;
+            path.starts[path.depth] = node_start;
+            path.blocks[path.depth++] = block;
+        }
+    }
+    
+    // Widen to the enclosing containers while the new text is not one value
+    int tried = path.depth > 0;
+    while (path.depth > 0) {
+        size_t start = path.starts[path.depth - 1];
+        size_t length = span_of(path.nodes[path.depth - 1])->length + delta;
+        json_t *json = parse_spans(text + start, length, path.depth - 1);
+        if (json) {
+            span_of(json)->offset += start;
+            splice_value(doc, &path, json, delta);
+            return 0;
+        }
+        path.depth--;
+    }
+    
+    // Whitespace around the root value cannot rescue a root that failed
+    json_t *root = tried ? NULL : parse_spans(text, doc->length, 0);
+    if (!root) {
+        doc->stale = 1;
+        return -1;
+    }
+    delete_document_tree(doc->root);
+    doc->root = root;
+    doc->stale = 0;
+    return 0;
+}
+
+// Streaming scanner: a pull tokenizer that checks the grammar as it goes,
+// using constant memory (one bit per open container)
+enum {
+    SCAN_VALUE,          // Root, after ':' or after ',' in an array
+    SCAN_VALUE_OR_END,   // After '['
+    SCAN_KEY_OR_END,     // After '{'
+    SCAN_KEY,            // After ',' in an object
+    SCAN_COLON,          // After a key
+    SCAN_COMMA_OR_END,   // After a value inside a container
+    SCAN_DONE,           // Root value complete
+    SCAN_ERROR
+};
+
+// Pretty-printed input is mostly runs of indentation; take those eight
+// spaces at a time
+static const char* skip_space(const char *p, const char *end) {
+    while (end - p >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, p, sizeof(chunk));
+        if (chunk != 0x2020202020202020ULL) break;
+        p += 8;
+    }
+    while (p < end && is_json_space(*p)) p++;
+    return p;
+}
+
+static int scanner_in_object(const json_scanner_t *s) {
+    int level = s->depth - 1;
+    return (s->stack[level / 8] >> (level % 8)) & 1;
+}
+
+static int scanner_error(json_scanner_t *s) {
+    s->state = SCAN_ERROR;
+    return JSON_TOKEN_ERROR;
+}
+
+// Results of scanning one token
+#define SCANNED_BAD  0
+#define SCANNED_OK   1
+#define SCANNED_MORE 2   // Token runs into the end of a partial window
+
+// A token cut off by the end of the window may still be completed by the
+// next block when more input follows
+static int scan_truncated(const json_scanner_t *s) {
+    return s->partial ? SCANNED_MORE : SCANNED_BAD;
+}
+
+// Scan a string starting at the opening quote; the token covers the quotes
+static int scan_string(json_scanner_t *s) {
+    const char *start = &s->json[s->pos];
+    const char *end = s->json + s->length;
+    const char *p = start + 1;
+    
+    while (1) {
+        p = scan_string_bytes(p, end, 1);
+        if (!p) return SCANNED_BAD;  // Malformed UTF-8
+        if (p >= end) return scan_truncated(s);  // Unclosed
+        
+        if (*p == '"') break;
+        if ((unsigned char)*p >= 0x80) {
+            unsigned state;
+            p = scan_utf8_run(p, end, &state);
+            if (state == UTF8_REJECT) return SCANNED_BAD;  // Malformed UTF-8
+            // A sequence split across blocks is rescanned later
+            if (state != UTF8_ACCEPT) return scan_truncated(s);
+            continue;
+        }
+        if (*p != '\\') return SCANNED_BAD;  // Raw control character
+        
+        if (end - p < 2) return scan_truncated(s);
+        switch (p[1]) {
+            case '"': case '\\': case '/': case 'b':
+            case 'f': case 'n': case 'r': case 't':
+                p += 2;
+                break;
+            case 'u': {
+                if (end - p < 6) return scan_truncated(s);
+                long cp = parse_hex4(p + 2);
+                if (cp < 0) return SCANNED_BAD;
+                p += 6;
+                
+                if (cp >= 0xDC00 && cp <= 0xDFFF) return SCANNED_BAD;  // Lone low surrogate
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    // High surrogate must be followed by a low surrogate
+                    if (end - p < 6) return scan_truncated(s);
+                    if (p[0] != '\\' || p[1] != 'u') return SCANNED_BAD;
+                    long lo = parse_hex4(p + 2);
+                    if (lo < 0xDC00 || lo > 0xDFFF) return SCANNED_BAD;
+                    p += 6;
+                }
+                break;
+            }
+            default:
+                return SCANNED_BAD;
+        }
+    }
+    
+    s->token = start;
+    s->token_length = (size_t)(p + 1 - start);
+    s->pos += s->token_length;
+    return SCANNED_OK;
+}
+
+static size_t scan_digits(const char *p, const char *end) {
+    const char *start = p;
+    while (p < end && *p >= '0' && *p <= '9') p++;
+    return (size_t)(p - start);
+}
+
+// Scan a number with the strict JSON grammar (no leading zeros, no bare '.')
+static int scan_number(json_scanner_t *s) {
+    const char *start = &s->json[s->pos];
+    const char *end = s->json + s->length;
+    const char *p = start;
+    size_t digits;
+    
+    if (*p == '-') p++;
+    if (p < end && *p == '0') {
+        p++;
+    } else {
+        digits = scan_digits(p, end);
+        if (digits == 0) return p == end ? scan_truncated(s) : SCANNED_BAD;
+        p += digits;
+    }
+    
+    if (p < end && *p == '.') {
+        p++;
+        digits = scan_digits(p, end);
+        if (digits == 0) return p == end ? scan_truncated(s) : SCANNED_BAD;
+        p += digits;
+    }
+    
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < end && (*p == '+' || *p == '-')) p++;
+        digits = scan_digits(p, end);
+        if (digits == 0) return p == end ? scan_truncated(s) : SCANNED_BAD;
+        p += digits;
+    }
+    
+    // More digits may follow in the next block
+    if (p == end && s->partial) return SCANNED_MORE;
+    
+    s->token = start;
+    s->token_length = (size_t)(p - start);
+    s->pos += s->token_length;
+    return SCANNED_OK;
+}
+
+static int scan_literal(json_scanner_t *s, const char *word, size_t len) {
+    size_t avail = s->length - s->pos;
+    
+    if (avail < len) {
+        if (memcmp(&s->json[s->pos], word, avail) == 0) return scan_truncated(s);
+        return SCANNED_BAD;
+    }
+    if (memcmp(&s->json[s->pos], word, len) != 0) return SCANNED_BAD;
+    
+    s->token = &s->json[s->pos];
+    s->token_length = len;
+    s->pos += len;
+    return SCANNED_OK;
+}
+
+// Turn a scan result into the token to return
+static int scanned(json_scanner_t *s, int result, int token) {
+    if (result == SCANNED_OK) return token;
+    if (result == SCANNED_MORE) return JSON_TOKEN_INCOMPLETE;
+    return scanner_error(s);
+}
+
+// The value just scanned completes either the root or a container element
+static int scanner_value_done(json_scanner_t *s, int token) {
+    s->state = s->depth == 0 ? SCAN_DONE : SCAN_COMMA_OR_END;
+    return token;
+}
+
+static int scanner_open(json_scanner_t *s, int is_object) {
+    if (s->depth >= JSON_MAX_DEPTH) return scanner_error(s);
+    
+    if (is_object) s->stack[s->depth / 8] |= (unsigned char)(1 << (s->depth % 8));
+    else s->stack[s->depth / 8] &= (unsigned char)~(1 << (s->depth % 8));
+    s->depth++;
+    
+    s->token = &s->json[s->pos++];
+    s->token_length = 1;
+    s->state = is_object ? SCAN_KEY_OR_END : SCAN_VALUE_OR_END;
+    return is_object ? JSON_TOKEN_OBJECT_BEGIN : JSON_TOKEN_ARRAY_BEGIN;
+}
+
+static int scanner_close(json_scanner_t *s, char c) {
+    int is_object = scanner_in_object(s);
+    if (c != (is_object ? '}' : ']')) return scanner_error(s);
+    
+    s->depth--;
+    s->token = &s->json[s->pos++];
+    s->token_length = 1;
+    return scanner_value_done(s, is_object ? JSON_TOKEN_OBJECT_END : JSON_TOKEN_ARRAY_END);
+}
+
+static int scanner_value(json_scanner_t *s, char c) {
+    int result;
+    int token;
+    
+    switch (c) {
+        case '{': return scanner_open(s, 1);
+        case '[': return scanner_open(s, 0);
+        case '"':
+            result = scan_string(s);
+            token = JSON_TOKEN_STRING;
+            break;
+        case 't':
+            result = scan_literal(s, "true", 4);
+            token = JSON_TOKEN_TRUE;
+            break;
+        case 'f':
+            result = scan_literal(s, "false", 5);
+            token = JSON_TOKEN_FALSE;
+            break;
+        case 'n':
+            result = scan_literal(s, "null", 4);
+            token = JSON_TOKEN_NULL;
+            break;
+        default:
+            if (c != '-' && (c < '0' || c > '9')) return scanner_error(s);
+            result = scan_number(s);
+            token = JSON_TOKEN_NUMBER;
+            break;
+    }
+    
+    // Only a complete token moves the grammar state forward
+    token = scanned(s, result, token);
+    if (token > 0) scanner_value_done(s, token);
+    return token;
+}
+
+void json_scanner_init(json_scanner_t *s, const char *json, size_t length) {
+    memset(s, 0, sizeof(*s));
+    s->json = json;
+    s->length = json ? length : 0;
+    s->state = json ? SCAN_VALUE : SCAN_ERROR;
+}
+
+void json_scanner_feed(json_scanner_t *s, const char *json, size_t length, int last) {
+    s->json = json;
+    s->length = length;
+    s->pos = 0;
+    s->token = NULL;
+    s->token_length = 0;
+    s->partial = !last;
+}
+
+int json_scanner_next(json_scanner_t *s) {
+    while (1) {
+        if (s->state == SCAN_ERROR) return JSON_TOKEN_ERROR;
+        
+        s->pos = (size_t)(skip_space(&s->json[s->pos], s->json + s->length) - s->json);
+        if (s->pos >= s->length) {
+            if (s->partial) return JSON_TOKEN_INCOMPLETE;
+            return s->state == SCAN_DONE ? JSON_TOKEN_END : scanner_error(s);
+        }
+        
+        char c = s->json[s->pos];
+        switch (s->state) {
+            case SCAN_VALUE:
+                return scanner_value(s, c);
+            case SCAN_VALUE_OR_END:
+                if (c == ']') return scanner_close(s, c);
+                return scanner_value(s, c);
+            case SCAN_KEY_OR_END:
+                if (c == '}') return scanner_close(s, c);
+                /* fall through */
+            case SCAN_KEY: {
+                if (c != '"') return scanner_error(s);
+                int token = scanned(s, scan_string(s), JSON_TOKEN_KEY);
+                if (token > 0) s->state = SCAN_COLON;
+                return token;
+            }
+            case SCAN_COLON:
+                if (c != ':') return scanner_error(s);
+                s->pos++;
+                s->state = SCAN_VALUE;
+                break;
+            case SCAN_COMMA_OR_END:
+                if (c == ',') {
+                    s->pos++;
+                    s->state = scanner_in_object(s) ? SCAN_KEY : SCAN_VALUE;
+                    break;
+                }
+                return scanner_close(s, c);
+            default:
+                return scanner_error(s);  // Trailing content after the root
+        }
+    }
+}
+
+int json_validate(const char *json, size_t length) {
+    json_scanner_t scanner;
+    int token;
+    
+    json_scanner_init(&scanner, json, length);
+    while ((token = json_scanner_next(&scanner)) > 0) {
+    }
+    return token == JSON_TOKEN_END;
+}
+
+// Output buffer for the printer. Grows geometrically unless it wraps
+// caller-owned memory; a fixed buffer with a flush callback drains into it
+// when full, otherwise running out of space is a failure.
+typedef struct {
+    char *buffer;
+    size_t length;
+    size_t capacity;
+    int fixed;
+    int failed;
+    json_write_fn flush;
+    void *flush_ctx;
+} print_buffer_t;
+
+// Hand the buffered bytes to the flush callback
+static void print_flush(print_buffer_t *p) {
+    if (p->failed || p->length == 0) return;
+    if (p->flush(p->flush_ctx, p->buffer, p->length) != 0) {
+        p->failed = 1;
+        return;
+    }
+    p->length = 0;
+}
+
+// Make room for `needed` more bytes, returns the write position or NULL
+static char* print_reserve(print_buffer_t *p, size_t needed) {
+    if (p->failed) return NULL;
+    
+    if (p->capacity - p->length < needed) {
+        if (p->fixed) {
+            p->failed = 1;
+            return NULL;
+        }
+        
+        size_t capacity = p->capacity ? p->capacity : 256;
+        while (capacity - p->length < needed) {
+            capacity *= 2;
+        }
+        
+        char *buffer = global_allocator.realloc_fn(global_allocator.ctx, p->buffer, capacity);
+        if (!buffer) {
+            p->failed = 1;
+            return NULL;
+        }
+        p->buffer = buffer;
+        p->capacity = capacity;
+    }
+    
+    return &p->buffer[p->length];
+}
+
+static void print_raw(print_buffer_t *p, const char *text, size_t len) {
+    if (p->flush && p->capacity - p->length < len) {
+        print_flush(p);
+        if (len > p->capacity) {
+            // Larger than the whole buffer: pass it straight through
+            if (!p->failed && p->flush(p->flush_ctx, text, len) != 0) p->failed = 1;
+            return;
+        }
+    }
+    
+    char *out = print_reserve(p, len);
+    if (!out) return;
+    memcpy(out, text, len);
+    p->length += len;
+}
+
+// Print a quoted string, copying runs that need no escaping in bulk
+static void print_string(print_buffer_t *p, const char *str, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *s = (const unsigned char *)str;
+    const unsigned char *end = s + len;
+    
+    print_raw(p, "\"", 1);
+    
+    while (s < end) {
+        const unsigned char *run = s;
+        s = (const unsigned char *)scan_plain((const char *)s, (const char *)end);
+        if (s > run) print_raw(p, (const char *)run, (size_t)(s - run));
+        if (s == end) break;
+        
+        char esc = escape_table[*s];
+        if (esc == 'u') {
+            char seq[6] = { '\\', 'u', '0', '0', hex[*s >> 4], hex[*s & 0xF] };
+            print_raw(p, seq, 6);
+        } else {
+            char seq[2] = { '\\', esc };
+            print_raw(p, seq, 2);
+        }
+        s++;
+    }
+    
+    print_raw(p, "\"", 1);
+}
+
+static void print_cstring(print_buffer_t *p, const char *str) {
+    if (!str) str = "";
+    print_string(p, str, strlen(str));
+}
+
+// Print a number; integral values take the integer formatter, everything
+// else the shortest round-trip double formatter
+static void print_number(print_buffer_t *p, double value) {
+    char text[JSON_NUMBER_BUFFER_SIZE];
+    int len;
+    
+    if (value >= -9007199254740992.0 && value <= 9007199254740992.0 &&
+        value == (double)(long long)value && !(value == 0 && signbit(value))) {
+        len = json_format_integer((long long)value, text);
+    } else {
+        len = json_format_double(value, text);
+    }
+    
+    print_raw(p, text, (size_t)len);
+}
+
+// Newline plus two spaces per level, written from a static run of spaces
+static void print_indent(print_buffer_t *p, int depth) {
+    static const char spaces[] = "                                ";
+    size_t width = (size_t)depth * 2;
+    
+    print_raw(p, "\n", 1);
+    while (width > 0) {
+        size_t chunk = width < sizeof(spaces) - 1 ? width : sizeof(spaces) - 1;
+        print_raw(p, spaces, chunk);
+        width -= chunk;
+    }
+}
+
+static void print_value(print_buffer_t *p, const json_t *item, int depth, int pretty) {
+    switch (item->type) {
+        case JSON_NULL:   print_raw(p, "null", 4);  break;
+        case JSON_FALSE:  print_raw(p, "false", 5); break;
+        case JSON_TRUE:   print_raw(p, "true", 4);  break;
+        case JSON_NUMBER: print_number(p, item->valuenumber); break;
+        case JSON_STRING: print_cstring(p, item->valuestring); break;
+        case JSON_ARRAY:
+        case JSON_OBJECT: {
+            int is_object = item->type == JSON_OBJECT;
+            const json_t *child = item->child;
+            
+            print_raw(p, is_object ? "{" : "[", 1);
+            while (child) {
+                if (pretty) print_indent(p, depth + 1);
+                if (is_object) {
+                    print_cstring(p, child->string);
+                    print_raw(p, ": ", pretty ? 2 : 1);
+                }
+                print_value(p, child, depth + 1, pretty);
+                child = child->next;
+                if (child) print_raw(p, ",", 1);
+            }
+            if (pretty && item->child) print_indent(p, depth);
+            print_raw(p, is_object ? "}" : "]", 1);
+            break;
+        }
+        default:
+            p->failed = 1;
+            break;
+    }
+}
+
+// Serialize into a NUL-terminated string from the global allocator
+static char* print_alloc(const json_t *json, int format) {
+    if (!json) return NULL;
+    
+    print_buffer_t p = { NULL, 0, 0, 0, 0, NULL, NULL };
+    print_value(&p, json, 0, format == JSON_PRINT_PRETTY);
+    print_raw(&p, "", 1);  // NUL terminator
+    
+    if (p.failed) {
+        mem_free(&global_allocator, p.buffer);
+        return NULL;
+    }
+    return p.buffer;
+}
+
+char* json_print(const json_t *json) {
+    return print_alloc(json, JSON_PRINT_PRETTY);
+}
+
+char* json_print_compact(const json_t *json) {
+    return print_alloc(json, JSON_PRINT_COMPACT);
+}
+
+size_t json_print_buffered(const json_t *json, char *buf, size_t cap, int format) {
+    if (!json || !buf || cap == 0) return 0;
+    
+    print_buffer_t p = { buf, 0, cap, 1, 0, NULL, NULL };
+    print_value(&p, json, 0, format == JSON_PRINT_PRETTY);
+    print_raw(&p, "", 1);  // NUL terminator
+    
+    if (p.failed) {
+        buf[0] = '\0';
+        return 0;
+    }
+    return p.length - 1;
+}
+
+// Streaming writer: emits JSON through a fixed buffer without building a tree
+struct json_writer {
+    print_buffer_t out;
+    int pretty;
+    int depth;
+    int need_comma;     // Current level already holds a value
+    int after_key;      // A key was written and awaits its value
+    int fd;
+#ifdef DEBUG
+    // Structural checking: one bit per open container, set for objects
+    int root_done;
+    unsigned char stack[JSON_MAX_DEPTH / 8];
+#endif
+};
+
+static int write_fd(void *ctx, const char *data, size_t len) {
+    int fd = *(int *)ctx;
+    
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        len -= (size_t)written;
+    }
+    return 0;
+}
+
+json_writer_t* json_writer_new(json_write_fn write, void *ctx, size_t buffer_size, int format) {
+    if (!write) return NULL;
+    if (buffer_size < 64) buffer_size = 64;
+    
+    // The writer and its buffer share one allocation
+    json_writer_t *w = mem_alloc(&global_allocator, sizeof(json_writer_t) + buffer_size);
+    if (!w) return NULL;
+    memset(w, 0, sizeof(json_writer_t));
+    
+    w->out.buffer = (char *)(w + 1);
+    w->out.capacity = buffer_size;
+    w->out.fixed = 1;
+    w->out.flush = write;
+    w->out.flush_ctx = ctx;
+    w->pretty = format == JSON_PRINT_PRETTY;
+    w->fd = -1;
+    return w;
+}
+
+json_writer_t* json_writer_new_fd(int fd, size_t buffer_size, int format) {
+    json_writer_t *w = json_writer_new(write_fd, NULL, buffer_size, format);
+    if (!w) return NULL;
+    
+    w->fd = fd;
+    w->out.flush_ctx = &w->fd;
+    return w;
+}
+
+int json_writer_flush(json_writer_t *w) {
+    if (!w) return -1;
+    print_flush(&w->out);
+    return w->out.failed ? -1 : 0;
+}
+
+void json_writer_free(json_writer_t *w) {
+    mem_free(&global_allocator, w);
+}
+
+#ifdef DEBUG
+static int writer_in_object(const json_writer_t *w) {
+    int level = w->depth - 1;
+    return (w->stack[level / 8] >> (level % 8)) & 1;
+}
+
+// Is a key (or a value) allowed at the current position?
+static int writer_check(const json_writer_t *w, int is_key) {
+    if (w->depth == 0) return !is_key && !w->root_done;
+    if (is_key) return writer_in_object(w) && !w->after_key;
+    return !writer_in_object(w) || w->after_key;
+}
+#endif
+
+// Emit the separator and indentation that precede a key or value
+static int writer_prefix(json_writer_t *w, int is_key) {
+    if (w->out.failed) return -1;
+#ifdef DEBUG
+    if (!writer_check(w, is_key)) {
+        w->out.failed = 1;
+        return -1;
+    }
+#else
+    (void)is_key;
+#endif
+
+    if (w->after_key) {
+        w->after_key = 0;
+        return 0;
+    }
+    if (w->need_comma) print_raw(&w->out, ",", 1);
+    if (w->pretty && w->depth > 0) print_indent(&w->out, w->depth);
+    return 0;
+}
+
+// Finish a key or value at the current level
+static int writer_done(json_writer_t *w) {
+    w->need_comma = 1;
+#ifdef DEBUG
+    if (w->depth == 0 && !w->after_key) w->root_done = 1;
+#endif
+    return w->out.failed ? -1 : 0;
+}
+
+static int writer_begin(json_writer_t *w, int is_object) {
+    if (writer_prefix(w, 0) != 0) return -1;
+#ifdef DEBUG
+    if (w->depth >= JSON_MAX_DEPTH) {
+        w->out.failed = 1;
+        return -1;
+    }
+    if (is_object) w->stack[w->depth / 8] |= (unsigned char)(1 << (w->depth % 8));
+    else w->stack[w->depth / 8] &= (unsigned char)~(1 << (w->depth % 8));
+#endif
+
+    print_raw(&w->out, is_object ? "{" : "[", 1);
+    w->depth++;
+    w->need_comma = 0;
+    return w->out.failed ? -1 : 0;
+}
+
+static int writer_end(json_writer_t *w, int is_object) {
+    if (w->out.failed) return -1;
+#ifdef DEBUG
+    if (w->depth == 0 || writer_in_object(w) != is_object || w->after_key) {
+        w->out.failed = 1;
+        return -1;
+    }
+#endif
+
+    w->depth--;
+    if (w->pretty && w->need_comma) print_indent(&w->out, w->depth);
+    print_raw(&w->out, is_object ? "}" : "]", 1);
+    return writer_done(w);
+}
+
+int json_writer_begin_object(json_writer_t *w) {
+    return writer_begin(w, 1);
+}
+
+int json_writer_end_object(json_writer_t *w) {
+    return writer_end(w, 1);
+}
+
+int json_writer_begin_array(json_writer_t *w) {
+    return writer_begin(w, 0);
+}
+
+int json_writer_end_array(json_writer_t *w) {
+    return writer_end(w, 0);
+}
+
+// Keys that are not NUL-terminated, for the transcoders
+static int writer_key_len(json_writer_t *w, const char *key, size_t len) {
+    if (writer_prefix(w, 1) != 0) return -1;
+    
+    print_string(&w->out, key, len);
+    print_raw(&w->out, ": ", w->pretty ? 2 : 1);
+    w->after_key = 1;
+    return writer_done(w);
+}
+
+int json_writer_key(json_writer_t *w, const char *key) {
+    if (!key) return -1;
+    return writer_key_len(w, key, strlen(key));
+}
+
+int json_writer_string(json_writer_t *w, const char *str) {
+    if (!str) return json_writer_null(w);
+    return json_writer_string_len(w, str, strlen(str));
+}
+
+int json_writer_string_len(json_writer_t *w, const char *str, size_t len) {
+    if (writer_prefix(w, 0) != 0) return -1;
+    print_string(&w->out, str, len);
+    return writer_done(w);
+}
+
+int json_writer_number(json_writer_t *w, double value) {
+    if (writer_prefix(w, 0) != 0) return -1;
+    print_number(&w->out, value);
+    return writer_done(w);
+}
+
+int json_writer_integer(json_writer_t *w, long long value) {
+    char text[JSON_NUMBER_BUFFER_SIZE];
+    
+    if (writer_prefix(w, 0) != 0) return -1;
+    print_raw(&w->out, text, (size_t)json_format_integer(value, text));
+    return writer_done(w);
+}
+
+int json_writer_bool(json_writer_t *w, int value) {
+    if (writer_prefix(w, 0) != 0) return -1;
+    if (value) print_raw(&w->out, "true", 4);
+    else print_raw(&w->out, "false", 5);
+    return writer_done(w);
+}
+
+int json_writer_null(json_writer_t *w) {
+    if (writer_prefix(w, 0) != 0) return -1;
+    print_raw(&w->out, "null", 4);
+    return writer_done(w);
+}
+
+// Binary documents. Layout, all offsets from the start of the image:
+//
+//   header   magic, byte order mark, image size, string table position,
+//            root record
+//   nodes    element blocks of containers: BINARY_RECORD bytes per array
+//            element, 8 per element of a number-only array, a key record
+//            plus a value record per object member
+//   strings  every distinct string once, NUL-terminated
+//
+// A record is type, flags, count and a 64-bit payload: the bits of a
+// number, a string's offset in the string table (count is its length) or
+// the offset of a container's block (count is its size).
+#define BINARY_MAGIC      "JSB1"
+#define BINARY_BOM        0x01020304u
+#define BINARY_HEADER     48
+#define BINARY_RECORD     16
+#define BINARY_MEMBER     (2 * BINARY_RECORD)
+#define BINARY_TYPED      1   // Array block holds packed doubles
+
+typedef struct {
+    uint8_t type;
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t count;
+    uint64_t payload;
+} binary_record_t;
+
+typedef struct {
+    char magic[4];
+    uint32_t bom;
+    uint64_t size;
+    uint64_t strings;
+    uint64_t strings_size;
+    binary_record_t root;
+} binary_header_t;
+
+// String table entry for deduplication
+typedef struct {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t hash;
+} binary_string_t;
+
+typedef struct {
+    print_buffer_t nodes;
+    print_buffer_t strings;
+    binary_string_t *table;    // Open addressing; offset UINT64_MAX is empty
+    size_t table_size;
+    size_t table_used;
+} binary_encoder_t;
+
+static uint32_t hash_bytes(const char *s, size_t len) {
+    uint32_t h = 2166136261u;  // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    }
+    return h;
+}
+
+static int binary_grow_table(binary_encoder_t *e) {
+    size_t size = e->table_size ? e->table_size * 2 : 256;
+    binary_string_t *table = mem_alloc(&global_allocator, size * sizeof(binary_string_t));
+    if (!table) return -1;
+    
+    for (size_t i = 0; i < size; i++) table[i].offset = UINT64_MAX;
+    for (size_t i = 0; i < e->table_size; i++) {
+        if (e->table[i].offset == UINT64_MAX) continue;
+        size_t slot = e->table[i].hash & (size - 1);
+        while (table[slot].offset != UINT64_MAX) slot = (slot + 1) & (size - 1);
+        table[slot] = e->table[i];
+    }
+    
+    mem_free(&global_allocator, e->table);
+    e->table = table;
+    e->table_size = size;
+    return 0;
+}
+
+// Record for a string, adding it to the string table unless it is there
+static int binary_string(binary_encoder_t *e, const char *s, binary_record_t *r) {
+    size_t len = s ? strlen(s) : 0;
+    if (len > UINT32_MAX) return -1;
+    if (!s) s = "";
+    
+    if ((e->table_used + 1) * 2 > e->table_size && binary_grow_table(e) != 0) return -1;
+    
+    uint32_t hash = hash_bytes(s, len);
+    size_t slot = hash & (e->table_size - 1);
+    while (e->table[slot].offset != UINT64_MAX) {
+        const binary_string_t *entry = &e->table[slot];
+        if (entry->hash == hash && entry->length == len &&
+            memcmp(e->strings.buffer + entry->offset, s, len) == 0) {
+            break;
+        }
+        slot = (slot + 1) & (e->table_size - 1);
+    }
+    
+    binary_string_t *entry = &e->table[slot];
+    if (entry->offset == UINT64_MAX) {
+        char *out = print_reserve(&e->strings, len + 1);
+        if (!out) return -1;
+        memcpy(out, s, len);
+        out[len] = '\0';
+        entry->offset = e->strings.length;
+        entry->length = (uint32_t)len;
+        entry->hash = hash;
+        e->strings.length += len + 1;
+        e->table_used++;
+    }
+    
+    memset(r, 0, sizeof(*r));
+    r->type = JSON_STRING;
+    r->count = entry->length;
+    r->payload = entry->offset;
+    return 0;
+}
+
+static int binary_value(binary_encoder_t *e, const json_t *json, binary_record_t *r);
+
+// Lay out a container's block, then encode its children into it. The
+// block is addressed by offset because children may grow the buffer.
+static int binary_container(binary_encoder_t *e, const json_t *json, binary_record_t *r) {
+    size_t count = 0;
+    int typed = json->type == JSON_ARRAY;
+    
+    for (const json_t *child = json->child; child; child = child->next) {
+        count++;
+        if (child->type != JSON_NUMBER) typed = 0;
+    }
+    if (count > UINT32_MAX) return -1;
+    
+    r->count = (uint32_t)count;
+    if (count == 0) return 0;
+    
+    size_t stride = typed ? sizeof(double) : json->type == JSON_OBJECT ? BINARY_MEMBER : BINARY_RECORD;
+    size_t block = e->nodes.length;
+    char *out = print_reserve(&e->nodes, count * stride);
+    if (!out) return -1;
+    memset(out, 0, count * stride);
+    e->nodes.length += count * stride;
+    r->flags = typed ? BINARY_TYPED : 0;
+    r->payload = BINARY_HEADER + block;
+    
+    size_t at = block;
+    for (const json_t *child = json->child; child; child = child->next, at += stride) {
+        binary_record_t record;
+        
+        if (typed) {
+            memcpy(e->nodes.buffer + at, &child->valuenumber, sizeof(double));
+            continue;
+        }
+        if (json->type == JSON_OBJECT) {
+            if (binary_string(e, child->string, &record) != 0) return -1;
+            memcpy(e->nodes.buffer + at, &record, sizeof(record));
+        }
+        if (binary_value(e, child, &record) != 0) return -1;
+        memcpy(e->nodes.buffer + at + stride - BINARY_RECORD, &record, sizeof(record));
+    }
+    return 0;
+}
+
+static int binary_value(binary_encoder_t *e, const json_t *json, binary_record_t *r) {
+    memset(r, 0, sizeof(*r));
+    r->type = (uint8_t)json->type;
+    
+    switch (json->type) {
+        case JSON_STRING:
+            return binary_string(e, json->valuestring, r);
+        case JSON_NUMBER:
+            memcpy(&r->payload, &json->valuenumber, sizeof(double));
+            return 0;
+        case JSON_ARRAY:
+        case JSON_OBJECT:
+            return binary_container(e, json, r);
+        case JSON_TRUE:
+        case JSON_FALSE:
+        case JSON_NULL:
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+int json_save_binary(const json_t *json, json_write_fn write, void *ctx) {
+    binary_encoder_t e;
+    binary_header_t header;
+    
+    if (!json || !write) return -1;
+    memset(&e, 0, sizeof(e));
+    memset(&header, 0, sizeof(header));
+    
+    int status = binary_value(&e, json, &header.root);
+    if (status == 0) {
+        memcpy(header.magic, BINARY_MAGIC, 4);
+        header.bom = BINARY_BOM;
+        header.strings = BINARY_HEADER + e.nodes.length;
+        header.strings_size = e.strings.length;
+        header.size = header.strings + header.strings_size;
+        
+        if (write(ctx, (const char *)&header, sizeof(header)) != 0 ||
+            (e.nodes.length && write(ctx, e.nodes.buffer, e.nodes.length) != 0) ||
+            (e.strings.length && write(ctx, e.strings.buffer, e.strings.length) != 0)) {
+            status = -1;
+        }
+    }
+    
+    mem_free(&global_allocator, e.nodes.buffer);
+    mem_free(&global_allocator, e.strings.buffer);
+    mem_free(&global_allocator, e.table);
+    return status;
+}
+
+// Turn a record read from the image into a view, checking that whatever
+// it points at lies inside the image
+static int binary_view(const json_view_t *doc, const unsigned char *at, json_view_t *out) {
+    binary_record_t r;
+    memcpy(&r, at, sizeof(r));
+    
+    *out = *doc;
+    out->type = r.type;
+    out->flags = r.flags;
+    out->count = r.count;
+    out->payload = r.payload;
+    
+    switch (r.type) {
+        case JSON_STRING:
+            return r.payload < doc->strings_size &&
+                   r.count < doc->strings_size - r.payload &&
+                   doc->strings[r.payload + r.count] == '\0' ? 0 : -1;
+        case JSON_ARRAY:
+        case JSON_OBJECT: {
+            if (r.count == 0) return 0;
+            size_t stride = r.flags & BINARY_TYPED ? sizeof(double) :
+                            r.type == JSON_OBJECT ? BINARY_MEMBER : BINARY_RECORD;
+            return r.payload >= BINARY_HEADER && r.payload % 8 == 0 &&
+                   r.payload <= doc->nodes_end &&
+                   r.count <= (doc->nodes_end - r.payload) / stride ? 0 : -1;
+        }
+        case JSON_NUMBER:
+        case JSON_TRUE:
+        case JSON_FALSE:
+        case JSON_NULL:
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+int json_load_binary(const void *data, size_t length, json_view_t *root) {
+    binary_header_t header;
+    
+    if (!data || !root || length < sizeof(header) || (uintptr_t)data % 8 != 0) return -1;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, BINARY_MAGIC, 4) != 0 || header.bom != BINARY_BOM) return -1;
+    if (header.size > length || header.strings < BINARY_HEADER || header.strings > header.size ||
+        header.strings_size != header.size - header.strings) {
+        return -1;
+    }
+    
+    json_view_t doc;
+    memset(&doc, 0, sizeof(doc));
+    doc.base = data;
+    doc.nodes_end = (size_t)header.strings;
+    doc.strings = doc.base + header.strings;
+    doc.strings_size = (size_t)header.strings_size;
+    return binary_view(&doc, doc.base + offsetof(binary_header_t, root), root);
+}
+
+size_t json_view_size(const json_view_t *view) {
+    if (!view || (view->type != JSON_ARRAY && view->type != JSON_OBJECT)) return 0;
+    return view->count;
+}
+
+int json_view_array_get(const json_view_t *array, size_t index, json_view_t *out) {
+    if (!array || array->type != JSON_ARRAY || index >= array->count) return -1;
+    
+    const unsigned char *block = array->base + array->payload;
+    if (array->flags & BINARY_TYPED) {
+        *out = *array;
+        out->type = JSON_NUMBER;
+        out->flags = 0;
+        out->count = 0;
+        memcpy(&out->payload, block + index * sizeof(double), sizeof(double));
+        return 0;
+    }
+    return binary_view(array, block + index * BINARY_RECORD, out);
+}
+
+int json_view_member(const json_view_t *object, size_t index, const char **key, json_view_t *out) {
+    json_view_t name;
+    
+    if (!object || object->type != JSON_OBJECT || index >= object->count) return -1;
+    
+    const unsigned char *member = object->base + object->payload + index * BINARY_MEMBER;
+    if (binary_view(object, member, &name) != 0 || name.type != JSON_STRING) return -1;
+    if (key) *key = (const char *)name.strings + name.payload;
+    return binary_view(object, member + BINARY_RECORD, out);
+}
+
+int json_view_object_get(const json_view_t *object, const char *key, json_view_t *out) {
+    if (!object || !key || object->type != JSON_OBJECT) return -1;
+    
+    size_t len = strlen(key);
+    const unsigned char *member = object->base + object->payload;
+    for (size_t i = 0; i < object->count; i++, member += BINARY_MEMBER) {
+        binary_record_t name;
+        memcpy(&name, member, sizeof(name));
+        if (name.count == len && name.payload < object->strings_size &&
+            len < object->strings_size - name.payload &&
+            memcmp(object->strings + name.payload, key, len) == 0) {
+            return binary_view(object, member + BINARY_RECORD, out);
+        }
+    }
+    return -1;
+}
+
+const char* json_view_string(const json_view_t *view, size_t *length) {
+    if (!view || view->type != JSON_STRING) return NULL;
+    if (length) *length = view->count;
+    return (const char *)view->strings + view->payload;
+}
+
+double json_view_number(const json_view_t *view) {
+    double value = 0;
+    if (view && view->type == JSON_NUMBER) memcpy(&value, &view->payload, sizeof(double));
+    return value;
+}
+
+// Transcoding between JSON text and MessagePack or CBOR without a tree.
+// Both binary formats give a container's size before its elements, so
+// JSON input is read twice: the scanner validates it and counts the
+// elements of every container in the order they open, then a lighter
+// walk over the now trusted text emits. Nothing is written for invalid
+// input.
+#define TRANSCODE_MSGPACK 0
+#define TRANSCODE_CBOR    1
+#define TRANSCODE_BUFFER  (16 * 1024)
+
+typedef struct {
+    print_buffer_t out;
+    int format;
+    char *scratch;          // Unescaped strings
+    size_t scratch_size;
+} transcoder_t;
+
+static void emit_byte(transcoder_t *t, unsigned char byte) {
+    print_raw(&t->out, (const char *)&byte, 1);
+}
+
+// Big-endian value of `bytes` bytes after a lead byte
+static void emit_be(transcoder_t *t, unsigned char lead, uint64_t value, int bytes) {
+    unsigned char buf[9];
+    buf[0] = lead;
+    for (int i = bytes; i > 0; i--) {
+        buf[i] = (unsigned char)value;
+        value >>= 8;
+    }
+    print_raw(&t->out, (const char *)buf, (size_t)bytes + 1);
+}
+
+// CBOR head: major type and argument in the shortest form
+static void cbor_head(transcoder_t *t, int major, uint64_t value) {
+    unsigned char lead = (unsigned char)(major << 5);
+    if (value < 24) emit_byte(t, lead | (unsigned char)value);
+    else if (value <= 0xff) emit_be(t, lead | 24, value, 1);
+    else if (value <= 0xffff) emit_be(t, lead | 25, value, 2);
+    else if (value <= 0xffffffffu) emit_be(t, lead | 26, value, 4);
+    else emit_be(t, lead | 27, value, 8);
+}
+
+// MessagePack head for strings, arrays and maps: fix form, then 8/16/32
+static void msgpack_head(transcoder_t *t, int token, size_t n) {
+    switch (token) {
+        case JSON_TOKEN_STRING:
+            if (n < 32) emit_byte(t, 0xa0 | (unsigned char)n);
+            else if (n <= 0xff) emit_be(t, 0xd9, n, 1);
+            else if (n <= 0xffff) emit_be(t, 0xda, n, 2);
+            else emit_be(t, 0xdb, n, 4);
+            break;
+        case JSON_TOKEN_ARRAY_BEGIN:
+            if (n < 16) emit_byte(t, 0x90 | (unsigned char)n);
+            else if (n <= 0xffff) emit_be(t, 0xdc, n, 2);
+            else emit_be(t, 0xdd, n, 4);
+            break;
+        default:
+            if (n < 16) emit_byte(t, 0x80 | (unsigned char)n);
+            else if (n <= 0xffff) emit_be(t, 0xde, n, 2);
+            else emit_be(t, 0xdf, n, 4);
+            break;
+    }
+}
+
+static void emit_container(transcoder_t *t, int token, size_t n) {
+    if (t->format == TRANSCODE_CBOR) cbor_head(t, token == JSON_TOKEN_ARRAY_BEGIN ? 4 : 5, n);
+    else msgpack_head(t, token, n);
+}
+
+static void emit_string(transcoder_t *t, const char *str, size_t len) {
+    if (t->format == TRANSCODE_CBOR) cbor_head(t, 3, len);
+    else msgpack_head(t, JSON_TOKEN_STRING, len);
+    print_raw(&t->out, str, len);
+}
+
+static void emit_double(transcoder_t *t, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    emit_be(t, t->format == TRANSCODE_CBOR ? 0xfb : 0xcb, bits, 8);
+}
+
+// Integers take the smallest encoding; magnitude is |value| and for
+// negatives is at most 2^63
+static void emit_integer(transcoder_t *t, int negative, uint64_t magnitude) {
+    if (t->format == TRANSCODE_CBOR) {
+        if (negative) cbor_head(t, 1, magnitude - 1);
+        else cbor_head(t, 0, magnitude);
+        return;
+    }
+    
+    if (!negative) {
+        if (magnitude < 128) emit_byte(t, (unsigned char)magnitude);
+        else if (magnitude <= 0xff) emit_be(t, 0xcc, magnitude, 1);
+        else if (magnitude <= 0xffff) emit_be(t, 0xcd, magnitude, 2);
+        else if (magnitude <= 0xffffffffu) emit_be(t, 0xce, magnitude, 4);
+        else emit_be(t, 0xcf, magnitude, 8);
+        return;
+    }
+    
+    uint64_t bits = (uint64_t)0 - magnitude;  // Two's complement of -magnitude
+    if (magnitude <= 32) emit_byte(t, (unsigned char)bits);
+    else if (magnitude <= 0x80) emit_be(t, 0xd0, bits & 0xff, 1);
+    else if (magnitude <= 0x8000) emit_be(t, 0xd1, bits & 0xffff, 2);
+    else if (magnitude <= 0x80000000u) emit_be(t, 0xd2, bits & 0xffffffffu, 4);
+    else emit_be(t, 0xd3, bits, 8);
+}
+
+// Numbers without a fraction or exponent that fit 64 bits stay integers
+static void emit_number(transcoder_t *t, const char *text, size_t len) {
+    int negative = text[0] == '-';
+    uint64_t magnitude = 0;
+    size_t i = (size_t)negative;
+    
+    for (; i < len; i++) {
+        unsigned digit = (unsigned char)text[i] - '0';
+        if (digit > 9 || magnitude > (UINT64_MAX - digit) / 10) break;
+        magnitude = magnitude * 10 + digit;
+    }
+    if (i == len && (!negative || (magnitude != 0 && magnitude <= (uint64_t)1 << 63))) {
+        emit_integer(t, negative, magnitude);
+        return;
+    }
+    
+    // strtod needs a terminated copy; JSON numbers are short
+    char local[64];
+    char *copy = len < sizeof(local) ? local : mem_alloc(&global_allocator, len + 1);
+    if (!copy) {
+        t->out.failed = 1;
+        return;
+    }
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+    emit_double(t, strtod(copy, NULL));
+    if (copy != local) mem_free(&global_allocator, copy);
+}
+
+// A string or key token, quotes included
+static void emit_string_token(transcoder_t *t, const char *token, size_t len) {
+    const char *body = token + 1;
+    size_t body_len = len - 2;
+    
+    if (!memchr(body, '\\', body_len)) {
+        emit_string(t, body, body_len);
+        return;
+    }
+    
+    if (t->scratch_size < body_len) {
+        char *grown = global_allocator.realloc_fn(global_allocator.ctx, t->scratch, body_len);
+        if (!grown) {
+            t->out.failed = 1;
+            return;
+        }
+        t->scratch = grown;
+        t->scratch_size = body_len;
+    }
+    size_t decoded = decode_string(body, body_len, t->scratch);
+    if (decoded == (size_t)-1) {
+        t->out.failed = 1;
+        return;
+    }
+    emit_string(t, t->scratch, decoded);
+}
+
+// First pass: validate and count the elements of each container, indexed
+// by the order in which containers open. *out is NULL if there are none.
+static int count_containers(const char *json, size_t length, size_t **out) {
+    json_scanner_t s;
+    size_t stack[JSON_MAX_DEPTH];
+    int depth = 0;
+    size_t *counts = NULL;
+    size_t capacity = 0;
+    size_t n = 0;
+    int token;
+    
+    json_scanner_init(&s, json, length);
+    while ((token = json_scanner_next(&s)) > JSON_TOKEN_END) {
+        if (token == JSON_TOKEN_KEY) continue;
+        if (token == JSON_TOKEN_OBJECT_END || token == JSON_TOKEN_ARRAY_END) {
+            depth--;
+            continue;
+        }
+        
+        if (depth > 0) counts[stack[depth - 1]]++;
+        if (token == JSON_TOKEN_OBJECT_BEGIN || token == JSON_TOKEN_ARRAY_BEGIN) {
+            if (n == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                size_t *grown = global_allocator.realloc_fn(global_allocator.ctx, counts,
+                                                            capacity * sizeof(size_t));
+                if (!grown) break;
+                counts = grown;
+            }
+            counts[n] = 0;
+            stack[depth++] = n++;
+        }
+    }
+    
+    if (token != JSON_TOKEN_END) {
+        mem_free(&global_allocator, counts);
+        return -1;
+    }
+    *out = counts;
+    return 0;
+}
+
+// Second pass, over text the first pass validated: tokens are found
+// without checking grammar or UTF-8 again, and keys encode like any string
+static void emit_validated(transcoder_t *t, const char *p, const char *end, const size_t *counts) {
+    size_t next = 0;
+    
+    while (p < end && !t->out.failed) {
+        const char *start = p;
+        switch (*p) {
+            case '{':
+                emit_container(t, JSON_TOKEN_OBJECT_BEGIN, counts[next++]);
+                p++;
+                break;
+            case '[':
+                emit_container(t, JSON_TOKEN_ARRAY_BEGIN, counts[next++]);
+                p++;
+                break;
+            case '"':
+                p = scan_plain(p + 1, end);
+                while (*p == '\\') p = scan_plain(p + 2, end);
+                p++;
+                emit_string_token(t, start, (size_t)(p - start));
+                break;
+            case 't':
+                emit_byte(t, t->format == TRANSCODE_CBOR ? 0xf5 : 0xc3);
+                p += 4;
+                break;
+            case 'f':
+                emit_byte(t, t->format == TRANSCODE_CBOR ? 0xf4 : 0xc2);
+                p += 5;
+                break;
+            case 'n':
+                emit_byte(t, t->format == TRANSCODE_CBOR ? 0xf6 : 0xc0);
+                p += 4;
+                break;
+            case '-': case '0': case '1': case '2': case '3': case '4':
+            case '5': case '6': case '7': case '8': case '9':
+                p++;
+                while (p < end && ((*p >= '0' && *p <= '9') || *p == '.' || *p == 'e' ||
+                                   *p == 'E' || *p == '+' || *p == '-')) {
+                    p++;
+                }
+                emit_number(t, start, (size_t)(p - start));
+                break;
+            default:
+                p = skip_space(p + 1, end);  // Separators, closing brackets, whitespace
+                break;
+        }
+    }
+}
+
+static int json_to_binary(const char *json, size_t length, json_write_fn write, void *ctx, int format) {
+    transcoder_t t;
+    char buffer[TRANSCODE_BUFFER];
+    size_t *counts;
+    
+    if (!json || !write || count_containers(json, length, &counts) != 0) return -1;
+    
+    memset(&t, 0, sizeof(t));
+    t.out.buffer = buffer;
+    t.out.capacity = sizeof(buffer);
+    t.out.fixed = 1;
+    t.out.flush = write;
+    t.out.flush_ctx = ctx;
+    t.format = format;
+    
+    emit_validated(&t, json, json + length, counts);
+    print_flush(&t.out);
+    
+    mem_free(&global_allocator, counts);
+    mem_free(&global_allocator, t.scratch);
+    return t.out.failed ? -1 : 0;
+}
+
+int json_to_msgpack(const char *json, size_t length, json_write_fn write, void *ctx) {
+    return json_to_binary(json, length, write, ctx, TRANSCODE_MSGPACK);
+}
+
+int json_to_cbor(const char *json, size_t length, json_write_fn write, void *ctx) {
+    return json_to_binary(json, length, write, ctx, TRANSCODE_CBOR);
+}
+
+// Reading side: one value at a time into the streaming writer, with the
+// open containers on an explicit stack
+typedef struct {
+    const unsigned char *p;
+    const unsigned char *end;
+    json_writer_t *w;
+    int depth;
+    uint64_t remaining[JSON_MAX_DEPTH];  // Keys and values left; open-ended
+                                         // containers count up instead
+    unsigned char is_map[JSON_MAX_DEPTH];
+    unsigned char indefinite[JSON_MAX_DEPTH];
+    char *chunks;           // Open-ended CBOR text, joined
+    size_t chunks_size;
+} decoder_t;
+
+static int read_be(decoder_t *d, int bytes, uint64_t *value) {
+    if (d->end - d->p < bytes) return -1;
+    *value = 0;
+    for (int i = 0; i < bytes; i++) *value = (*value << 8) | *d->p++;
+    return 0;
+}
+
+// Is text well-formed UTF-8? ASCII goes eight bytes at a time.
+static int utf8_valid(const char *text, size_t len) {
+    const unsigned char *p = (const unsigned char *)text;
+    const unsigned char *end = p + len;
+    unsigned state = UTF8_ACCEPT;
+    
+    while (p < end) {
+        uint64_t chunk;
+        if (state == UTF8_ACCEPT && end - p >= 8) {
+            memcpy(&chunk, p, sizeof(chunk));
+            if (!(chunk & 0x8080808080808080ULL)) {
+                p += 8;
+                continue;
+            }
+        }
+        state = utf8_dfa[256 + state + utf8_dfa[*p++]];
+        if (state == UTF8_REJECT) return 0;
+    }
+    return state == UTF8_ACCEPT;
+}
+
+// Write a key or a string value, depending on where it falls. Text that
+// is not UTF-8 has no JSON form.
+static int decode_text(decoder_t *d, uint64_t len, int is_key) {
+    if ((uint64_t)(d->end - d->p) < len) return -1;
+    const char *text = (const char *)d->p;
+    if (!utf8_valid(text, (size_t)len)) return -1;
+    d->p += len;
+    return is_key ? writer_key_len(d->w, text, (size_t)len)
+                  : json_writer_string_len(d->w, text, (size_t)len);
+}
+
+// Open-ended CBOR text: definite-length text chunks up to a break, joined
+// into one string. A chunk may not split a character, so each is checked
+// as UTF-8 on its own.
+static int decode_text_chunks(decoder_t *d, int is_key) {
+    size_t len = 0;
+    
+    while (1) {
+        if (d->p >= d->end) return -1;
+        unsigned char c = *d->p++;
+        if (c == 0xff) break;
+        if (c >> 5 != 3) return -1;  // Chunks are text of a stated length
+        
+        uint64_t chunk = c & 0x1f;
+        if (chunk >= 24 && (chunk > 27 || read_be(d, 1 << (chunk - 24), &chunk) != 0)) return -1;
+        if ((uint64_t)(d->end - d->p) < chunk || !utf8_valid((const char *)d->p, (size_t)chunk)) return -1;
+        
+        if (d->chunks_size - len < chunk) {
+            size_t size = d->chunks_size ? d->chunks_size : 256;
+            while (size - len < chunk) size *= 2;
+            char *grown = global_allocator.realloc_fn(global_allocator.ctx, d->chunks, size);
+            if (!grown) return -1;
+            d->chunks = grown;
+            d->chunks_size = size;
+        }
+        memcpy(d->chunks + len, d->p, (size_t)chunk);
+        len += (size_t)chunk;
+        d->p += chunk;
+    }
+    return is_key ? writer_key_len(d->w, d->chunks, len)
+                  : json_writer_string_len(d->w, d->chunks, len);
+}
+
+static int decode_open(decoder_t *d, uint64_t count, int is_map, int indefinite) {
+    if (d->depth >= JSON_MAX_DEPTH) return -1;
+    if (!indefinite && count > (uint64_t)(d->end - d->p)) return -1;  // Each item takes a byte
+    
+    int status = is_map ? json_writer_begin_object(d->w) : json_writer_begin_array(d->w);
+    d->remaining[d->depth] = is_map ? count * 2 : count;
+    d->is_map[d->depth] = (unsigned char)is_map;
+    d->indefinite[d->depth] = (unsigned char)indefinite;
+    d->depth++;
+    return status;
+}
+
+static int decode_integer(decoder_t *d, int negative, uint64_t value) {
+    // CBOR negatives carry -1 - n; MessagePack passes the value itself
+    if (negative) {
+        if (value > (uint64_t)INT64_MAX) return json_writer_number(d->w, -1.0 - (double)value);
+        return json_writer_integer(d->w, -1 - (long long)value);
+    }
+    if (value > (uint64_t)INT64_MAX) return json_writer_number(d->w, (double)value);
+    return json_writer_integer(d->w, (long long)value);
+}
+
+static int decode_double(decoder_t *d, uint64_t bits, int bytes) {
+    double value;
+    
+    if (bytes == 8) {
+        memcpy(&value, &bits, sizeof(value));
+    } else if (bytes == 4) {
+        float single;
+        uint32_t b = (uint32_t)bits;
+        memcpy(&single, &b, sizeof(single));
+        value = single;
+    } else {
+        // IEEE half precision, from the CBOR specification
+        int exponent = (int)(bits >> 10) & 0x1f;
+        int mantissa = (int)bits & 0x3ff;
+        if (exponent == 0) value = ldexp(mantissa, -24);
+        else if (exponent != 31) value = ldexp(mantissa + 1024, exponent - 25);
+        else value = mantissa == 0 ? INFINITY : NAN;
+        if (bits & 0x8000) value = -value;
+    }
+    return json_writer_number(d->w, value);
+}
+
+static int decode_msgpack_value(decoder_t *d, int is_key) {
+    uint64_t v;
+    unsigned char c = *d->p++;
+    
+    if (c <= 0x7f) return is_key ? -1 : json_writer_integer(d->w, c);
+    if (c >= 0xe0) return is_key ? -1 : json_writer_integer(d->w, (signed char)c);
+    if ((c & 0xe0) == 0xa0) return decode_text(d, c & 0x1f, is_key);
+    if (c == 0xd9 || c == 0xda || c == 0xdb) {
+        if (read_be(d, 1 << (c - 0xd9), &v) != 0) return -1;
+        return decode_text(d, v, is_key);
+    }
+    if (is_key) return -1;  // JSON keys are strings
+    
+    if ((c & 0xf0) == 0x80) return decode_open(d, c & 0x0f, 1, 0);
+    if ((c & 0xf0) == 0x90) return decode_open(d, c & 0x0f, 0, 0);
+    
+    switch (c) {
+        case 0xc0: return json_writer_null(d->w);
+        case 0xc2: return json_writer_bool(d->w, 0);
+        case 0xc3: return json_writer_bool(d->w, 1);
+        case 0xca:
+            if (read_be(d, 4, &v) != 0) return -1;
+            return decode_double(d, v, 4);
+        case 0xcb:
+            if (read_be(d, 8, &v) != 0) return -1;
+            return decode_double(d, v, 8);
+        case 0xcc: case 0xcd: case 0xce: case 0xcf:
+            if (read_be(d, 1 << (c - 0xcc), &v) != 0) return -1;
+            return decode_integer(d, 0, v);
+        case 0xd0: case 0xd1: case 0xd2: case 0xd3: {
+            int bytes = 1 << (c - 0xd0);
+            if (read_be(d, bytes, &v) != 0) return -1;
+            if (bytes < 8 && (v >> (bytes * 8 - 1))) v |= ~(uint64_t)0 << (bytes * 8);  // Sign-extend
+            int64_t value;
+            memcpy(&value, &v, sizeof(value));
+            return json_writer_integer(d->w, (long long)value);
+        }
+        case 0xdc: case 0xdd:
+            if (read_be(d, c == 0xdc ? 2 : 4, &v) != 0) return -1;
+            return decode_open(d, v, 0, 0);
+        case 0xde: case 0xdf:
+            if (read_be(d, c == 0xde ? 2 : 4, &v) != 0) return -1;
+            return decode_open(d, v, 1, 0);
+        default:
+            return -1;  // bin, ext and the unused byte have no JSON form
+    }
+}
+
+static int decode_cbor_value(decoder_t *d, int is_key) {
+    uint64_t v = 0;
+    unsigned char c = *d->p++;
+    int major = c >> 5;
+    int info = c & 0x1f;
+    
+    // Semantic tags annotate the next item; JSON keeps only the item
+    while (major == 6) {
+        if (info >= 24 && (info > 27 || read_be(d, 1 << (info - 24), &v) != 0)) return -1;
+        if (d->p >= d->end) return -1;
+        c = *d->p++;
+        major = c >> 5;
+        info = c & 0x1f;
+    }
+    
+    if (major == 7) {
+        if (is_key) return -1;
+        switch (info) {
+            case 20: return json_writer_bool(d->w, 0);
+            case 21: return json_writer_bool(d->w, 1);
+            case 22: return json_writer_null(d->w);
+            case 25: case 26: case 27:
+                if (read_be(d, 1 << (info - 24), &v) != 0) return -1;
+                return decode_double(d, v, 1 << (info - 24));
+            default: return -1;  // undefined, other simple values, break
+        }
+    }
+    
+    int indefinite = info == 31;
+    if (info < 24) {
+        v = (uint64_t)info;
+    } else if (info <= 27) {
+        if (read_be(d, 1 << (info - 24), &v) != 0) return -1;
+    } else if (!indefinite || major < 3) {
+        return -1;  // Only text, arrays and maps may be open-ended here
+    }
+    
+    if (major == 3) return indefinite ? decode_text_chunks(d, is_key) : decode_text(d, v, is_key);
+    if (is_key) return -1;
+    switch (major) {
+        case 0: return decode_integer(d, 0, v);
+        case 1: return decode_integer(d, 1, v);
+        case 4: return decode_open(d, indefinite ? 0 : v, 0, indefinite);
+        case 5: return decode_open(d, indefinite ? 0 : v, 1, indefinite);
+        default: return -1;  // Byte strings
+    }
+}
+
+static int binary_to_json(const void *data, size_t length, json_write_fn write, void *ctx,
+                          int format, int output_format) {
+    decoder_t *d;
+    int status = 0;
+    
+    if (!data || !write || length == 0) return -1;
+    d = mem_alloc(&global_allocator, sizeof(decoder_t));
+    if (!d) return -1;
+    d->p = data;
+    d->end = d->p + length;
+    d->depth = 0;
+    d->chunks = NULL;
+    d->chunks_size = 0;
+    d->w = json_writer_new(write, ctx, TRANSCODE_BUFFER, output_format);
+    if (!d->w) {
+        mem_free(&global_allocator, d);
+        return -1;
+    }
+    
+    do {
+        // Close every container that is complete
+        while (d->depth > 0 && status == 0) {
+            int top = d->depth - 1;
+            if (d->indefinite[top]) {
+                if (d->p >= d->end) status = -1;
+                else if (*d->p != 0xff) break;
+                else if (d->is_map[top] && d->remaining[top] % 2) status = -1;  // Key without value
+                else d->p++;
+            } else if (d->remaining[top] > 0) {
+                break;
+            }
+            if (status == 0) {
+                status = d->is_map[top] ? json_writer_end_object(d->w) : json_writer_end_array(d->w);
+                d->depth--;
+            }
+        }
+        if (status != 0 || (d->depth == 0 && d->p != data)) break;
+        if (d->p >= d->end) {
+            status = -1;
+            break;
+        }
+        
+        // Map entries alternate key, value; either count is even at a key
+        int is_key = 0;
+        if (d->depth > 0) {
+            int top = d->depth - 1;
+            is_key = d->is_map[top] && d->remaining[top] % 2 == 0;
+            if (d->indefinite[top]) d->remaining[top]++;
+            else d->remaining[top]--;
+        }
+        status = format == TRANSCODE_CBOR ? decode_cbor_value(d, is_key) : decode_msgpack_value(d, is_key);
+    } while (status == 0);
+    
+    if (status == 0 && d->p != d->end) status = -1;  // Trailing bytes
+    if (json_writer_flush(d->w) != 0) status = -1;
+    json_writer_free(d->w);
+    mem_free(&global_allocator, d->chunks);
+    mem_free(&global_allocator, d);
+    return status;
+}
+
+int json_from_msgpack(const void *data, size_t length, json_write_fn write, void *ctx, int format) {
+    return binary_to_json(data, length, write, ctx, TRANSCODE_MSGPACK, format);
+}
+
+int json_from_cbor(const void *data, size_t length, json_write_fn write, void *ctx, int format) {
+    return binary_to_json(data, length, write, ctx, TRANSCODE_CBOR, format);
+}
+
+// Structural hashes: 32-bit, cached in the nodes and built bottom-up, so
+// a container's hash is computed from its children's cached ones. Objects
+// sum over their members to make key order irrelevant.
+static uint32_t hash_mix(uint32_t h) {
+    h ^= h >> 16;  // Murmur3 finalizer
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static uint32_t hash_number(double value) {
+    uint64_t bits;
+    if (value == 0) value = 0;  // -0 equals 0
+    memcpy(&bits, &value, sizeof(bits));
+    return hash_mix((uint32_t)bits ^ hash_mix((uint32_t)(bits >> 32)));
+}
+
+// Eight bytes per step; strings are most of a document's bytes
+static uint32_t hash_string(const char *s) {
+    if (!s) return 0;
+    
+    size_t len = strlen(s);
+    uint64_t h = len * 0x9e3779b97f4a7c15ull;
+    uint64_t word;
+    for (; len >= 8; len -= 8, s += 8) {
+        memcpy(&word, s, 8);
+        h = (h ^ word) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
+    word = 0;
+    memcpy(&word, s, len);
+    h = (h ^ word) * 0xff51afd7ed558ccdull;
+    return hash_mix((uint32_t)h ^ (uint32_t)(h >> 32));
+}
+
+// Hash of json from its own fields and its children's cached hashes
+static uint32_t hash_node(const json_t *json) {
+    uint32_t h = hash_mix((uint32_t)json->type + 1);
+    uint32_t members = 0;
+    
+    switch (json->type) {
+        case JSON_NUMBER:
+            h ^= hash_number(json->valuenumber);
+            break;
+        case JSON_STRING:
+            h ^= hash_string(json->valuestring);
+            break;
+        case JSON_ARRAY:
+            for (const json_t *child = json->child; child; child = child->next) {
+                h = hash_mix(h * 31 + child->hash);
+            }
+            break;
+        case JSON_OBJECT:
+            for (const json_t *child = json->child; child; child = child->next) {
+                members += hash_mix(hash_string(child->string) ^ (child->hash * 0x9e3779b9u));
+            }
+            h ^= hash_mix(members);
+            break;
+    }
+    return h ? h : 1;  // 0 means not computed
+}
+
+static uint32_t hash_tree(json_t *json) {
+    if (json->hash) return json->hash;
+    for (json_t *child = json->child; child; child = child->next) {
+        hash_tree(child);
+    }
+    json->hash = hash_node(json);
+    return json->hash;
+}
+
+uint32_t json_hash(const json_t *json) {
+    // The cache is not part of the value, so const trees are hashed too
+    return json ? hash_tree((json_t *)json) : 0;
+}
+
+void json_hash_clear(json_t *json) {
+    if (!json) return;
+    json->hash = 0;
+    for (json_t *child = json->child; child; child = child->next) {
+        json_hash_clear(child);
+    }
+}
+
+static int keys_equal(const json_t *a, const json_t *b) {
+    if (!a->string || !b->string) return a->string == b->string;
+    return strcmp(a->string, b->string) == 0;
+}
+
+static int compare_keys(const void *a, const void *b) {
+    const char *x = (*(const json_t *const *)a)->string;
+    const char *y = (*(const json_t *const *)b)->string;
+    if (!x || !y) return (x != NULL) - (y != NULL);
+    return strcmp(x, y);
+}
+
+// Pair every member of x with an equal one of y, reordering y; members
+// with the same key pair in any order
+static int match_members(const json_t **x, const json_t **y, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        size_t j = i;
+        while (j < count && !(keys_equal(x[i], y[j]) && json_equal(x[i], y[j]))) j++;
+        if (j == count) return 0;
+        const json_t *swap = y[i];
+        y[i] = y[j];
+        y[j] = swap;
+    }
+    return 1;
+}
+
+// Members left after the common prefix in the same order: few are
+// matched directly, more are sorted by key and matched run by run
+#define MATCH_DIRECT 16
+
+static int members_equal(const json_t *x, const json_t *y, size_t count) {
+    const json_t *stack[2 * MATCH_DIRECT];
+    const json_t **members = count <= MATCH_DIRECT ? stack : mem_alloc(&global_allocator, 2 * count * sizeof(json_t *));
+    
+    if (!members) {
+        // Out of memory: search y for every member of x, which is exact
+        // unless keys repeat
+        for (; x; x = x->next) {
+            const json_t *match = y;
+            while (match && !(keys_equal(x, match) && json_equal(x, match))) match = match->next;
+            if (!match) return 0;
+        }
+        return 1;
+    }
+    
+    const json_t **xs = members, **ys = members + count;
+    for (size_t i = 0; i < count; i++, x = x->next, y = y->next) {
+        xs[i] = x;
+        ys[i] = y;
+    }
+    
+    int equal;
+    if (count <= MATCH_DIRECT) {
+        equal = match_members(xs, ys, count);
+    } else {
+        qsort(xs, count, sizeof(json_t *), compare_keys);
+        qsort(ys, count, sizeof(json_t *), compare_keys);
+        equal = 1;
+        for (size_t i = 0, run; equal && i < count; i += run) {
+            for (run = 1; i + run < count && keys_equal(xs[i], xs[i + run]); run++);
+            equal = match_members(&xs[i], &ys[i], run);
+        }
+        mem_free(&global_allocator, members);
+    }
+    return equal;
+}
+
+static int objects_equal(const json_t *a, const json_t *b) {
+    // Usually the members are in the same order and need no search
+    const json_t *x = a->child, *y = b->child;
+    while (x && y && keys_equal(x, y)) {
+        if (!json_equal(x, y)) {
+            // Final unless the key repeats and could pair differently
+            const json_t *m = x->next;
+            while (m && !keys_equal(x, m)) m = m->next;
+            if (!m) return 0;
+            break;
+        }
+        x = x->next;
+        y = y->next;
+    }
+    if (!x && !y) return 1;
+    
+    size_t count = 0, other = 0;
+    for (const json_t *m = x; m; m = m->next) count++;
+    for (const json_t *m = y; m; m = m->next) other++;
+    return count == other && members_equal(x, y, count);
+}
+
+int json_equal(const json_t *a, const json_t *b) {
+    if (a == b) return 1;
+    if (!a || !b || a->type != b->type) return 0;
+    if (a->hash && b->hash && a->hash != b->hash) return 0;
+    
+    switch (a->type) {
+        case JSON_NUMBER:
+            return a->valuenumber == b->valuenumber;
+        case JSON_STRING:
+            if (!a->valuestring || !b->valuestring) return a->valuestring == b->valuestring;
+            return strcmp(a->valuestring, b->valuestring) == 0;
+        case JSON_ARRAY: {
+            const json_t *x = a->child, *y = b->child;
+            for (; x && y; x = x->next, y = y->next) {
+                if (!json_equal(x, y)) return 0;
+            }
+            return !x && !y;
+        }
+        case JSON_OBJECT:
+            return objects_equal(a, b);
+        default:
+            return 1;
+    }
+}
+
+// Arenas: a chain of blocks, bump-allocated from the newest
+#define ARENA_BLOCK (64 * 1024)
+#define ARENA_ALIGN 16
+
+typedef struct arena_block {
+    struct arena_block *next;
+} arena_block_t;
+
+struct json_arena {
+    arena_block_t *blocks;
+    char *next;         // Free space in the current block
+    char *end;
+    size_t block_size;
+};
+
+// Block headers take one aligned slot so the memory after them is aligned
+#define ARENA_HEADER ((sizeof(arena_block_t) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+json_arena_t* json_arena_new(size_t block_size) {
+    json_arena_t *arena = mem_alloc(&global_allocator, sizeof(json_arena_t));
+    if (!arena) return NULL;
+    arena->blocks = NULL;
+    arena->next = NULL;
+    arena->end = NULL;
+    arena->block_size = block_size ? block_size : ARENA_BLOCK;
+    return arena;
+}
+
+void json_arena_free(json_arena_t *arena) {
+    if (!arena) return;
+    arena_block_t *block = arena->blocks;
+    while (block) {
+        arena_block_t *next = block->next;
+        mem_free(&global_allocator, block);
+        block = next;
+    }
+    mem_free(&global_allocator, arena);
+}
+
+static void* arena_alloc(json_arena_t *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if ((size_t)(arena->end - arena->next) >= size) {
+        void *ptr = arena->next;
+        arena->next += size;
+        return ptr;
+    }
+    
+    // Large requests get their own block and keep the current one going
+    int own = size > arena->block_size / 4;
+    size_t capacity = own ? size : arena->block_size;
+    arena_block_t *block = mem_alloc(&global_allocator, ARENA_HEADER + capacity);
+    if (!block) return NULL;
+    
+    char *memory = (char *)block + ARENA_HEADER;
+    if (own && arena->blocks) {
+        block->next = arena->blocks->next;  // Behind the current block
+        arena->blocks->next = block;
+        return memory;
+    }
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->next = memory + size;
+    arena->end = memory + capacity;
+    return memory;
+}
+
+// Copies: one pass sizes the subtree, the second fills a single block
+// with the nodes in document order, then all of their strings
+typedef struct {
+    json_t *node;
+    char *text;
+} copy_cursor_t;
+
+static void copy_size(const json_t *json, size_t *nodes, size_t *bytes) {
+    (*nodes)++;
+    if (json->valuestring) *bytes += strlen(json->valuestring) + 1;
+    if (json->string) *bytes += strlen(json->string) + 1;
+    for (const json_t *child = json->child; child; child = child->next) {
+        copy_size(child, nodes, bytes);
+    }
+}
+
+static char* copy_text(copy_cursor_t *c, const char *text) {
+    if (!text) return NULL;
+    size_t len = strlen(text) + 1;
+    char *copy = memcpy(c->text, text, len);
+    c->text += len;
+    return copy;
+}
+
+static json_t* copy_tree(copy_cursor_t *c, const json_t *json) {
+    json_t *copy = c->node++;
+    copy->next = NULL;
+    copy->prev = NULL;
+    copy->child = NULL;
+    copy->type = json->type;
+    copy->hash = json->hash;
+    copy->valuestring = copy_text(c, json->valuestring);
+    copy->valuenumber = json->valuenumber;
+    copy->string = copy_text(c, json->string);
+    
+    json_t *last = NULL;
+    for (const json_t *child = json->child; child; child = child->next) {
+        json_t *item = copy_tree(c, child);
+        item->prev = last;
+        if (last) last->next = item;
+        else copy->child = item;
+        last = item;
+    }
+    if (last) copy->child->prev = last;
+    return copy;
+}
+
+json_t* json_duplicate(const json_t *json, json_arena_t *arena) {
+    if (!json) return NULL;
+    
+    size_t nodes = 0, bytes = 0;
+    copy_size(json, &nodes, &bytes);
+    size_t size = nodes * sizeof(json_t) + bytes;
+    
+    json_t *block = arena ? arena_alloc(arena, size) : mem_alloc(&global_allocator, size);
+    if (!block) return NULL;
+    copy_cursor_t cursor = { block, (char *)(block + nodes) };
+    return copy_tree(&cursor, json);
+}
+
+// Building and changing trees. Nodes and strings come from the arena when
+// one is given; values that are replaced or removed are freed only when
+// not, since arena memory goes away with the arena.
+static json_t* new_node(json_arena_t *arena, int type) {
+    json_t *json = arena ? arena_alloc(arena, sizeof(json_t)) : mem_alloc(&global_allocator, sizeof(json_t));
+    if (json) {
+        memset(json, 0, sizeof(json_t));
+        json->type = type;
+    }
+    return json;
+}
+
+static char* new_string(json_arena_t *arena, const char *s) {
+    size_t len = strlen(s) + 1;
+    char *copy = arena ? arena_alloc(arena, len) : mem_alloc(&global_allocator, len);
+    return copy ? memcpy(copy, s, len) : NULL;
+}
+
+static void drop_tree(json_t *json, json_arena_t *arena) {
+    if (!arena) delete_tree(json, &global_allocator);
+}
+
+json_t* json_create_null(json_arena_t *arena) {
+    return new_node(arena, JSON_NULL);
+}
+
+json_t* json_create_bool(int value, json_arena_t *arena) {
+    return new_node(arena, value ? JSON_TRUE : JSON_FALSE);
+}
+
+json_t* json_create_number(double value, json_arena_t *arena) {
+    json_t *json = new_node(arena, JSON_NUMBER);
+    if (json) json->valuenumber = value;
+    return json;
+}
+
+json_t* json_create_string(const char *value, json_arena_t *arena) {
+    if (!value) return NULL;
+    
+    json_t *json = new_node(arena, JSON_STRING);
+    if (!json) return NULL;
+    json->valuestring = new_string(arena, value);
+    if (!json->valuestring) {
+        drop_tree(json, arena);
+        return NULL;
+    }
+    return json;
+}
+
+json_t* json_create_array(json_arena_t *arena) {
+    return new_node(arena, JSON_ARRAY);
+}
+
+json_t* json_create_object(json_arena_t *arena) {
+    return new_node(arena, JSON_OBJECT);
+}
+
+// Does node appear anywhere below json?
+static int subtree_holds(const json_t *json, const json_t *node) {
+    for (const json_t *child = json->child; child; child = child->next) {
+        if (child == node || subtree_holds(child, node)) return 1;
+    }
+    return 0;
+}
+
+// Only values that are in no container can be inserted, and never into
+// a container inside them, which would make a cycle. A container that is
+// in no container itself cannot be inside item, so building a tree from
+// the root or from the leaves never walks it.
+static int can_insert(const json_t *container, int type, const json_t *item) {
+    if (!container || !item || container->type != type || item == container || item->next || item->prev) {
+        return 0;
+    }
+    return !container->prev || !subtree_holds(item, container);
+}
+
+static int set_key(json_t *value, const char *key, json_arena_t *arena) {
+    char *copy = new_string(arena, key);
+    if (!copy) return -1;
+    if (!arena) mem_free(&global_allocator, value->string);
+    value->string = copy;
+    return 0;
+}
+
+int json_array_append(json_t *array, json_t *item) {
+    if (!can_insert(array, JSON_ARRAY, item)) return -1;
+    append_child(array, item);
+    array->hash = 0;
+    return 0;
+}
+
+int json_object_add(json_t *object, const char *key, json_t *value, json_arena_t *arena) {
+    if (!key || !can_insert(object, JSON_OBJECT, value)) return -1;
+    if (set_key(value, key, arena) != 0) return -1;
+    append_child(object, value);
+    object->hash = 0;
+    return 0;
+}
+
+int json_object_set(json_t *object, const char *key, json_t *value, json_arena_t *arena) {
+    if (!key || !can_insert(object, JSON_OBJECT, value)) return -1;
+    
+    json_t *old = json_object_get(object, key);
+    if (!old) return json_object_add(object, key, value, arena);
+    
+    // Same place, same key
+    if (!arena) mem_free(&global_allocator, value->string);
+    value->string = old->string;
+    old->string = NULL;
+    relink_child(object, old, value);
+    object->hash = 0;
+    drop_tree(old, arena);
+    return 0;
+}
+
+int json_array_replace(json_t *array, int index, json_t *item, json_arena_t *arena) {
+    if (!can_insert(array, JSON_ARRAY, item)) return -1;
+    
+    json_t *old = json_array_get(array, index);
+    if (!old) return -1;
+    relink_child(array, old, item);
+    array->hash = 0;
+    drop_tree(old, arena);
+    return 0;
+}
+
+json_t* json_array_detach(json_t *array, int index) {
+    json_t *item = json_array_get(array, index);
+    if (item) {
+        unlink_child(array, item);
+        array->hash = 0;
+    }
+    return item;
+}
+
+json_t* json_object_detach(json_t *object, const char *key) {
+    json_t *item = json_object_get(object, key);
+    if (item) {
+        unlink_child(object, item);
+        object->hash = 0;
+    }
+    return item;
+}
+
+int json_array_remove(json_t *array, int index, json_arena_t *arena) {
+    json_t *item = json_array_detach(array, index);
+    if (!item) return -1;
+    drop_tree(item, arena);
+    return 0;
+}
+
+int json_object_remove(json_t *object, const char *key, json_arena_t *arena) {
+    json_t *item = json_object_detach(object, key);
+    if (!item) return -1;
+    drop_tree(item, arena);
+    return 0;
 }
 
 // Helper functions for accessing objects and arrays
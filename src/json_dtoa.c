@@ -0,0 +1,467 @@
+// src/json_dtoa.c
+// Number formatting for the printer: shortest round-trip doubles (Grisu3,
+// after Loitsch, "Printing Floating-Point Numbers Quickly and Accurately
+// with Integers", with a correctly rounded fallback for the values it
+// rejects) and a table-driven integer formatter.
+#include "json.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// A floating-point value f * 2^e with a 64-bit significand
+typedef struct {
+    uint64_t f;
+    int e;
+} diyfp_t;
+
+typedef struct {
+    uint64_t f;
+    int e;
+    int k;
+} cached_power_t;
+
+// Normalized powers of ten 10^k for k = -300, -292, ..., 324
+static const cached_power_t cached_powers[] = {
+    { 0xAB70FE17C79AC6CAULL, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+    { 0xBE5691EF416BD60CULL, -1007, -284 },
+    { 0x8DD01FAD907FFC3CULL,  -980, -276 },
+    { 0xD3515C2831559A83ULL,  -954, -268 },
+    { 0x9D71AC8FADA6C9B5ULL,  -927, -260 },
+    { 0xEA9C227723EE8BCBULL,  -901, -252 },
+    { 0xAECC49914078536DULL,  -874, -244 },
+    { 0x823C12795DB6CE57ULL,  -847, -236 },
+    { 0xC21094364DFB5637ULL,  -821, -228 },
+    { 0x9096EA6F3848984FULL,  -794, -220 },
+    { 0xD77485CB25823AC7ULL,  -768, -212 },
+    { 0xA086CFCD97BF97F4ULL,  -741, -204 },
+    { 0xEF340A98172AACE5ULL,  -715, -196 },
+    { 0xB23867FB2A35B28EULL,  -688, -188 },
+    { 0x84C8D4DFD2C63F3BULL,  -661, -180 },
+    { 0xC5DD44271AD3CDBAULL,  -635, -172 },
+    { 0x936B9FCEBB25C996ULL,  -608, -164 },
+    { 0xDBAC6C247D62A584ULL,  -582, -156 },
+    { 0xA3AB66580D5FDAF6ULL,  -555, -148 },
+    { 0xF3E2F893DEC3F126ULL,  -529, -140 },
+    { 0xB5B5ADA8AAFF80B8ULL,  -502, -132 },
+    { 0x87625F056C7C4A8BULL,  -475, -124 },
+    { 0xC9BCFF6034C13053ULL,  -449, -116 },
+    { 0x964E858C91BA2655ULL,  -422, -108 },
+    { 0xDFF9772470297EBDULL,  -396, -100 },
+    { 0xA6DFBD9FB8E5B88FULL,  -369,  -92 },
+    { 0xF8A95FCF88747D94ULL,  -343,  -84 },
+    { 0xB94470938FA89BCFULL,  -316,  -76 },
+    { 0x8A08F0F8BF0F156BULL,  -289,  -68 },
+    { 0xCDB02555653131B6ULL,  -263,  -60 },
+    { 0x993FE2C6D07B7FACULL,  -236,  -52 },
+    { 0xE45C10C42A2B3B06ULL,  -210,  -44 },
+    { 0xAA242499697392D3ULL,  -183,  -36 },
+    { 0xFD87B5F28300CA0EULL,  -157,  -28 },
+    { 0xBCE5086492111AEBULL,  -130,  -20 },
+    { 0x8CBCCC096F5088CCULL,  -103,  -12 },
+    { 0xD1B71758E219652CULL,   -77,   -4 },
+    { 0x9C40000000000000ULL,   -50,    4 },
+    { 0xE8D4A51000000000ULL,   -24,   12 },
+    { 0xAD78EBC5AC620000ULL,     3,   20 },
+    { 0x813F3978F8940984ULL,    30,   28 },
+    { 0xC097CE7BC90715B3ULL,    56,   36 },
+    { 0x8F7E32CE7BEA5C70ULL,    83,   44 },
+    { 0xD5D238A4ABE98068ULL,   109,   52 },
+    { 0x9F4F2726179A2245ULL,   136,   60 },
+    { 0xED63A231D4C4FB27ULL,   162,   68 },
+    { 0xB0DE65388CC8ADA8ULL,   189,   76 },
+    { 0x83C7088E1AAB65DBULL,   216,   84 },
+    { 0xC45D1DF942711D9AULL,   242,   92 },
+    { 0x924D692CA61BE758ULL,   269,  100 },
+    { 0xDA01EE641A708DEAULL,   295,  108 },
+    { 0xA26DA3999AEF774AULL,   322,  116 },
+    { 0xF209787BB47D6B85ULL,   348,  124 },
+    { 0xB454E4A179DD1877ULL,   375,  132 },
+    { 0x865B86925B9BC5C2ULL,   402,  140 },
+    { 0xC83553C5C8965D3DULL,   428,  148 },
+    { 0x952AB45CFA97A0B3ULL,   455,  156 },
+    { 0xDE469FBD99A05FE3ULL,   481,  164 },
+    { 0xA59BC234DB398C25ULL,   508,  172 },
+    { 0xF6C69A72A3989F5CULL,   534,  180 },
+    { 0xB7DCBF5354E9BECEULL,   561,  188 },
+    { 0x88FCF317F22241E2ULL,   588,  196 },
+    { 0xCC20CE9BD35C78A5ULL,   614,  204 },
+    { 0x98165AF37B2153DFULL,   641,  212 },
+    { 0xE2A0B5DC971F303AULL,   667,  220 },
+    { 0xA8D9D1535CE3B396ULL,   694,  228 },
+    { 0xFB9B7CD9A4A7443CULL,   720,  236 },
+    { 0xBB764C4CA7A44410ULL,   747,  244 },
+    { 0x8BAB8EEFB6409C1AULL,   774,  252 },
+    { 0xD01FEF10A657842CULL,   800,  260 },
+    { 0x9B10A4E5E9913129ULL,   827,  268 },
+    { 0xE7109BFBA19C0C9DULL,   853,  276 },
+    { 0xAC2820D9623BF429ULL,   880,  284 },
+    { 0x80444B5E7AA7CF85ULL,   907,  292 },
+    { 0xBF21E44003ACDD2DULL,   933,  300 },
+    { 0x8E679C2F5E44FF8FULL,   960,  308 },
+    { 0xD433179D9C8CB841ULL,   986,  316 },
+    { 0x9E19DB92B4E31BA9ULL,  1013,  324 },
+};
+
+#define CACHED_POWERS_MIN_DEC_EXP (-300)
+#define CACHED_POWERS_DEC_STEP    8
+
+// Target window for the binary exponent of the scaled value
+#define GRISU_ALPHA (-60)
+#define GRISU_GAMMA (-32)
+
+static diyfp_t diyfp_sub(diyfp_t x, diyfp_t y) {
+    diyfp_t r = { x.f - y.f, x.e };
+    return r;
+}
+
+// Upper 64 bits of the 128-bit product, rounded
+static diyfp_t diyfp_mul(diyfp_t x, diyfp_t y) {
+    uint64_t x_lo = x.f & 0xFFFFFFFFu, x_hi = x.f >> 32;
+    uint64_t y_lo = y.f & 0xFFFFFFFFu, y_hi = y.f >> 32;
+    
+    uint64_t p0 = x_lo * y_lo;
+    uint64_t p1 = x_lo * y_hi;
+    uint64_t p2 = x_hi * y_lo;
+    uint64_t p3 = x_hi * y_hi;
+    
+    uint64_t mid = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu);
+    mid += (uint64_t)1 << 31;  // Round
+    
+    diyfp_t r = { p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32), x.e + y.e + 64 };
+    return r;
+}
+
+static diyfp_t diyfp_normalize(diyfp_t x) {
+    while ((x.f >> 63) == 0) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+static diyfp_t diyfp_normalize_to(diyfp_t x, int e) {
+    x.f <<= x.e - e;
+    x.e = e;
+    return x;
+}
+
+// Split a positive finite double into its value and the boundaries of its
+// rounding interval, all normalized to the same exponent
+static void compute_boundaries(double value, diyfp_t *w_minus, diyfp_t *w, diyfp_t *w_plus) {
+    const uint64_t hidden_bit = (uint64_t)1 << 52;
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    
+    uint64_t fraction = bits & (hidden_bit - 1);
+    int biased_exp = (int)(bits >> 52);
+    
+    diyfp_t v;
+    if (biased_exp == 0) {
+        v.f = fraction;
+        v.e = 1 - 1075;
+    } else {
+        v.f = fraction + hidden_bit;
+        v.e = biased_exp - 1075;
+    }
+    
+    // The lower boundary is closer when the significand is a power of two
+    int lower_closer = fraction == 0 && biased_exp > 1;
+    diyfp_t m_plus = { 2 * v.f + 1, v.e - 1 };
+    diyfp_t m_minus;
+    if (lower_closer) {
+        m_minus.f = 4 * v.f - 1;
+        m_minus.e = v.e - 2;
+    } else {
+        m_minus.f = 2 * v.f - 1;
+        m_minus.e = v.e - 1;
+    }
+    
+    *w_plus = diyfp_normalize(m_plus);
+    *w_minus = diyfp_normalize_to(m_minus, w_plus->e);
+    *w = diyfp_normalize(v);
+}
+
+// Pick a cached power c such that the scaled exponent lands in [alpha, gamma]
+static cached_power_t cached_power_for(int e) {
+    int f = GRISU_ALPHA - e - 1;
+    int k = (f * 78913) / (1 << 18) + (f > 0);  // ceil(f * log10(2))
+    int index = (-CACHED_POWERS_MIN_DEC_EXP + k + (CACHED_POWERS_DEC_STEP - 1)) / CACHED_POWERS_DEC_STEP;
+    return cached_powers[index];
+}
+
+// Number of decimal digits of n and the largest power of ten <= n
+static int largest_pow10(uint32_t n, uint32_t *pow10) {
+    static const uint32_t powers[] = {
+        1u, 10u, 100u, 1000u, 10000u, 100000u,
+        1000000u, 10000000u, 100000000u, 1000000000u
+    };
+    int digits = 10;
+    while (digits > 1 && n < powers[digits - 1]) {
+        digits--;
+    }
+    *pow10 = powers[digits - 1];
+    return digits;
+}
+
+// Move the last digit towards w while staying in the interval, then
+// check that the digits are closest for every w within the error (unit)
+// of the computed one. Returns 0 when 64-bit arithmetic cannot tell.
+static int grisu_weed(char *buf, int len, uint64_t dist, uint64_t delta,
+                      uint64_t rest, uint64_t ten_k, uint64_t unit) {
+    uint64_t small = dist - unit;
+    uint64_t big = dist + unit;
+    
+    while (rest < small && delta - rest >= ten_k &&
+           (rest + ten_k < small || small - rest >= rest + ten_k - small)) {
+        buf[len - 1]--;
+        rest += ten_k;
+    }
+    if (rest < big && delta - rest >= ten_k &&
+        (rest + ten_k < big || big - rest > rest + ten_k - big)) {
+        return 0;
+    }
+    return 2 * unit <= rest && rest <= delta - 4 * unit;
+}
+
+// Generate the shortest digits of w inside (M-, M+). The scaled values
+// are each off by up to one unit, so digits are generated for the
+// widened interval and kept only if they are also right for the narrow
+// one; returns 0 otherwise.
+static int grisu_digits(char *buf, int *len, int *dec_exp,
+                        diyfp_t m_minus, diyfp_t w, diyfp_t m_plus) {
+    uint64_t unit = 1;
+    diyfp_t too_low = { m_minus.f - unit, m_minus.e };
+    diyfp_t too_high = { m_plus.f + unit, m_plus.e };
+    uint64_t delta = diyfp_sub(too_high, too_low).f;
+    uint64_t dist = diyfp_sub(too_high, w).f;
+    
+    int shift = -w.e;
+    uint64_t one = (uint64_t)1 << shift;
+    uint32_t p1 = (uint32_t)(too_high.f >> shift);
+    uint64_t p2 = too_high.f & (one - 1);
+    
+    // Integral digits
+    uint32_t pow10;
+    int n = largest_pow10(p1, &pow10);
+    while (n > 0) {
+        buf[(*len)++] = (char)('0' + p1 / pow10);
+        p1 %= pow10;
+        n--;
+        
+        uint64_t rest = ((uint64_t)p1 << shift) + p2;
+        if (rest < delta) {
+            *dec_exp += n;
+            return grisu_weed(buf, *len, dist, delta, rest, (uint64_t)pow10 << shift, unit);
+        }
+        pow10 /= 10;
+    }
+    
+    // Fractional digits
+    int m = 0;
+    for (;;) {
+        p2 *= 10;
+        unit *= 10;
+        delta *= 10;
+        buf[(*len)++] = (char)('0' + (p2 >> shift));
+        p2 &= one - 1;
+        m++;
+        if (p2 < delta) {
+            *dec_exp -= m;
+            return grisu_weed(buf, *len, dist * unit, delta, p2, one, unit);
+        }
+    }
+}
+
+// Shortest digit string for a positive finite double: value = digits * 10^dec_exp.
+// Returns 0 for the few values (about 0.5%) it cannot decide; len is
+// set either way, and is then a lower bound on the shortest length.
+static int grisu3(double value, char *buf, int *len, int *dec_exp) {
+    diyfp_t w_minus, w, w_plus;
+    compute_boundaries(value, &w_minus, &w, &w_plus);
+    
+    cached_power_t cached = cached_power_for(w_plus.e);
+    diyfp_t c = { cached.f, cached.e };
+    
+    diyfp_t scaled_w = diyfp_mul(w, c);
+    diyfp_t scaled_minus = diyfp_mul(w_minus, c);
+    diyfp_t scaled_plus = diyfp_mul(w_plus, c);
+    
+    *len = 0;
+    *dec_exp = -cached.k;
+    return grisu_digits(buf, len, dec_exp, scaled_minus, scaled_w, scaled_plus);
+}
+
+// Read digits * 10^dec_exp back as a double. The text has no decimal
+// point, so the locale cannot change how it reads.
+static double digits_value(const char *digits, int len, int dec_exp) {
+    char text[40];
+    snprintf(text, sizeof(text), "%.*se%d", len, digits, dec_exp);
+    return strtod(text, NULL);
+}
+
+// Fallback for values Grisu3 rejects: the fewest correctly rounded
+// digits, from min_len up, that read back as value. When the significand is a power of
+// two the interval is narrower below, so the digits just above the
+// rounded ones may fit when the rounded ones do not.
+static int fallback_digits(double value, char *buf, int *dec_exp, int min_len) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    int lower_closer = (bits & (((uint64_t)1 << 52) - 1)) == 0 && (bits >> 52) > 1;
+    int len = 0;
+    
+    for (int precision = min_len; precision <= 17; precision++) {
+        char text[40];
+        const char *p = text;
+        
+        snprintf(text, sizeof(text), "%.*e", precision - 1, value);
+        len = 0;
+        for (; *p != 'e'; p++) {
+            if (*p >= '0' && *p <= '9') buf[len++] = *p;
+        }
+        *dec_exp = atoi(p + 1) - (len - 1);
+        if (digits_value(buf, len, *dec_exp) == value) break;
+        
+        if (lower_closer) {
+            char up[20];
+            int up_exp = *dec_exp;
+            int i = len - 1;
+            
+            memcpy(up, buf, (size_t)len);
+            while (i >= 0 && up[i] == '9') up[i--] = '0';
+            if (i >= 0) {
+                up[i]++;
+            } else {
+                up[0] = '1';  // 99..9 + 1 = 10..0 * 10
+                up_exp++;
+            }
+            if (digits_value(up, len, up_exp) == value) {
+                memcpy(buf, up, (size_t)len);
+                *dec_exp = up_exp;
+                break;
+            }
+        }
+    }
+    
+    while (len > 1 && buf[len - 1] == '0') {
+        len--;
+        (*dec_exp)++;
+    }
+    return len;
+}
+
+// Lay out digits as plain decimal or exponent notation, whichever %g would
+static int format_digits(char *out, const char *digits, int len, int dec_exp) {
+    int point = len + dec_exp;  // Position of the decimal point
+    char *p = out;
+    
+    if (len <= point && point <= 15) {
+        // Integer: digits followed by zeros
+        memcpy(p, digits, (size_t)len);
+        p += len;
+        memset(p, '0', (size_t)(point - len));
+        p += point - len;
+    } else if (0 < point && point <= 15) {
+        // Decimal point inside the digits
+        memcpy(p, digits, (size_t)point);
+        p += point;
+        *p++ = '.';
+        memcpy(p, digits + point, (size_t)(len - point));
+        p += len - point;
+    } else if (-4 < point && point <= 0) {
+        // Small value: 0.000ddd
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', (size_t)-point);
+        p += -point;
+        memcpy(p, digits, (size_t)len);
+        p += len;
+    } else {
+        // Exponent notation: d.ddde[-]xx
+        int exp = point - 1;
+        *p++ = digits[0];
+        if (len > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, (size_t)(len - 1));
+            p += len - 1;
+        }
+        *p++ = 'e';
+        if (exp < 0) {
+            *p++ = '-';
+            exp = -exp;
+        }
+        if (exp >= 100) {
+            *p++ = (char)('0' + exp / 100);
+            exp %= 100;
+            *p++ = (char)('0' + exp / 10);
+        } else if (exp >= 10) {
+            *p++ = (char)('0' + exp / 10);
+        }
+        *p++ = (char)('0' + exp % 10);
+    }
+    
+    *p = '\0';
+    return (int)(p - out);
+}
+
+int json_format_double(double value, char *buf) {
+    char digits[20];
+    int dec_exp;
+    char *p = buf;
+    
+    // JSON has no representation for NaN or infinity
+    if (isnan(value) || isinf(value)) {
+        memcpy(buf, "null", 5);
+        return 4;
+    }
+    
+    if (signbit(value)) {
+        *p++ = '-';
+        value = -value;
+    }
+    if (value == 0) {
+        *p++ = '0';
+        *p = '\0';
+        return (int)(p - buf);
+    }
+    
+    int len;
+    if (!grisu3(value, digits, &len, &dec_exp)) len = fallback_digits(value, digits, &dec_exp, len);
+    return (int)(p - buf) + format_digits(p, digits, len, dec_exp);
+}
+
+int json_format_integer(long long value, char *buf) {
+    static const char pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    char tmp[24];
+    char *end = tmp + sizeof(tmp);
+    char *p = end;
+    
+    // Work on the magnitude as unsigned so LLONG_MIN does not overflow
+    unsigned long long n = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    
+    // Two digits per division
+    while (n >= 100) {
+        unsigned idx = (unsigned)(n % 100) * 2;
+        n /= 100;
+        *--p = pairs[idx + 1];
+        *--p = pairs[idx];
+    }
+    if (n >= 10) {
+        unsigned idx = (unsigned)n * 2;
+        *--p = pairs[idx + 1];
+        *--p = pairs[idx];
+    } else {
+        *--p = (char)('0' + n);
+    }
+    if (value < 0) *--p = '-';
+    
+    int len = (int)(end - p);
+    memcpy(buf, p, (size_t)len);
+    buf[len] = '\0';
+    return len;
+}
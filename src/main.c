@@ -1,88 +1,248 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#define _FILE_OFFSET_BITS 64
 #include "json.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Batch mode can read files through io_uring; the raw syscalls are used
+// so the build needs only the kernel headers
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#ifdef __NR_io_uring_setup
+#define HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+#define STREAM_BLOCK_SIZE  (256 * 1024)
+#define SMALL_FILE_SIZE    (1024 * 1024)
+#define MAX_JOBS           256
+
+// Output modes
+#define MODE_INFO   0
+#define MODE_PRETTY 1
+#define MODE_MINIFY 2
 
 void print_usage(const char *program_name) {
-    printf("Usage: %s [options] [file]\n", program_name);
+    printf("Usage: %s [options] [file...]\n", program_name);
     printf("JSON parser and validator\n\n");
     printf("Options:\n");
     printf("  -h, --help     Show this help message\n");
     printf("  -v, --validate Validate JSON only (exit code 0=valid, 1=invalid)\n");
-    printf("  -p, --pretty   Pretty print JSON (TODO)\n");
+    printf("  -p, --pretty   Pretty print JSON with 2-space indentation\n");
+    printf("  -m, --minify   Print JSON with insignificant whitespace removed\n");
+    printf("  -j, --jobs N   Worker threads for multiple files (default: all cores)\n");
+    printf("      --io MODE  File reading for multiple files: auto, uring or pread\n");
+    printf("      --bench N  Parse the input N times and report speed and allocations\n");
+    printf("  -s, --stats    Report value counts, depth, allocations and parse phase times\n");
+    printf("      --cache DIR        Remember results for files in DIR and skip unchanged ones\n");
+    printf("      --cache-size SIZE  Cache size limit, with K, M or G suffix (default: 256M)\n");
+    printf("  @list          Read file paths from list, one per line\n");
     printf("  -              Read from stdin\n\n");
     printf("Examples:\n");
     printf("  %s file.json                 # Parse and validate file.json\n", program_name);
     printf("  echo '{\"test\": 42}' | %s -   # Parse from stdin\n", program_name);
     printf("  %s -v file.json              # Just validate (silent)\n", program_name);
+    printf("  %s -p file.json > out.json   # Reformat without building a tree\n", program_name);
+    printf("  %s -v -j 8 @files.txt        # Validate many files in parallel\n", program_name);
+    printf("  %s --bench 100 file.json     # Measure parse throughput\n", program_name);
+    printf("  %s -s file.json              # Show what parsing file.json cost\n", program_name);
+    printf("  %s -v --cache ~/.cache/jp @files.txt  # Revalidate only what changed\n", program_name);
 }
 
-char* read_file(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
-        return NULL;
-    }
-    
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    char *content = malloc(size + 1);
-    if (!content) {
-        fprintf(stderr, "Error: Memory allocation failed\n");
-        fclose(file);
-        return NULL;
-    }
-    
-    size_t bytes_read = fread(content, 1, size, file);
-    content[bytes_read] = '\0';
-    
-    fclose(file);
-    return content;
-}
+// Input document: a read-only mapping of the file, or a heap buffer for
+// inputs that cannot be mapped (pipes, character devices, stdin). In
+// batch mode small files are read into a buffer the worker reuses.
+typedef struct {
+    char *data;
+    size_t length;
+    int mapped;
+    int owned;
+} input_t;
 
-char* read_stdin() {
-    char *content = NULL;
+// Reusable read buffer owned by one batch worker
+typedef struct {
+    char *data;
+    size_t capacity;
+} scratch_t;
+
+// Read everything from a descriptor in large blocks
+static char* read_fd(int fd, size_t *length) {
     size_t size = 0;
-    size_t capacity = 1024;
-    
-    content = malloc(capacity);
-    if (!content) {
-        fprintf(stderr, "Error: Memory allocation failed\n");
-        return NULL;
-    }
+    size_t capacity = 64 * 1024;
+    char *content = malloc(capacity);
+    if (!content) return NULL;
     
-    int c;
-    while ((c = getchar()) != EOF) {
-        if (size >= capacity - 1) {
+    while (1) {
+        if (size == capacity) {
             capacity *= 2;
             char *new_content = realloc(content, capacity);
             if (!new_content) {
                 free(content);
-                fprintf(stderr, "Error: Memory allocation failed\n");
                 return NULL;
             }
             content = new_content;
         }
-        content[size++] = c;
+        
+        ssize_t n = read(fd, content + size, capacity - size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            free(content);
+            return NULL;
+        }
+        if (n == 0) break;
+        size += (size_t)n;
     }
     
-    content[size] = '\0';
+    *length = size;
     return content;
 }
 
-void print_json_info(const json_t *json, int indent) {
-    if (!json) return;
+// Read a small regular file into the scratch buffer
+static int read_into_scratch(int fd, size_t size, scratch_t *scratch, input_t *in) {
+    if (scratch->capacity < size) {
+        char *grown = realloc(scratch->data, size);
+        if (!grown) return -1;
+        scratch->data = grown;
+        scratch->capacity = size;
+    }
     
-    for (int i = 0; i < indent; i++) printf("  ");
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, scratch->data + done, size - done, (off_t)done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;  // File shrank underneath us
+        done += (size_t)n;
+    }
     
-    switch (json->type) {
+    in->data = scratch->data;
+    in->length = done;
+    return 0;
+}
+
+// Open an input without reporting errors; *reason describes a failure.
+// Regular files are mapped read-only (or, given a scratch buffer and a
+// small file, copied into it); anything else falls back to buffered reads.
+static int open_input(const char *filename, input_t *in, scratch_t *scratch, const char **reason) {
+    memset(in, 0, sizeof(*in));
+    
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        *reason = "Cannot open file";
+        return -1;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        *reason = "Cannot stat file";
+        close(fd);
+        return -1;
+    }
+    
+    if (!S_ISREG(st.st_mode)) {
+        in->data = read_fd(fd, &in->length);
+        in->owned = 1;
+        close(fd);
+        if (!in->data) {
+            *reason = "Cannot read file";
+            return -1;
+        }
+        return 0;
+    }
+    
+    if ((uintmax_t)st.st_size > SIZE_MAX) {
+        *reason = "File is too large to map";
+        close(fd);
+        return -1;
+    }
+    
+    in->length = (size_t)st.st_size;
+    if (in->length == 0) {
+        // mmap rejects empty mappings; an empty document needs no memory
+        close(fd);
+        return 0;
+    }
+    
+    // Mapping costs more than copying for small files
+    if (scratch && in->length <= SMALL_FILE_SIZE) {
+        int status = read_into_scratch(fd, in->length, scratch, in);
+        close(fd);
+        if (status != 0) *reason = "Cannot read file";
+        return status;
+    }
+    
+    void *data = mmap(NULL, in->length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // The mapping keeps the file referenced
+    if (data == MAP_FAILED) {
+        *reason = "Cannot map file";
+        return -1;
+    }
+    
+    // The parsers make one forward pass: read ahead aggressively and let
+    // the kernel back large inputs with huge pages where it can
+    posix_madvise(data, in->length, POSIX_MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(data, in->length, MADV_HUGEPAGE);
+#endif
+
+    in->data = data;
+    in->mapped = 1;
+    return 0;
+}
+
+static int load_file(const char *filename, input_t *in) {
+    const char *reason;
+    
+    if (open_input(filename, in, NULL, &reason) != 0) {
+        fprintf(stderr, "Error: %s '%s'\n", reason, filename);
+        return -1;
+    }
+    return 0;
+}
+
+static void input_release(input_t *in) {
+    if (in->mapped) {
+        munmap(in->data, in->length);
+    } else if (in->owned) {
+        free(in->data);
+    }
+    in->data = NULL;
+}
+
+// Read all of stdin in large blocks
+static char* read_stdin(size_t *length) {
+    char *content = read_fd(STDIN_FILENO, length);
+    if (!content) {
+        fprintf(stderr, "Error: Cannot read from stdin\n");
+    }
+    return content;
+}
+
+// One-line summary of a root value, shared by trees and cached views
+static void print_value_info(int type, const char *string, double number, size_t count) {
+    switch (type) {
         case JSON_STRING:
-            printf("STRING: \"%s\"\n", json->valuestring);
+            printf("STRING: \"%s\"\n", string);
             break;
         case JSON_NUMBER:
-            printf("NUMBER: %.2f\n", json->valuenumber);
+            printf("NUMBER: %.2f\n", number);
             break;
         case JSON_TRUE:
             printf("BOOLEAN: true\n");
@@ -94,10 +254,10 @@ void print_json_info(const json_t *json, int indent) {
             printf("NULL\n");
             break;
         case JSON_OBJECT:
-            printf("OBJECT (TODO: not implemented yet)\n");
+            printf("OBJECT (%zu member%s)\n", count, count == 1 ? "" : "s");
             break;
         case JSON_ARRAY:
-            printf("ARRAY (TODO: not implemented yet)\n");
+            printf("ARRAY (%zu element%s)\n", count, count == 1 ? "" : "s");
             break;
         default:
             printf("UNKNOWN TYPE\n");
@@ -105,61 +265,1668 @@ void print_json_info(const json_t *json, int indent) {
     }
 }
 
+void print_json_info(const json_t *json, int indent) {
+    if (!json) return;
+    
+    for (int i = 0; i < indent; i++) printf("  ");
+    
+    size_t count = 0;
+    for (const json_t *child = json->child; child; child = child->next) count++;
+    print_value_info(json->type, json->valuestring, json->valuenumber, count);
+}
+
+static void print_view_info(const json_view_t *view) {
+    print_value_info(view->type, json_view_string(view, NULL), json_view_number(view),
+                     json_view_size(view));
+}
+
+// Buffered stdout for the reformatter
+typedef struct {
+    char data[OUTPUT_BUFFER_SIZE];
+    size_t length;
+    int failed;
+} output_t;
+
+static void output_flush(output_t *out) {
+    const char *p = out->data;
+    size_t left = out->length;
+    
+    while (left > 0 && !out->failed) {
+        ssize_t written = write(STDOUT_FILENO, p, left);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            out->failed = 1;
+            break;
+        }
+        p += written;
+        left -= (size_t)written;
+    }
+    out->length = 0;
+}
+
+static void output_write(output_t *out, const char *text, size_t len) {
+    if (out->length + len > sizeof(out->data)) {
+        output_flush(out);
+        if (len > sizeof(out->data)) {
+            // Too big to buffer: write it through directly
+            memcpy(out->data, text, sizeof(out->data));
+            out->length = sizeof(out->data);
+            output_flush(out);
+            output_write(out, text + sizeof(out->data), len - sizeof(out->data));
+            return;
+        }
+    }
+    memcpy(&out->data[out->length], text, len);
+    out->length += len;
+}
+
+// Newline plus indentation, cut from one precomputed string
+static void output_indent(output_t *out, int depth) {
+    static char indent[1 + 2 * JSON_MAX_DEPTH];
+    
+    if (indent[0] != '\n') {
+        indent[0] = '\n';
+        memset(indent + 1, ' ', sizeof(indent) - 1);
+    }
+    output_write(out, indent, 1 + 2 * (size_t)depth);
+}
+
+// Re-emits the document token by token, either indented or with all
+// insignificant whitespace stripped. Tokens are copied verbatim, so
+// numbers and escapes come out exactly as they went in.
+typedef struct {
+    output_t *out;
+    int pretty;
+    int depth;
+    int need_comma;
+    int after_key;
+    int just_opened;
+} reformatter_t;
+
+static void reformat_token(reformatter_t *f, int token, const json_scanner_t *scanner) {
+    output_t *out = f->out;
+    
+    if (token == JSON_TOKEN_OBJECT_END || token == JSON_TOKEN_ARRAY_END) {
+        f->depth--;
+        if (f->pretty && !f->just_opened) output_indent(out, f->depth);
+        output_write(out, scanner->token, 1);
+        f->just_opened = 0;
+        f->need_comma = 1;
+        return;
+    }
+    
+    if (f->after_key) {
+        f->after_key = 0;
+    } else {
+        if (f->need_comma) output_write(out, ",", 1);
+        if (f->pretty && f->depth > 0) output_indent(out, f->depth);
+    }
+    f->just_opened = 0;
+    output_write(out, scanner->token, scanner->token_length);
+    
+    if (token == JSON_TOKEN_OBJECT_BEGIN || token == JSON_TOKEN_ARRAY_BEGIN) {
+        f->depth++;
+        f->just_opened = 1;
+        f->need_comma = 0;
+    } else if (token == JSON_TOKEN_KEY) {
+        output_write(out, ": ", f->pretty ? 2 : 1);
+        f->after_key = 1;
+        f->need_comma = 1;
+    } else {
+        f->need_comma = 1;
+    }
+}
+
+// Scan a document held in memory, handing tokens to the reformatter (or
+// only validating when there is none). Returns the final token.
+static int scan_buffer(const char *text, size_t length, reformatter_t *f, size_t *error_at) {
+    json_scanner_t scanner;
+    int token;
+    
+    if (!f) {
+        *error_at = 0;
+        return json_validate(text, length) ? JSON_TOKEN_END : JSON_TOKEN_ERROR;
+    }
+    
+    json_scanner_init(&scanner, text, length);
+    while ((token = json_scanner_next(&scanner)) > 0) {
+        reformat_token(f, token, &scanner);
+    }
+    *error_at = scanner.pos;
+    return token;
+}
+
+// Scan a document from a descriptor block by block. Only the unconsumed
+// tail of a block is carried over, so memory stays at one block unless a
+// single token is larger than that. *error_at is SIZE_MAX on read errors.
+static int scan_fd(int fd, reformatter_t *f, size_t *error_at) {
+    size_t capacity = STREAM_BLOCK_SIZE;
+    size_t length = 0;
+    size_t consumed = 0;  // Input offset of buffer[0]
+    int last = 0;
+    int token = JSON_TOKEN_ERROR;
+    json_scanner_t scanner;
+    
+    *error_at = SIZE_MAX;
+    char *buffer = malloc(capacity);
+    if (!buffer) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return JSON_TOKEN_ERROR;
+    }
+    json_scanner_init(&scanner, buffer, 0);
+    
+    do {
+        // A token that fills the whole block needs a bigger block
+        if (length == capacity) {
+            char *grown = realloc(buffer, capacity * 2);
+            if (!grown) {
+                fprintf(stderr, "Error: Memory allocation failed\n");
+                free(buffer);
+                return JSON_TOKEN_ERROR;
+            }
+            buffer = grown;
+            capacity *= 2;
+        }
+        
+        // Fill the block so each carried-over token is rescanned rarely
+        while (length < capacity) {
+            ssize_t n = read(fd, buffer + length, capacity - length);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                fprintf(stderr, "Error: Cannot read input: %s\n", strerror(errno));
+                free(buffer);
+                return JSON_TOKEN_ERROR;
+            }
+            if (n == 0) {
+                last = 1;
+                break;
+            }
+            length += (size_t)n;
+        }
+        
+        json_scanner_feed(&scanner, buffer, length, last);
+        while ((token = json_scanner_next(&scanner)) > 0) {
+            if (f) reformat_token(f, token, &scanner);
+        }
+        
+        if (token == JSON_TOKEN_INCOMPLETE) {
+            length -= scanner.pos;
+            memmove(buffer, buffer + scanner.pos, length);
+            consumed += scanner.pos;
+        }
+    } while (token == JSON_TOKEN_INCOMPLETE);
+    
+    *error_at = consumed + scanner.pos;
+    free(buffer);
+    return token;
+}
+
+// Validate or reformat without building a tree. Files are mapped; stdin
+// is consumed in blocks, so neither is ever copied whole into memory.
+static int stream_document(const char *input_file, int validate_only, int pretty) {
+    static output_t out;
+    reformatter_t formatter = { &out, pretty, 0, 0, 0, 0 };
+    reformatter_t *f = validate_only ? NULL : &formatter;
+    size_t error_at;
+    int token;
+    
+    if (input_file) {
+        input_t input;
+        if (load_file(input_file, &input) != 0) return 1;
+        token = scan_buffer(input.data, input.length, f, &error_at);
+        input_release(&input);
+    } else {
+        token = scan_fd(STDIN_FILENO, f, &error_at);
+    }
+    
+    if (validate_only) {
+        return token == JSON_TOKEN_END ? 0 : 1;
+    }
+    
+    if (token == JSON_TOKEN_END) output_write(&out, "\n", 1);
+    output_flush(&out);
+    
+    if (token != JSON_TOKEN_END) {
+        if (error_at != SIZE_MAX) {
+            fprintf(stderr, "Error: Invalid JSON at byte %zu\n", error_at);
+        }
+        return 1;
+    }
+    if (out.failed) {
+        fprintf(stderr, "Error: Failed to write output\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Outcome of one file in batch mode
+#define RESULT_VALID      0
+#define RESULT_INVALID    1
+#define RESULT_UNREADABLE 2
+
+// File reading backends for batch mode
+#define IO_AUTO  0
+#define IO_URING 1
+#define IO_PREAD 2
+
+typedef struct {
+    const char *path;
+    int status;
+    int root_type;
+    size_t bytes;
+    const char *reason;
+    char *buffer;       // Contents read ahead by the io_uring reader
+    int loaded;         // buffer/bytes are valid; the worker skips I/O
+    int cached;         // Answered by the parse cache
+    int stored;         // Added something to the parse cache
+    int done;
+} file_result_t;
+
+#ifdef HAVE_IO_URING
+#define URING_DEPTH   64                  // Files with a read in flight
+#define MAX_BUFFERED  (4 * URING_DEPTH)   // Files read but not yet parsed
+
+// Minimal io_uring wrapper over the raw syscalls (no liburing). One
+// thread owns the ring, so only the kernel/user ring indices need
+// ordering.
+typedef struct {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    void *cq_ring;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned queued;
+} uring_t;
+
+static int uring_init(uring_t *ring, unsigned entries) {
+    struct io_uring_params params;
+    
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) return -1;
+    
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) goto fail;
+    
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) goto fail;
+    }
+    
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) goto fail;
+    
+    char *sq = ring->sq_ring;
+    char *cq = ring->cq_ring;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return 0;
+
+fail:
+    if (ring->sq_ring && ring->sq_ring != MAP_FAILED) munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->cq_ring && ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    close(ring->fd);
+    return -1;
+}
+
+static void uring_free(uring_t *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+// Callers never have more operations outstanding than ring entries, so
+// a free submission slot always exists
+static struct io_uring_sqe* uring_sqe(uring_t *ring) {
+    unsigned tail = *ring->sq_tail + ring->queued;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    ring->queued++;
+    return sqe;
+}
+
+static struct io_uring_cqe* uring_peek(uring_t *ring) {
+    unsigned head = *ring->cq_head;
+    
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+    return &ring->cqes[head & *ring->cq_mask];
+}
+
+// Publish queued submissions and wait for at least one completion.
+// Entries the kernel has not consumed yet (after a short submit or a
+// transient failure) are counted from its head and offered again.
+static int uring_submit_and_wait(uring_t *ring) {
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + ring->queued, __ATOMIC_RELEASE);
+    ring->queued = 0;
+    
+    while (1) {
+        unsigned submit = *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        long n = syscall(__NR_io_uring_enter, ring->fd, submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (n >= 0) return 0;
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) return -1;
+        // Out of resources until completions are reaped: let the caller reap
+        if (errno != EINTR && uring_peek(ring)) return 0;
+    }
+}
+
+static void uring_advance(uring_t *ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+#endif
+
+// Work shared by the batch threads. Files are handed out in argument
+// order, either from a single counter (each worker reads its own files
+// with pread or mmap) or from a queue the io_uring reader fills as
+// reads complete. The main thread prints results strictly in sequence,
+// so output order never depends on scheduling.
+typedef struct {
+    file_result_t *results;
+    size_t count;
+    size_t next;
+    int validate_only;
+    pthread_mutex_t lock;
+    pthread_cond_t completed;
+    
+    // io_uring pipeline: files read ahead but not yet parsed
+    int use_uring;
+    size_t *ready;
+    size_t ready_head;
+    size_t ready_tail;
+    size_t buffered;
+    int ingest_done;
+    pthread_cond_t ready_changed;
+    pthread_cond_t space;
+#ifdef HAVE_IO_URING
+    uring_t ring;
+    char *stranded[URING_DEPTH];  // Read buffers the kernel may still fill
+    unsigned stranded_count;
+#endif
+} batch_t;
+
+// Parse cache (--cache DIR). Each document is stored once under a hash
+// of its contents, as "<hash>.entry": the verdict, the root type and,
+// once it has been parsed, the tree as a binary image. -v verdicts come
+// from json_validate without a tree, so they live apart in
+// "<hash>.v.entry". "<hash>.stat"
+// files map a file's identity and change times to the content hash, so
+// an unchanged file is answered without reading it. Hits refresh the
+// mtime of both; after a batch, or a single file that stored something,
+// the oldest files are evicted until the directory fits the size limit.
+#define CACHE_MAGIC        "JPC3"  // JPC2 parse verdicts predate the strict grammar
+#define CACHE_DEFAULT_SIZE ((size_t)256 * 1024 * 1024)
+
+typedef struct {
+    char magic[4];
+    uint32_t verdict;       // RESULT_VALID or RESULT_INVALID
+    uint32_t root_type;
+    uint32_t has_image;     // A binary image of the tree follows
+    uint32_t validated;     // Verdict from json_validate rather than a parse
+    uint64_t source_size;
+    uint64_t content_hash;
+} cache_header_t;
+
+typedef struct {
+    int verdict;
+    int root_type;
+    void *map;              // Whole entry, mapped when the image was asked for
+    size_t map_length;
+    json_view_t root;
+} cache_entry_t;
+
+static const char *cache_dir = NULL;
+static size_t cache_limit = CACHE_DEFAULT_SIZE;
+
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t read64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 64-bit content hash in the style of XXH64: four independent lanes so
+// it runs at memory speed, then a final avalanche
+static uint64_t hash_content(const void *data, size_t length) {
+    const uint64_t p1 = 0x9E3779B185EBCA87ull;
+    const uint64_t p2 = 0xC2B2AE3D27D4EB4Full;
+    const uint64_t p3 = 0x165667B19E3779F9ull;
+    const unsigned char *p = data;
+    const unsigned char *end = p + length;
+    uint64_t h;
+    
+    if (length >= 32) {
+        uint64_t lanes[4] = { p1 + p2, p2, 0, -p1 };
+        for (; end - p >= 32; p += 32) {
+            for (int i = 0; i < 4; i++) {
+                lanes[i] = rotl64(lanes[i] + read64(p + 8 * i) * p2, 31) * p1;
+            }
+        }
+        h = rotl64(lanes[0], 1) + rotl64(lanes[1], 7) + rotl64(lanes[2], 12) + rotl64(lanes[3], 18);
+    } else {
+        h = p3;
+    }
+    
+    h += length;
+    for (; end - p >= 8; p += 8) {
+        h ^= rotl64(read64(p) * p2, 31) * p1;
+        h = rotl64(h, 27) * p1 + p3;
+    }
+    for (; p < end; p++) {
+        h ^= *p * p3;
+        h = rotl64(h, 11) * p1;
+    }
+    
+    h ^= h >> 33;
+    h *= p2;
+    h ^= h >> 29;
+    h *= p3;
+    h ^= h >> 32;
+    return h;
+}
+
+// Everything that changes when a file is replaced or written
+static uint64_t hash_identity(const struct stat *st) {
+    uint64_t fields[7] = {
+        (uint64_t)st->st_dev, (uint64_t)st->st_ino, (uint64_t)st->st_size,
+        (uint64_t)st->st_mtim.tv_sec, (uint64_t)st->st_mtim.tv_nsec,
+        (uint64_t)st->st_ctim.tv_sec, (uint64_t)st->st_ctim.tv_nsec
+    };
+    return hash_content(fields, sizeof(fields));
+}
+
+static void cache_path(char *path, size_t size, uint64_t hash, const char *kind) {
+    snprintf(path, size, "%s/%016llx.%s", cache_dir, (unsigned long long)hash, kind);
+}
+
+// Root type of a document already known to be valid, from its first byte
+static int sniff_root_type(const char *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        switch (data[i]) {
+            case ' ': case '\t': case '\n': case '\r': continue;
+            case '{': return JSON_OBJECT;
+            case '[': return JSON_ARRAY;
+            case '"': return JSON_STRING;
+            case 't': return JSON_TRUE;
+            case 'f': return JSON_FALSE;
+            case 'n': return JSON_NULL;
+            default:  return JSON_NUMBER;
+        }
+    }
+    return JSON_INVALID;
+}
+
+static const char* cache_entry_kind(int validate_only) {
+    return validate_only ? "v.entry" : "entry";
+}
+
+static void cache_entry_release(cache_entry_t *entry) {
+    if (entry->map) munmap(entry->map, entry->map_length);
+    entry->map = NULL;
+}
+
+// Look up a document by content hash and checking mode. With want_image,
+// a valid document only counts as a hit if its tree was stored, and the
+// entry stays mapped so entry->root can be read until cache_entry_release.
+static int cache_find(uint64_t hash, size_t source_size, int validate_only, int want_image,
+                      cache_entry_t *entry) {
+    char path[4096];
+    cache_header_t header;
+    struct stat st;
+    
+    memset(entry, 0, sizeof(*entry));
+    cache_path(path, sizeof(path), hash, cache_entry_kind(validate_only));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    
+    int status = -1;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(header) &&
+        pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+        memcmp(header.magic, CACHE_MAGIC, 4) == 0 &&
+        header.content_hash == hash && header.source_size == source_size &&
+        header.validated == (uint32_t)(validate_only != 0)) {
+        entry->verdict = (int)header.verdict;
+        entry->root_type = (int)header.root_type;
+        status = 0;
+        
+        if (want_image && entry->verdict == RESULT_VALID) {
+            status = -1;
+            entry->map_length = (size_t)st.st_size;
+            entry->map = header.has_image ? mmap(NULL, entry->map_length, PROT_READ, MAP_PRIVATE, fd, 0)
+                                          : MAP_FAILED;
+            if (entry->map == MAP_FAILED) {
+                entry->map = NULL;
+            } else if (json_load_binary((char *)entry->map + sizeof(header),
+                                        entry->map_length - sizeof(header), &entry->root) == 0) {
+                status = 0;
+            } else {
+                cache_entry_release(entry);
+            }
+        }
+    }
+    
+    // Recently used entries are evicted last
+    if (status == 0) futimens(fd, NULL);
+    close(fd);
+    return status;
+}
+
+// Content hash recorded for a file identity, if any
+static int cache_find_identity(const struct stat *st, uint64_t *hash) {
+    char path[4096];
+    char text[17];
+    
+    cache_path(path, sizeof(path), hash_identity(st), "stat");
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    
+    ssize_t n = pread(fd, text, 16, 0);
+    if (n == 16) futimens(fd, NULL);
+    close(fd);
+    if (n != 16) return -1;
+    
+    text[16] = '\0';
+    char *end;
+    *hash = strtoull(text, &end, 16);
+    return *end == '\0' ? 0 : -1;
+}
+
+static int write_all(void *ctx, const char *data, size_t len) {
+    int fd = *(int *)ctx;
+    
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        len -= (size_t)written;
+    }
+    return 0;
+}
+
+// Write a cache file under a temporary name and rename it into place, so
+// concurrent runs and workers only ever see complete files
+static int cache_write(uint64_t hash, const char *kind, const void *data, size_t length,
+                       const json_t *tree) {
+    char path[4096];
+    char temp[4096];
+    
+    snprintf(temp, sizeof(temp), "%s/.tmp.XXXXXX", cache_dir);
+    int fd = mkstemp(temp);
+    if (fd < 0) return -1;
+    
+    int status = write_all(&fd, data, length);
+    if (status == 0 && tree) status = json_save_binary(tree, write_all, &fd);
+    if (close(fd) != 0) status = -1;
+    
+    cache_path(path, sizeof(path), hash, kind);
+    if (status == 0 && rename(temp, path) != 0) status = -1;
+    if (status != 0) unlink(temp);
+    return status;
+}
+
+static int cache_link(const struct stat *st, uint64_t hash) {
+    char text[17];
+    snprintf(text, sizeof(text), "%016llx", (unsigned long long)hash);
+    return cache_write(hash_identity(st), "stat", text, 16, NULL);
+}
+
+// Record a verdict, with the tree when there is one, and link the file
+// identity to it. Returns 0 if anything new was written.
+static int cache_store(const struct stat *st, uint64_t hash, int validate_only, int verdict,
+                       int root_type, const json_t *tree) {
+    cache_header_t header;
+    
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, 4);
+    header.verdict = (uint32_t)verdict;
+    header.root_type = (uint32_t)root_type;
+    header.has_image = tree != NULL;
+    header.validated = validate_only != 0;
+    header.source_size = (uint64_t)st->st_size;
+    header.content_hash = hash;
+    
+    // The tree of a document this big would mostly evict everything else
+    if (tree && (size_t)st->st_size > cache_limit / 4) {
+        tree = NULL;
+        header.has_image = 0;
+    }
+    
+    if (cache_write(hash, cache_entry_kind(validate_only), &header, sizeof(header), tree) != 0) return -1;
+    return cache_link(st, hash);
+}
+
+typedef struct {
+    char *name;
+    off_t size;
+    time_t used;
+} cache_file_t;
+
+static int compare_cache_files(const void *a, const void *b) {
+    const cache_file_t *x = a;
+    const cache_file_t *y = b;
+    return x->used < y->used ? -1 : x->used > y->used;
+}
+
+// Delete least recently used files until the cache is below 3/4 of its
+// limit, leaving room for a few runs before the next scan has work to do
+static void cache_evict(void) {
+    DIR *dir = opendir(cache_dir);
+    if (!dir) return;
+    
+    cache_file_t *files = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    uintmax_t total = 0;
+    struct dirent *d;
+    
+    while ((d = readdir(dir)) != NULL) {
+        struct stat st;
+        const char *dot = strrchr(d->d_name, '.');
+        if (!dot || (strcmp(dot, ".entry") != 0 && strcmp(dot, ".stat") != 0)) continue;
+        if (fstatat(dirfd(dir), d->d_name, &st, 0) != 0) continue;
+        
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            cache_file_t *grown = realloc(files, capacity * sizeof(cache_file_t));
+            if (!grown) break;
+            files = grown;
+        }
+        files[count].name = strdup(d->d_name);
+        if (!files[count].name) break;
+        files[count].size = (off_t)st.st_blocks * 512;  // Space used, not length
+        files[count].used = st.st_mtime;
+        total += (uintmax_t)files[count].size;
+        count++;
+    }
+    
+    if (total > cache_limit) {
+        qsort(files, count, sizeof(cache_file_t), compare_cache_files);
+        for (size_t i = 0; i < count && total > cache_limit / 4 * 3; i++) {
+            if (unlinkat(dirfd(dir), files[i].name, 0) == 0) total -= (uintmax_t)files[i].size;
+        }
+    }
+    
+    for (size_t i = 0; i < count; i++) free(files[i].name);
+    free(files);
+    closedir(dir);
+}
+
+static int cache_open(const char *dir) {
+    struct stat st;
+    
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) return -1;
+    if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode) || access(dir, W_OK) != 0) return -1;
+    cache_dir = dir;
+    return 0;
+}
+
+static const char* type_name(int type) {
+    switch (type) {
+        case JSON_STRING: return "STRING";
+        case JSON_NUMBER: return "NUMBER";
+        case JSON_TRUE:   return "TRUE";
+        case JSON_FALSE:  return "FALSE";
+        case JSON_NULL:   return "NULL";
+        case JSON_OBJECT: return "OBJECT";
+        case JSON_ARRAY:  return "ARRAY";
+        default:          return "UNKNOWN";
+    }
+}
+
+// Validate or parse one document. With keep, the parsed tree is handed
+// back instead of deleted.
+static void check_document(file_result_t *result, const char *data, size_t length, int validate_only,
+                           json_t **keep) {
+    result->bytes = length;
+    
+    if (validate_only) {
+        result->status = json_validate(data, length) ? RESULT_VALID : RESULT_INVALID;
+        if (result->status == RESULT_VALID) result->root_type = sniff_root_type(data, length);
+        return;
+    }
+    
+    json_t *parsed = json_parse_length(data, length);
+    if (parsed) {
+        result->status = RESULT_VALID;
+        result->root_type = parsed->type;
+    } else {
+        result->status = RESULT_INVALID;
+    }
+    if (keep) *keep = parsed;
+    else json_delete(parsed);
+}
+
+// Check a document through the cache: by file identity without reading
+// it, then by content, and only then by validating or parsing. The file
+// is stat'ed before it is read, so a change made while it is read leaves
+// an identity that will not match next time. For the single-file modes
+// want_image asks for the stored tree in entry->root; otherwise entry
+// may be NULL. Returns 1 on a hit and 0 after checking (and storing).
+static int check_cached(file_result_t *result, scratch_t *scratch, int validate_only,
+                        int want_image, cache_entry_t *entry, json_t **tree) {
+    struct stat st;
+    cache_entry_t local;
+    input_t input;
+    uint64_t hash;
+    
+    if (!entry) entry = &local;
+    *tree = NULL;
+    
+    int regular = stat(result->path, &st) == 0 && S_ISREG(st.st_mode);
+    if (regular && cache_find_identity(&st, &hash) == 0 &&
+        cache_find(hash, (size_t)st.st_size, validate_only, want_image, entry) == 0) {
+        result->status = entry->verdict;
+        result->root_type = entry->root_type;
+        result->bytes = (size_t)st.st_size;
+        return 1;
+    }
+    
+    if (open_input(result->path, &input, scratch, &result->reason) != 0) {
+        result->status = RESULT_UNREADABLE;
+        return 0;
+    }
+    
+    regular = regular && input.length == (size_t)st.st_size;
+    hash = regular ? hash_content(input.data, input.length) : 0;
+    if (regular && cache_find(hash, input.length, validate_only, want_image, entry) == 0) {
+        result->status = entry->verdict;
+        result->root_type = entry->root_type;
+        result->bytes = input.length;
+        result->stored = cache_link(&st, hash) == 0;
+        input_release(&input);
+        return 1;
+    }
+    
+    check_document(result, input.data, input.length, validate_only, validate_only ? NULL : tree);
+    if (regular) {
+        result->stored = cache_store(&st, hash, validate_only, result->status, result->root_type, *tree) == 0;
+    }
+    input_release(&input);
+    return 0;
+}
+
+static void process_file(file_result_t *result, scratch_t *scratch, int validate_only) {
+    input_t input;
+    
+    if (result->status == RESULT_UNREADABLE) return;
+    
+    if (result->loaded) {
+        check_document(result, result->buffer, result->bytes, validate_only, NULL);
+        free(result->buffer);
+        result->buffer = NULL;
+        return;
+    }
+    
+    if (cache_dir) {
+        json_t *tree;
+        result->cached = check_cached(result, scratch, validate_only, 0, NULL, &tree);
+        json_delete(tree);
+        return;
+    }
+    
+    if (open_input(result->path, &input, scratch, &result->reason) != 0) {
+        result->status = RESULT_UNREADABLE;
+        return;
+    }
+    check_document(result, input.data, input.length, validate_only, NULL);
+    input_release(&input);
+}
+
+// Claim the next file: from the read-ahead queue when the io_uring
+// reader is running, otherwise straight from the argument list
+static file_result_t* batch_claim(batch_t *batch) {
+    if (!batch->use_uring) {
+        return batch->next < batch->count ? &batch->results[batch->next++] : NULL;
+    }
+    
+    while (batch->ready_head == batch->ready_tail && !batch->ingest_done) {
+        pthread_cond_wait(&batch->ready_changed, &batch->lock);
+    }
+    if (batch->ready_head == batch->ready_tail) return NULL;
+    return &batch->results[batch->ready[batch->ready_head++]];
+}
+
+static void* batch_worker(void *arg) {
+    batch_t *batch = arg;
+    scratch_t scratch = { NULL, 0 };
+    file_result_t *result;
+    
+    pthread_mutex_lock(&batch->lock);
+    while ((result = batch_claim(batch)) != NULL) {
+        pthread_mutex_unlock(&batch->lock);
+        
+        process_file(result, &scratch, batch->validate_only);
+        
+        pthread_mutex_lock(&batch->lock);
+        result->done = 1;
+        pthread_cond_broadcast(&batch->completed);
+        if (batch->use_uring) {
+            batch->buffered--;
+            pthread_cond_signal(&batch->space);
+        }
+    }
+    pthread_mutex_unlock(&batch->lock);
+    
+    free(scratch.data);
+    return NULL;
+}
+
+#ifdef HAVE_IO_URING
+#define STAGE_OPEN 0
+#define STAGE_READ 1
+
+// One file moving through the reader: openat, then reads until full
+typedef struct {
+    size_t index;
+    int stage;
+    int fd;
+    char *buffer;
+    size_t size;
+    size_t done;
+    int busy;               // Claimed and not yet published
+} read_slot_t;
+
+static void reader_publish(batch_t *batch, read_slot_t *slot, const char *failure) {
+    file_result_t *result = &batch->results[slot->index];
+    
+    if (slot->fd >= 0) close(slot->fd);
+    
+    pthread_mutex_lock(&batch->lock);
+    if (failure) {
+        free(slot->buffer);
+        result->status = RESULT_UNREADABLE;
+        result->reason = failure;
+    } else if (slot->stage == STAGE_READ) {
+        result->buffer = slot->buffer;
+        result->bytes = slot->done;
+        result->loaded = 1;
+    }
+    // Otherwise the file is large or not regular: the worker maps or
+    // reads it itself
+    batch->ready[batch->ready_tail++] = slot->index;
+    pthread_cond_signal(&batch->ready_changed);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+// The ring failed with the slot's operation possibly still in the
+// kernel: hand the file to a worker to read itself, and keep the buffer
+// until the ring is torn down
+static void reader_abandon(batch_t *batch, read_slot_t *slot) {
+    if (slot->fd >= 0) close(slot->fd);
+    
+    pthread_mutex_lock(&batch->lock);
+    if (slot->buffer) batch->stranded[batch->stranded_count++] = slot->buffer;
+    batch->ready[batch->ready_tail++] = slot->index;
+    pthread_cond_signal(&batch->ready_changed);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+static void reader_queue_read(uring_t *ring, read_slot_t *slot) {
+    struct io_uring_sqe *sqe = uring_sqe(ring);
+    
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = slot->fd;
+    sqe->addr = (uintptr_t)(slot->buffer + slot->done);
+    sqe->len = (unsigned)(slot->size - slot->done);
+    sqe->off = slot->done;
+    sqe->user_data = (uintptr_t)slot;
+}
+
+// Advance a slot after a completion; returns 1 once the file is finished
+static int reader_complete(batch_t *batch, read_slot_t *slot, int res) {
+    if (slot->stage == STAGE_OPEN) {
+        struct stat st;
+        
+        if (res < 0) {
+            reader_publish(batch, slot, "Cannot open file");
+            return 1;
+        }
+        slot->fd = res;
+        if (fstat(slot->fd, &st) != 0) {
+            reader_publish(batch, slot, "Cannot stat file");
+            return 1;
+        }
+        if (!S_ISREG(st.st_mode) || st.st_size > SMALL_FILE_SIZE) {
+            reader_publish(batch, slot, NULL);
+            return 1;
+        }
+        
+        slot->stage = STAGE_READ;
+        slot->size = (size_t)st.st_size;
+        if (slot->size == 0) {
+            reader_publish(batch, slot, NULL);
+            return 1;
+        }
+        slot->buffer = malloc(slot->size);
+        if (!slot->buffer) {
+            reader_publish(batch, slot, "Out of memory");
+            return 1;
+        }
+        reader_queue_read(&batch->ring, slot);
+        return 0;
+    }
+    
+    if (res == -EINTR || res == -EAGAIN) {
+        reader_queue_read(&batch->ring, slot);
+        return 0;
+    }
+    if (res < 0) {
+        reader_publish(batch, slot, "Cannot read file");
+        return 1;
+    }
+    
+    slot->done += (size_t)res;
+    if (res > 0 && slot->done < slot->size) {
+        reader_queue_read(&batch->ring, slot);  // Short read
+        return 0;
+    }
+    reader_publish(batch, slot, NULL);  // Complete, or the file shrank
+    return 1;
+}
+
+// Keep up to URING_DEPTH opens and reads in flight and hand finished
+// buffers to the workers. Read-ahead is capped at MAX_BUFFERED files so
+// a slow parser cannot make the reader buffer the whole batch.
+static void* uring_reader(void *arg) {
+    batch_t *batch = arg;
+    uring_t *ring = &batch->ring;
+    read_slot_t slots[URING_DEPTH];
+    read_slot_t *free_slots[URING_DEPTH];
+    unsigned free_count = URING_DEPTH;
+    unsigned inflight = 0;
+    size_t next = 0;
+    
+    memset(slots, 0, sizeof(slots));
+    for (unsigned i = 0; i < URING_DEPTH; i++) free_slots[i] = &slots[i];
+    
+    while (next < batch->count || inflight > 0) {
+        while (free_count > 0 && next < batch->count) {
+            pthread_mutex_lock(&batch->lock);
+            // Only block for space when nothing is in flight, otherwise
+            // reap completions first so the workers have something to do
+            while (batch->buffered >= MAX_BUFFERED && inflight == 0) {
+                pthread_cond_wait(&batch->space, &batch->lock);
+            }
+            int has_space = batch->buffered < MAX_BUFFERED;
+            if (has_space) batch->buffered++;
+            pthread_mutex_unlock(&batch->lock);
+            if (!has_space) break;
+            
+            read_slot_t *slot = free_slots[--free_count];
+            memset(slot, 0, sizeof(*slot));
+            slot->index = next++;
+            slot->stage = STAGE_OPEN;
+            slot->fd = -1;
+            slot->busy = 1;
+            
+            struct io_uring_sqe *sqe = uring_sqe(ring);
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (uintptr_t)batch->results[slot->index].path;
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            sqe->user_data = (uintptr_t)slot;
+            inflight++;
+        }
+        
+        if (uring_submit_and_wait(ring) != 0) {
+            for (unsigned i = 0; i < URING_DEPTH; i++) {
+                if (slots[i].busy) reader_abandon(batch, &slots[i]);
+            }
+            break;
+        }
+        
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_peek(ring)) != NULL) {
+            read_slot_t *slot = (read_slot_t*)(uintptr_t)cqe->user_data;
+            int res = cqe->res;
+            
+            uring_advance(ring);
+            if (reader_complete(batch, slot, res)) {
+                slot->busy = 0;
+                free_slots[free_count++] = slot;
+                inflight--;
+            }
+        }
+    }
+    
+    pthread_mutex_lock(&batch->lock);
+    // If the ring failed, let the workers read whatever is left themselves
+    for (; next < batch->count; next++) batch->ready[batch->ready_tail++] = next;
+    batch->ingest_done = 1;
+    pthread_cond_broadcast(&batch->ready_changed);
+    pthread_mutex_unlock(&batch->lock);
+    return NULL;
+}
+#endif
+
+static double elapsed_seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Validate or parse every path on a pool of worker threads. Per-file
+// results go to stdout in argument order; totals go to stderr.
+static int run_batch(char **paths, size_t count, int jobs, int validate_only, int io_mode) {
+    batch_t batch;
+    pthread_t threads[MAX_JOBS];
+    struct timespec start;
+    int started = 0;
+    
+    memset(&batch, 0, sizeof(batch));
+    batch.results = calloc(count ? count : 1, sizeof(file_result_t));
+    if (!batch.results) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return 1;
+    }
+    for (size_t i = 0; i < count; i++) batch.results[i].path = paths[i];
+    batch.count = count;
+    batch.validate_only = validate_only;
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.completed, NULL);
+    pthread_cond_init(&batch.ready_changed, NULL);
+    pthread_cond_init(&batch.space, NULL);
+    
+    if ((size_t)jobs > count) jobs = count ? (int)count : 1;
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+#ifdef HAVE_IO_URING
+    // The cache answers unchanged files without reading them, which
+    // reading ahead would defeat
+    pthread_t reader;
+    if (io_mode != IO_PREAD && !cache_dir) {
+        batch.ready = malloc((count ? count : 1) * sizeof(size_t));
+        if (batch.ready && uring_init(&batch.ring, URING_DEPTH) == 0) {
+            batch.use_uring = 1;
+            if (pthread_create(&reader, NULL, uring_reader, &batch) != 0) {
+                uring_free(&batch.ring);
+                batch.use_uring = 0;
+            }
+        }
+    }
+#endif
+    if (io_mode == IO_URING && !batch.use_uring && !cache_dir) {
+        fprintf(stderr, "Warning: io_uring unavailable, reading with pread\n");
+    }
+    
+    for (int i = 0; i < jobs; i++) {
+        if (pthread_create(&threads[i], NULL, batch_worker, &batch) != 0) break;
+        started++;
+    }
+    if (started == 0) {
+        // No threads available: do the work on this one
+        batch_worker(&batch);
+    }
+    
+    size_t counts[3] = { 0, 0, 0 };
+    size_t total_bytes = 0;
+    size_t cached = 0;
+    
+    for (size_t i = 0; i < count; i++) {
+        file_result_t *result = &batch.results[i];
+        
+        pthread_mutex_lock(&batch.lock);
+        while (!result->done) pthread_cond_wait(&batch.completed, &batch.lock);
+        pthread_mutex_unlock(&batch.lock);
+        
+        counts[result->status]++;
+        total_bytes += result->bytes;
+        cached += result->cached;
+        
+        switch (result->status) {
+            case RESULT_VALID:
+                if (validate_only) {
+                    printf("%s: valid\n", result->path);
+                } else {
+                    printf("%s: valid (%s)\n", result->path, type_name(result->root_type));
+                }
+                break;
+            case RESULT_INVALID:
+                printf("%s: invalid\n", result->path);
+                break;
+            default:
+                printf("%s: unreadable (%s)\n", result->path, result->reason);
+                break;
+        }
+    }
+    
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+#ifdef HAVE_IO_URING
+    if (batch.use_uring) {
+        pthread_join(reader, NULL);
+        uring_free(&batch.ring);
+        for (unsigned i = 0; i < batch.stranded_count; i++) free(batch.stranded[i]);
+    }
+#endif
+    double seconds = elapsed_seconds(&start);
+    double megabytes = (double)total_bytes / (1024.0 * 1024.0);
+    if (cache_dir) cache_evict();
+    
+    fflush(stdout);
+    fprintf(stderr, "%zu files: %zu valid, %zu invalid, %zu unreadable\n",
+            count, counts[RESULT_VALID], counts[RESULT_INVALID], counts[RESULT_UNREADABLE]);
+    if (cache_dir) fprintf(stderr, "%zu answered from the cache in %s\n", cached, cache_dir);
+    fprintf(stderr, "%.2f MB in %.3f s (%.1f MB/s, %.0f files/s) on %d thread%s, %s\n",
+            megabytes, seconds,
+            seconds > 0 ? megabytes / seconds : 0.0,
+            seconds > 0 ? (double)count / seconds : 0.0,
+            started ? started : 1, started == 1 ? "" : "s",
+            batch.use_uring ? "io_uring" : "pread");
+    
+    pthread_cond_destroy(&batch.space);
+    pthread_cond_destroy(&batch.ready_changed);
+    pthread_cond_destroy(&batch.completed);
+    pthread_mutex_destroy(&batch.lock);
+    free(batch.ready);
+    free(batch.results);
+    
+    return counts[RESULT_VALID] == count ? 0 : 1;
+}
+
+// --bench passes this allocator to json_parse_ex and json_delete_ex so
+// calls and bytes can be attributed to parsing and deleting
+typedef struct {
+    size_t allocations;
+    size_t bytes;
+    size_t frees;
+} alloc_counts_t;
+
+static void* counting_malloc(void *ctx, size_t size) {
+    alloc_counts_t *counts = ctx;
+    counts->allocations++;
+    counts->bytes += size;
+    return malloc(size);
+}
+
+static void* counting_realloc(void *ctx, void *ptr, size_t size) {
+    alloc_counts_t *counts = ctx;
+    counts->allocations++;
+    counts->bytes += size;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void *ctx, void *ptr) {
+    alloc_counts_t *counts = ctx;
+    counts->frees++;
+    free(ptr);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of sorted samples
+static uint64_t percentile(const uint64_t *sorted, size_t count, unsigned percent) {
+    size_t rank = (percent * count + 99) / 100;
+    return sorted[rank ? rank - 1 : 0];
+}
+
+static void print_duration(uint64_t ns) {
+    if (ns < 10000) {
+        printf("%llu ns", (unsigned long long)ns);
+    } else if (ns < 10000000) {
+        printf("%.2f us", ns / 1e3);
+    } else if (ns < 10000000000ull) {
+        printf("%.2f ms", ns / 1e6);
+    } else {
+        printf("%.2f s", ns / 1e9);
+    }
+}
+
+static void print_latency(const char *label, uint64_t *samples, size_t count) {
+    qsort(samples, count, sizeof(uint64_t), compare_u64);
+    printf("%s min ", label);
+    print_duration(samples[0]);
+    printf(", median ");
+    print_duration(percentile(samples, count, 50));
+    printf(", p99 ");
+    print_duration(percentile(samples, count, 99));
+    printf("\n");
+}
+
+static size_t count_nodes(const json_t *json) {
+    size_t nodes = 1;
+    for (const json_t *child = json->child; child; child = child->next) {
+        nodes += count_nodes(child);
+    }
+    return nodes;
+}
+
+static void print_phase(const char *label, uint64_t ns, uint64_t total_ns) {
+    printf("%s", label);
+    print_duration(ns);
+    printf(" (%.0f%%)\n", total_ns ? 100.0 * ns / total_ns : 0.0);
+}
+
+static void print_parse_stats(const json_parse_stats_t *stats, size_t length) {
+    printf("\nValues:      %zu objects, %zu arrays, %zu strings, %zu numbers, "
+           "%zu booleans, %zu nulls\n",
+           stats->objects, stats->arrays, stats->strings,
+           stats->numbers, stats->booleans, stats->nulls);
+    printf("Keys:        %zu\n", stats->keys);
+    printf("String data: %zu bytes\n", stats->string_bytes);
+    printf("Max depth:   %d\n", stats->max_depth);
+    printf("Allocations: %zu calls, %zu bytes (%.2f per input byte)\n",
+           stats->allocations, stats->allocated_bytes,
+           length ? (double)stats->allocated_bytes / length : 0.0);
+    printf("Parse time:  ");
+    print_duration(stats->total_ns);
+    printf("\n");
+    print_phase("  scanning:  ", stats->scan_ns, stats->total_ns);
+    print_phase("  strings:   ", stats->string_ns, stats->total_ns);
+    print_phase("  numbers:   ", stats->number_ns, stats->total_ns);
+}
+
+// Parse an in-memory document repeatedly, timing parse and delete
+// separately so file I/O and process startup stay out of the numbers
+static int run_bench(const char *text, size_t length, size_t iterations) {
+    uint64_t *parse_ns = malloc(iterations * sizeof(uint64_t));
+    uint64_t *delete_ns = malloc(iterations * sizeof(uint64_t));
+    uint64_t parse_total = 0;
+    
+    if (!parse_ns || !delete_ns) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(parse_ns);
+        free(delete_ns);
+        return 1;
+    }
+    
+    // Warm-up parse: faults the input in and checks that it is valid
+    json_t *json = json_parse_length(text, length);
+    if (!json) {
+        fprintf(stderr, "Error: Invalid JSON\n");
+        free(parse_ns);
+        free(delete_ns);
+        return 1;
+    }
+    size_t nodes = count_nodes(json);
+    json_delete(json);
+    
+    alloc_counts_t counts = { 0, 0, 0 };
+    json_allocator_t allocator = { counting_malloc, counting_realloc, counting_free, &counts };
+    json_parse_options_t options = { &allocator, NULL, 0 };
+    
+    for (size_t i = 0; i < iterations; i++) {
+        uint64_t start = now_ns();
+        json = json_parse_ex(text, length, &options);
+        uint64_t parsed = now_ns();
+        json_delete_ex(json, &allocator);
+        uint64_t deleted = now_ns();
+        
+        parse_ns[i] = parsed - start;
+        delete_ns[i] = deleted - parsed;
+        parse_total += parse_ns[i];
+    }
+    
+    double seconds = parse_total / 1e9;
+    printf("Input:       %zu bytes, %zu nodes\n", length, nodes);
+    printf("Iterations:  %zu\n", iterations);
+    printf("Throughput:  %.1f MB/s, %.1f docs/s\n",
+           seconds > 0 ? (double)length * iterations / (1024.0 * 1024.0) / seconds : 0.0,
+           seconds > 0 ? iterations / seconds : 0.0);
+    print_latency("Parse:      ", parse_ns, iterations);
+    print_latency("Delete:     ", delete_ns, iterations);
+    printf("Allocations: %.1f calls, %.0f bytes per parse; %.1f frees per delete\n",
+           (double)counts.allocations / iterations,
+           (double)counts.bytes / iterations,
+           (double)counts.frees / iterations);
+#ifdef DEBUG
+    printf("Note: debug build; use an optimized build for representative numbers\n");
+#endif
+
+    free(parse_ns);
+    free(delete_ns);
+    return 0;
+}
+
+// Growable list of input paths collected from the command line
+typedef struct {
+    char **items;
+    size_t count;
+    size_t capacity;
+} path_list_t;
+
+static int path_list_add(path_list_t *list, const char *path, size_t len) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 16;
+        char **items = realloc(list->items, capacity * sizeof(char*));
+        if (!items) return -1;
+        list->items = items;
+        list->capacity = capacity;
+    }
+    
+    char *copy = malloc(len + 1);
+    if (!copy) return -1;
+    memcpy(copy, path, len);
+    copy[len] = '\0';
+    list->items[list->count++] = copy;
+    return 0;
+}
+
+// Append every non-blank line of a @filelist
+static int path_list_read(path_list_t *list, const char *filename) {
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open file list '%s'\n", filename);
+        return -1;
+    }
+    
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t len;
+    int status = 0;
+    
+    while ((len = getline(&line, &capacity, file)) != -1) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) len--;
+        if (len == 0) continue;
+        if (path_list_add(list, line, (size_t)len) != 0) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            status = -1;
+            break;
+        }
+    }
+    
+    free(line);
+    fclose(file);
+    return status;
+}
+
+// "64K", "10M", "2G" or a plain byte count; 0 on error
+static size_t parse_size(const char *text) {
+    char *end;
+    unsigned long long value = strtoull(text, &end, 10);
+    
+    if (end == text) return 0;
+    switch (*end) {
+        case 'k': case 'K': value <<= 10; end++; break;
+        case 'm': case 'M': value <<= 20; end++; break;
+        case 'g': case 'G': value <<= 30; end++; break;
+    }
+    if (*end == 'B' || *end == 'b') end++;
+    return *end == '\0' ? (size_t)value : 0;
+}
+
+// Single-file parse or -v through the cache. A hit in parse mode prints
+// the root from the stored tree without parsing.
+static int run_cached(const char *path, int validate_only) {
+    file_result_t result;
+    cache_entry_t entry;
+    json_t *tree;
+    
+    memset(&result, 0, sizeof(result));
+    memset(&entry, 0, sizeof(entry));
+    result.path = path;
+    
+    int hit = check_cached(&result, NULL, validate_only, !validate_only, &entry, &tree);
+    if (result.stored) cache_evict();
+    
+    if (result.status == RESULT_UNREADABLE) {
+        fprintf(stderr, "Error: %s '%s'\n", result.reason, path);
+        return 1;
+    }
+    if (validate_only) return result.status == RESULT_VALID ? 0 : 1;
+    
+    if (result.status != RESULT_VALID) {
+        fprintf(stderr, "Error: Invalid JSON\n");
+        return 1;
+    }
+    
+    printf("JSON parsed successfully!\n");
+    printf("Root type: ");
+    if (hit) {
+        print_view_info(&entry.root);
+        cache_entry_release(&entry);
+    } else {
+        print_json_info(tree, 0);
+        json_delete(tree);
+    }
+    return 0;
+}
+
+static void path_list_free(path_list_t *list) {
+    for (size_t i = 0; i < list->count; i++) free(list->items[i]);
+    free(list->items);
+}
+
 int main(int argc, char *argv[]) {
-    char *input_file = NULL;
+    path_list_t paths = { NULL, 0, 0 };
     int validate_only = 0;
     int from_stdin = 0;
+    int from_list = 0;
+    int mode = MODE_INFO;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int io_mode = IO_AUTO;
+    size_t bench_iterations = 0;
+    int show_stats = 0;
+    const char *cache_path_arg = NULL;
+    int status;
     
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
             print_usage(argv[0]);
+            path_list_free(&paths);
             return 0;
         } else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--validate") == 0) {
             validate_only = 1;
+        } else if (strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--pretty") == 0) {
+            mode = MODE_PRETTY;
+        } else if (strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--minify") == 0) {
+            mode = MODE_MINIFY;
+        } else if (strcmp(argv[i], "--cache") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: %s requires a directory\n", argv[i]);
+                path_list_free(&paths);
+                return 1;
+            }
+            cache_path_arg = argv[++i];
+        } else if (strcmp(argv[i], "--cache-size") == 0) {
+            size_t size = i + 1 < argc ? parse_size(argv[++i]) : 0;
+            if (size == 0) {
+                fprintf(stderr, "Error: --cache-size expects a size such as 512M\n");
+                path_list_free(&paths);
+                return 1;
+            }
+            cache_limit = size;
+        } else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--stats") == 0) {
+            show_stats = 1;
+        } else if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) {
+            char *end;
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: %s requires a thread count\n", argv[i]);
+                path_list_free(&paths);
+                return 1;
+            }
+            jobs = strtol(argv[++i], &end, 10);
+            if (*end != '\0' || jobs < 1) {
+                fprintf(stderr, "Error: Invalid thread count '%s'\n", argv[i]);
+                path_list_free(&paths);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            char *end;
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: %s requires an iteration count\n", argv[i]);
+                path_list_free(&paths);
+                return 1;
+            }
+            long long n = strtoll(argv[++i], &end, 10);
+            if (*end != '\0' || n < 1) {
+                fprintf(stderr, "Error: Invalid iteration count '%s'\n", argv[i]);
+                path_list_free(&paths);
+                return 1;
+            }
+            bench_iterations = (size_t)n;
+        } else if (strcmp(argv[i], "--io") == 0) {
+            const char *name = i + 1 < argc ? argv[++i] : "";
+            if (strcmp(name, "auto") == 0) {
+                io_mode = IO_AUTO;
+            } else if (strcmp(name, "uring") == 0) {
+                io_mode = IO_URING;
+            } else if (strcmp(name, "pread") == 0) {
+                io_mode = IO_PREAD;
+            } else {
+                fprintf(stderr, "Error: --io expects auto, uring or pread\n");
+                path_list_free(&paths);
+                return 1;
+            }
         } else if (strcmp(argv[i], "-") == 0) {
             from_stdin = 1;
+        } else if (argv[i][0] == '@') {
+            from_list = 1;
+            if (path_list_read(&paths, argv[i] + 1) != 0) {
+                path_list_free(&paths);
+                return 1;
+            }
         } else if (argv[i][0] != '-') {
-            input_file = argv[i];
+            if (path_list_add(&paths, argv[i], strlen(argv[i])) != 0) {
+                fprintf(stderr, "Error: Memory allocation failed\n");
+                path_list_free(&paths);
+                return 1;
+            }
         } else {
             fprintf(stderr, "Unknown option: %s\n", argv[i]);
             print_usage(argv[0]);
+            path_list_free(&paths);
             return 1;
         }
     }
     
-    char *json_text = NULL;
-    if (from_stdin) {
-        json_text = read_stdin();
-    } else if (input_file) {
-        json_text = read_file(input_file);
-    } else {
+    if (!from_stdin && paths.count == 0 && !from_list) {
         fprintf(stderr, "Error: No input specified\n");
         print_usage(argv[0]);
         return 1;
     }
     
-    if (!json_text) {
+    if (bench_iterations && (from_list || paths.count > 1 || validate_only || mode != MODE_INFO)) {
+        fprintf(stderr, "Error: --bench takes a single input and no other mode\n");
+        path_list_free(&paths);
         return 1;
     }
     
-    json_t *parsed = json_parse(json_text);
+    if (show_stats && (bench_iterations || from_list || paths.count > 1 ||
+                       validate_only || mode != MODE_INFO)) {
+        fprintf(stderr, "Error: --stats takes a single input and no other mode\n");
+        path_list_free(&paths);
+        return 1;
+    }
     
-    if (!parsed) {
-        if (!validate_only) {
-            fprintf(stderr, "Error: Invalid JSON\n");
+    // The cache serves parsing and validation; it is skipped for printing,
+    // measuring and stdin
+    if (cache_path_arg && cache_open(cache_path_arg) != 0) {
+        fprintf(stderr, "Warning: Cannot use cache directory '%s'\n", cache_path_arg);
+    }
+    
+    if (from_list || paths.count > 1) {
+        if (from_stdin || mode != MODE_INFO) {
+            fprintf(stderr, "Error: Multiple inputs support only parse and -v\n");
+            path_list_free(&paths);
+            return 1;
         }
-        free(json_text);
-        return 1;
+        if (jobs < 1) jobs = 1;
+        if (jobs > MAX_JOBS) jobs = MAX_JOBS;
+        status = run_batch(paths.items, paths.count, (int)jobs, validate_only, io_mode);
+        path_list_free(&paths);
+        return status;
     }
     
-    if (validate_only) {
+    const char *input_file = paths.count ? paths.items[0] : NULL;
+    
+    if (cache_dir && input_file && !from_stdin && mode == MODE_INFO && !bench_iterations && !show_stats) {
+        status = run_cached(input_file, validate_only);
+        path_list_free(&paths);
+        return status;
+    }
+    
+    if (validate_only || mode != MODE_INFO) {
+        status = stream_document(from_stdin ? NULL : input_file, validate_only, mode == MODE_PRETTY);
+        path_list_free(&paths);
+        return status;
+    }
+    
+    input_t input;
+    if (from_stdin) {
+        memset(&input, 0, sizeof(input));
+        input.data = read_stdin(&input.length);
+        input.owned = 1;
+        status = input.data ? 0 : -1;
     } else {
-        printf("JSON parsed successfully!\n");
-        printf("Root type: ");
-        print_json_info(parsed, 0);
+        status = load_file(input_file, &input);
+    }
+    path_list_free(&paths);
+    if (status != 0) return 1;
+    
+    if (bench_iterations) {
+        status = run_bench(input.data, input.length, bench_iterations);
+        input_release(&input);
+        return status;
     }
     
+    json_parse_stats_t stats = { 0 };
+    json_parse_options_t options = { NULL, show_stats ? &stats : NULL, 0 };
+    stats.timing = 1;
+    json_t *parsed = json_parse_ex(input.data, input.length, &options);
+    
+    if (!parsed) {
+        fprintf(stderr, "Error: Invalid JSON\n");
+        input_release(&input);
+        return 1;
+    }
+    
+    printf("JSON parsed successfully!\n");
+    printf("Root type: ");
+    print_json_info(parsed, 0);
+    if (show_stats) print_parse_stats(&stats, input.length);
+    
     json_delete(parsed);
-    free(json_text);
+    input_release(&input);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,1159 @@
+// tests/bench.c
+// Benchmark suite for the parser, validator and printer over a fixed set
+// of generated corpora. Results go to stdout as a table and optionally
+// to JSON and CSV files for comparing builds. With --scaling the suite
+// instead parses one shape at sizes growing 4x per step, to expose
+// superlinear behaviour. --counters adds hardware performance counters
+// per byte and per node where the kernel and CPU provide them.
+//
+// --gate compares user-space instruction counts, which unlike wall time
+// barely move between runs on a busy machine, against a baseline written
+// by --record-baseline and fails on growth beyond a threshold. Without
+// hardware counters (most VMs and containers) it compares the fastest of
+// several runs' wall time instead, with a looser threshold; wall time
+// only means something against a baseline recorded on the same machine.
+//
+// --transcode replaces the parse, validate and print operations with
+// MessagePack and CBOR transcoding, streaming and through a tree.
+#define _POSIX_C_SOURCE 200809L
+#include "../include/json.h"
+#include "corpus.h"
+#include "perf_counters.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#define DEFAULT_SIZE     (4 * 1024 * 1024)
+#define DEFAULT_SEED     42
+#define MIN_SECONDS      0.25
+#define MIN_SAMPLES      5
+#define MAX_SAMPLES      1000
+#define MAX_RESULTS      128
+#define SCALING_MIN_SIZE 1024
+#define SCALING_BASELINE (64 * 1024)   // Smaller inputs are dominated by fixed costs
+#define SCALING_LIMIT    1.5           // Per-step growth in ns/byte worth flagging
+#define GATE_SIZE        (1024 * 1024)
+#define GATE_RUNS        15            // Keep the lowest; noise only ever adds
+#define GATE_THRESHOLD   2.0           // Percent growth in instructions that fails
+#define GATE_TIME_THRESHOLD 30.0       // Percent growth in wall time that fails
+#define GATE_RETRIES     6             // Extra passes over ops timed as regressed
+#define GATE_RETRY_PAUSE 2             // Seconds to let a burst of load pass first
+#define GATE_OPS         3
+
+typedef struct {
+    const char *name;
+    int shape;
+    int format;
+} bench_case_t;
+
+static const bench_case_t cases[] = {
+    { "records",        CORPUS_RECORDS, JSON_PRINT_COMPACT },
+    { "records_pretty", CORPUS_RECORDS, JSON_PRINT_PRETTY },
+    { "numbers",        CORPUS_NUMBERS, JSON_PRINT_COMPACT },
+    { "nested",         CORPUS_NESTED,  JSON_PRINT_COMPACT },
+    { "nested_pretty",  CORPUS_NESTED,  JSON_PRINT_PRETTY },
+    { "strings",        CORPUS_STRINGS, JSON_PRINT_COMPACT },
+    { "ndjson",         CORPUS_NDJSON,  JSON_PRINT_COMPACT },
+    { "wide",           CORPUS_WIDE,    JSON_PRINT_COMPACT },
+    { "logs",           CORPUS_LOGS,    JSON_PRINT_COMPACT },
+    { "unicode",        CORPUS_UNICODE, JSON_PRINT_COMPACT },
+};
+#define CASE_COUNT (sizeof(cases) / sizeof(cases[0]))
+
+// A corpus split into the documents it contains: one, or one per line
+typedef struct {
+    char *data;
+    size_t length;
+    const char **docs;
+    size_t *lengths;
+    json_t **trees;
+    size_t count;
+    size_t nodes;
+} corpus_docs_t;
+
+typedef struct {
+    const char *name;
+    const char *op;
+    size_t bytes;
+    size_t samples;
+    uint64_t min_ns;
+    uint64_t median_ns;
+    uint64_t mean_ns;
+    int counted;                            // counters[] and nodes are set
+    size_t nodes;
+    uint64_t counters[PERF_COUNTER_COUNT];  // Per run, or PERF_UNAVAILABLE
+} result_t;
+
+static result_t results[MAX_RESULTS];
+static size_t result_count = 0;
+
+// Hardware counters, summed over the runs of the operation being measured
+static perf_counters_t perf;
+static int use_counters = 0;
+static uint64_t counter_sums[PERF_COUNTER_COUNT];
+static size_t counter_runs = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double mb_per_second(size_t bytes, uint64_t ns) {
+    return ns ? (double)bytes / (1024.0 * 1024.0) / (ns / 1e9) : 0.0;
+}
+
+static result_t* record(const char *name, const char *op, size_t bytes, uint64_t *samples, size_t count) {
+    static result_t scratch;
+    result_t *r = result_count < MAX_RESULTS ? &results[result_count++] : &scratch;
+    uint64_t total = 0;
+    
+    qsort(samples, count, sizeof(uint64_t), compare_u64);
+    for (size_t i = 0; i < count; i++) total += samples[i];
+    
+    r->name = name;
+    r->op = op;
+    r->bytes = bytes;
+    r->samples = count;
+    r->min_ns = samples[0];
+    r->median_ns = samples[count / 2];
+    r->mean_ns = total / count;
+    
+    printf("%-16s %-17s %10zu %7zu %12.1f %12.1f %10.1f\n", name, op, bytes, count,
+           r->min_ns / 1e3, r->median_ns / 1e3, mb_per_second(bytes, r->median_ns));
+    r->counted = 0;
+    return r;
+}
+
+static void counters_begin(void) {
+    if (use_counters) perf_counters_start(&perf);
+}
+
+static void counters_end(void) {
+    uint64_t values[PERF_COUNTER_COUNT];
+    
+    if (!use_counters) return;
+    perf_counters_stop(&perf, values);
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (values[i] == PERF_UNAVAILABLE) counter_sums[i] = PERF_UNAVAILABLE;
+        else if (counter_sums[i] != PERF_UNAVAILABLE) counter_sums[i] += values[i];
+    }
+    counter_runs++;
+}
+
+static void print_counter_line(const char *label, const result_t *r, size_t divisor) {
+    printf("  %-9s", label);
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (r->counters[i] == PERF_UNAVAILABLE || divisor == 0) {
+            printf(" %s n/a", perf_counter_name(i));
+        } else {
+            printf(" %s %.3f", perf_counter_name(i), (double)r->counters[i] / divisor);
+        }
+    }
+    printf("\n");
+}
+
+// Attach the counters summed since the last call to a result, as
+// per-run averages, and print them per byte and per node
+static void record_counters(result_t *r, size_t nodes) {
+    if (!use_counters || counter_runs == 0) return;
+    
+    r->counted = 1;
+    r->nodes = nodes;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        r->counters[i] = counter_sums[i] == PERF_UNAVAILABLE ? PERF_UNAVAILABLE
+                                                            : counter_sums[i] / counter_runs;
+        counter_sums[i] = 0;
+    }
+    counter_runs = 0;
+    
+    print_counter_line("per byte", r, r->bytes);
+    print_counter_line("per node", r, r->nodes);
+}
+
+static size_t count_nodes(const json_t *json) {
+    size_t nodes = 1;
+    for (const json_t *child = json->child; child; child = child->next) {
+        nodes += count_nodes(child);
+    }
+    return nodes;
+}
+
+static int split_documents(corpus_docs_t *c, int ndjson) {
+    size_t capacity = 1;
+    
+    if (ndjson) {
+        for (size_t i = 0; i < c->length; i++) capacity += c->data[i] == '\n';
+    }
+    c->docs = malloc(capacity * sizeof(char*));
+    c->lengths = malloc(capacity * sizeof(size_t));
+    c->trees = calloc(capacity, sizeof(json_t*));
+    if (!c->docs || !c->lengths || !c->trees) return -1;
+    
+    if (!ndjson) {
+        c->docs[0] = c->data;
+        c->lengths[0] = c->length;
+        c->count = 1;
+        return 0;
+    }
+    
+    const char *p = c->data;
+    const char *end = c->data + c->length;
+    while (p < end) {
+        const char *line_end = memchr(p, '\n', end - p);
+        if (!line_end) line_end = end;
+        if (line_end > p) {
+            c->docs[c->count] = p;
+            c->lengths[c->count] = line_end - p;
+            c->count++;
+        }
+        p = line_end + 1;
+    }
+    return 0;
+}
+
+// Time parse and delete separately over the same iterations
+static int bench_parse(const char *name, corpus_docs_t *c, uint64_t *parse_ns, uint64_t *delete_ns) {
+    size_t count = 0;
+    uint64_t elapsed = 0;
+    
+    while (count < MAX_SAMPLES && (count < MIN_SAMPLES || elapsed < MIN_SECONDS * 1e9)) {
+        counters_begin();
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < c->count; i++) {
+            c->trees[i] = json_parse_length(c->docs[i], c->lengths[i]);
+        }
+        uint64_t parsed = now_ns();
+        counters_end();
+        
+        if (count == 0) c->nodes = 0;
+        uint64_t deleting = now_ns();
+        for (size_t i = 0; i < c->count; i++) {
+            if (!c->trees[i]) {
+                fprintf(stderr, "%s: generated document %zu failed to parse\n", name, i);
+                return -1;
+            }
+            if (count == 0) c->nodes += count_nodes(c->trees[i]);
+            json_delete(c->trees[i]);
+        }
+        uint64_t deleted = now_ns();
+        
+        parse_ns[count] = parsed - start;
+        delete_ns[count] = deleted - deleting;
+        elapsed += (parsed - start) + (deleted - deleting);
+        count++;
+    }
+    
+    record_counters(record(name, "parse", c->length, parse_ns, count), c->nodes);
+    record(name, "delete", c->length, delete_ns, count);
+    return 0;
+}
+
+static int bench_validate(const char *name, corpus_docs_t *c, uint64_t *samples) {
+    size_t count = 0;
+    uint64_t elapsed = 0;
+    
+    while (count < MAX_SAMPLES && (count < MIN_SAMPLES || elapsed < MIN_SECONDS * 1e9)) {
+        counters_begin();
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < c->count; i++) {
+            if (!json_validate(c->docs[i], c->lengths[i])) {
+                fprintf(stderr, "%s: generated document %zu failed to validate\n", name, i);
+                return -1;
+            }
+        }
+        samples[count] = now_ns() - start;
+        counters_end();
+        elapsed += samples[count];
+        count++;
+    }
+    
+    record_counters(record(name, "validate", c->length, samples, count), c->nodes);
+    return 0;
+}
+
+static int bench_print(const char *name, corpus_docs_t *c, uint64_t *samples) {
+    size_t count = 0;
+    uint64_t elapsed = 0;
+    
+    for (size_t i = 0; i < c->count; i++) {
+        c->trees[i] = json_parse_length(c->docs[i], c->lengths[i]);
+        if (!c->trees[i]) return -1;
+    }
+    
+    while (count < MAX_SAMPLES && (count < MIN_SAMPLES || elapsed < MIN_SECONDS * 1e9)) {
+        counters_begin();
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < c->count; i++) {
+            free(json_print_compact(c->trees[i]));
+        }
+        samples[count] = now_ns() - start;
+        counters_end();
+        elapsed += samples[count];
+        count++;
+    }
+    
+    for (size_t i = 0; i < c->count; i++) json_delete(c->trees[i]);
+    record_counters(record(name, "print", c->length, samples, count), c->nodes);
+    return 0;
+}
+
+// Growable output for the transcoding benchmarks, reused between runs so
+// only the first one pays for growth
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} sink_t;
+
+static int sink_write(void *ctx, const char *data, size_t len) {
+    sink_t *s = ctx;
+    
+    if (s->capacity - s->length < len) {
+        size_t capacity = s->capacity ? s->capacity : 4096;
+        while (capacity - s->length < len) capacity *= 2;
+        char *grown = realloc(s->data, capacity);
+        if (!grown) return -1;
+        s->data = grown;
+        s->capacity = capacity;
+    }
+    memcpy(s->data + s->length, data, len);
+    s->length += len;
+    return 0;
+}
+
+// Reference path through a tree: what converting with json_parse and a
+// tree walk costs, to compare against the streaming transcoders. Covers
+// the MessagePack forms json_to_msgpack produces.
+static void put_be(sink_t *s, unsigned char lead, uint64_t value, int bytes) {
+    char buf[9];
+    buf[0] = (char)lead;
+    for (int i = bytes; i > 0; i--) {
+        buf[i] = (char)value;
+        value >>= 8;
+    }
+    sink_write(s, buf, (size_t)bytes + 1);
+}
+
+static void put_head(sink_t *s, unsigned char fix, size_t fix_limit, unsigned char lead, size_t n) {
+    if (n < fix_limit) put_be(s, fix | (unsigned char)n, 0, 0);
+    else if (n <= 0xffff) put_be(s, lead, n, 2);
+    else put_be(s, lead + 1, n, 4);
+}
+
+static void put_string(sink_t *s, const char *str) {
+    size_t len = strlen(str);
+    if (len < 32) put_be(s, 0xa0 | (unsigned char)len, 0, 0);
+    else if (len <= 0xff) put_be(s, 0xd9, len, 1);
+    else put_head(s, 0, 0, 0xda, len);
+    sink_write(s, str, len);
+}
+
+static void tree_to_msgpack(const json_t *json, sink_t *s) {
+    size_t n = 0;
+    
+    switch (json->type) {
+        case JSON_NULL: put_be(s, 0xc0, 0, 0); break;
+        case JSON_FALSE: put_be(s, 0xc2, 0, 0); break;
+        case JSON_TRUE: put_be(s, 0xc3, 0, 0); break;
+        case JSON_STRING: put_string(s, json->valuestring); break;
+        case JSON_NUMBER: {
+            double v = json->valuenumber;
+            if (v >= -9.2e18 && v <= 9.2e18 && (double)(int64_t)v == v) {
+                int64_t i = (int64_t)v;
+                if (i >= -32 && i < 128) put_be(s, (unsigned char)i, 0, 0);
+                else if (i >= INT32_MIN && i <= INT32_MAX) put_be(s, 0xd2, (uint32_t)i, 4);
+                else put_be(s, 0xd3, (uint64_t)i, 8);
+            } else {
+                uint64_t bits;
+                memcpy(&bits, &v, sizeof(bits));
+                put_be(s, 0xcb, bits, 8);
+            }
+            break;
+        }
+        default:
+            for (const json_t *child = json->child; child; child = child->next) n++;
+            if (json->type == JSON_ARRAY) put_head(s, 0x90, 16, 0xdc, n);
+            else put_head(s, 0x80, 16, 0xde, n);
+            for (const json_t *child = json->child; child; child = child->next) {
+                if (json->type == JSON_OBJECT) put_string(s, child->string);
+                tree_to_msgpack(child, s);
+            }
+            break;
+    }
+}
+
+static uint64_t take_be(const unsigned char **p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) value = (value << 8) | *(*p)++;
+    return value;
+}
+
+static char* take_string(const unsigned char **p, size_t len) {
+    char *str = malloc(len + 1);
+    memcpy(str, *p, len);
+    str[len] = '\0';
+    *p += len;
+    return str;
+}
+
+// Trusts its input: it only reads what json_to_msgpack wrote
+static json_t* tree_from_msgpack(const unsigned char **p) {
+    json_t *json = calloc(1, sizeof(json_t));
+    unsigned char c = *(*p)++;
+    size_t n = 0;
+    int is_map = 0;
+    
+    if (c <= 0x7f || c >= 0xe0) {
+        json->type = JSON_NUMBER;
+        json->valuenumber = (signed char)c;
+        if (c <= 0x7f) json->valuenumber = c;
+        return json;
+    }
+    if ((c & 0xe0) == 0xa0 || (c >= 0xd9 && c <= 0xdb)) {
+        json->type = JSON_STRING;
+        n = (c & 0xe0) == 0xa0 ? (size_t)(c & 0x1f) : take_be(p, 1 << (c - 0xd9));
+        json->valuestring = take_string(p, n);
+        return json;
+    }
+    
+    switch (c) {
+        case 0xc0: json->type = JSON_NULL; return json;
+        case 0xc2: json->type = JSON_FALSE; return json;
+        case 0xc3: json->type = JSON_TRUE; return json;
+        case 0xcb: {
+            uint64_t bits = take_be(p, 8);
+            json->type = JSON_NUMBER;
+            memcpy(&json->valuenumber, &bits, sizeof(double));
+            return json;
+        }
+        case 0xcc: case 0xcd: case 0xce: case 0xcf:
+            json->type = JSON_NUMBER;
+            json->valuenumber = (double)take_be(p, 1 << (c - 0xcc));
+            return json;
+        case 0xd0: case 0xd1: case 0xd2: case 0xd3: {
+            int bits = 8 << (c - 0xd0);
+            uint64_t v = take_be(p, bits / 8);
+            if (bits < 64 && (v >> (bits - 1))) v |= ~(uint64_t)0 << bits;
+            json->type = JSON_NUMBER;
+            json->valuenumber = (double)(int64_t)v;
+            return json;
+        }
+        case 0xdc: n = take_be(p, 2); break;
+        case 0xdd: n = take_be(p, 4); break;
+        case 0xde: n = take_be(p, 2); is_map = 1; break;
+        case 0xdf: n = take_be(p, 4); is_map = 1; break;
+        default:
+            n = c & 0x0f;
+            is_map = (c & 0xf0) == 0x80;
+            break;
+    }
+    
+    json->type = is_map ? JSON_OBJECT : JSON_ARRAY;
+    json_t *last = NULL;
+    for (size_t i = 0; i < n; i++) {
+        char *key = NULL;
+        if (is_map) {
+            unsigned char k = *(*p)++;
+            size_t len = (k & 0xe0) == 0xa0 ? (size_t)(k & 0x1f) : take_be(p, 1 << (k - 0xd9));
+            key = take_string(p, len);
+        }
+        json_t *child = tree_from_msgpack(p);
+        child->string = key;
+        child->prev = last;
+        if (last) last->next = child;
+        else json->child = child;
+        last = child;
+    }
+    if (last) json->child->prev = last;
+    return json;
+}
+
+// Streaming transcoders against the tree path, in both directions. All
+// rates are per byte of JSON so the rows compare directly.
+#define TRANSCODE_OPS 6
+static const char *transcode_ops[TRANSCODE_OPS] = {
+    "to_msgpack", "to_msgpack_tree", "from_msgpack", "from_msgpack_tree", "to_cbor", "from_cbor"
+};
+
+static int transcode_once(corpus_docs_t *c, int op, sink_t *packed, sink_t *cbor, sink_t *out) {
+    for (size_t i = 0; i < c->count; i++) {
+        const unsigned char *p = (const unsigned char *)packed[i].data;
+        json_t *tree;
+        char *text;
+        int status = 0;
+        
+        out->length = 0;
+        switch (op) {
+            case 0:
+                status = json_to_msgpack(c->docs[i], c->lengths[i], sink_write, out);
+                break;
+            case 1:
+                tree = json_parse_length(c->docs[i], c->lengths[i]);
+                if (!tree) return -1;
+                tree_to_msgpack(tree, out);
+                json_delete(tree);
+                break;
+            case 2:
+                status = json_from_msgpack(p, packed[i].length, sink_write, out, JSON_PRINT_COMPACT);
+                break;
+            case 3:
+                tree = tree_from_msgpack(&p);
+                text = json_print_compact(tree);
+                if (!text) status = -1;
+                json_free(text);
+                json_delete(tree);
+                break;
+            case 4:
+                status = json_to_cbor(c->docs[i], c->lengths[i], sink_write, out);
+                break;
+            default:
+                status = json_from_cbor(cbor[i].data, cbor[i].length, sink_write, out, JSON_PRINT_COMPACT);
+                break;
+        }
+        if (status != 0) return -1;
+    }
+    return 0;
+}
+
+static int bench_transcode(const char *name, corpus_docs_t *c, uint64_t *samples) {
+    sink_t out = { NULL, 0, 0 };
+    sink_t *packed = calloc(c->count, sizeof(sink_t));
+    sink_t *cbor = calloc(c->count, sizeof(sink_t));
+    int status = packed && cbor ? 0 : -1;
+    
+    c->nodes = 0;
+    for (size_t i = 0; i < c->count && status == 0; i++) {
+        json_t *tree = json_parse_length(c->docs[i], c->lengths[i]);
+        if (!tree || json_to_msgpack(c->docs[i], c->lengths[i], sink_write, &packed[i]) != 0 ||
+            json_to_cbor(c->docs[i], c->lengths[i], sink_write, &cbor[i]) != 0) {
+            status = -1;
+        }
+        if (tree) c->nodes += count_nodes(tree);
+        json_delete(tree);
+    }
+    
+    for (int op = 0; op < TRANSCODE_OPS && status == 0; op++) {
+        size_t count = 0;
+        uint64_t elapsed = 0;
+        
+        while (count < MAX_SAMPLES && (count < MIN_SAMPLES || elapsed < MIN_SECONDS * 1e9)) {
+            counters_begin();
+            uint64_t start = now_ns();
+            status = transcode_once(c, op, packed, cbor, &out);
+            samples[count] = now_ns() - start;
+            counters_end();
+            if (status != 0) break;
+            elapsed += samples[count];
+            count++;
+        }
+        if (status == 0) record_counters(record(name, transcode_ops[op], c->length, samples, count), c->nodes);
+    }
+    
+    if (status != 0) fprintf(stderr, "%s: transcoding failed\n", name);
+    for (size_t i = 0; i < c->count; i++) {
+        if (packed) free(packed[i].data);
+        if (cbor) free(cbor[i].data);
+    }
+    free(packed);
+    free(cbor);
+    free(out.data);
+    return status;
+}
+
+static int load_corpus(corpus_docs_t *c, int shape, uint64_t seed, size_t size, int format) {
+    memset(c, 0, sizeof(*c));
+    c->data = corpus_generate(shape, seed, size, format, &c->length);
+    if (!c->data) return -1;
+    return split_documents(c, shape == CORPUS_NDJSON);
+}
+
+static void free_corpus(corpus_docs_t *c) {
+    free(c->data);
+    free(c->docs);
+    free(c->lengths);
+    free(c->trees);
+}
+
+// Parse one shape at growing sizes and report the cost per byte, which
+// stays flat for a linear parser. Falling out of a cache level gives a
+// one-off step up; an O(n^2) stage shows as growth at every size, so
+// only two consecutive steps above SCALING_LIMIT are flagged.
+static int run_scaling(int shape, size_t max_size, uint64_t seed, uint64_t *samples, uint64_t *extra) {
+    const char *name = corpus_shape_name(shape);
+    double sizes[MAX_RESULTS];
+    double per_byte[MAX_RESULTS];
+    size_t steps = 0;
+    
+    for (size_t size = SCALING_MIN_SIZE; size <= max_size && steps < MAX_RESULTS / 2; size *= 4) {
+        corpus_docs_t c;
+        int status = load_corpus(&c, shape, seed, size, JSON_PRINT_COMPACT);
+        
+        if (status == 0) status = bench_parse(name, &c, samples, extra);
+        if (status == 0) {
+            sizes[steps] = (double)c.length;
+            per_byte[steps] = (double)results[result_count - 2].median_ns / c.length;
+            steps++;
+        }
+        free_corpus(&c);
+        if (status != 0) {
+            fprintf(stderr, "%s: failed at %zu bytes\n", name, size);
+            return -1;
+        }
+    }
+    
+    size_t baseline = 0;
+    while (baseline + 1 < steps && sizes[baseline] < SCALING_BASELINE) baseline++;
+    
+    printf("\n%-12s %10s %10s\n", "bytes", "ns/byte", "vs base");
+    int superlinear = 0;
+    for (size_t i = 0; i < steps; i++) {
+        double ratio = per_byte[i] / per_byte[baseline];
+        int flagged = i >= baseline + 2 &&
+                      per_byte[i] > per_byte[i - 1] * SCALING_LIMIT &&
+                      per_byte[i - 1] > per_byte[i - 2] * SCALING_LIMIT;
+        printf("%-12.0f %10.3f %9.2fx%s\n", sizes[i], per_byte[i], ratio,
+               i == baseline ? "  (baseline)" : flagged ? "  superlinear?" : "");
+        superlinear |= flagged;
+    }
+    return superlinear;
+}
+
+static int write_file(void *ctx, const char *data, size_t len) {
+    return fwrite(data, 1, len, ctx) == len ? 0 : -1;
+}
+
+typedef struct {
+    const char *name;
+    const char *op;
+    uint64_t instructions;  // PERF_UNAVAILABLE without counters
+    uint64_t min_ns;
+} gate_result_t;
+
+static const char *gate_ops[GATE_OPS] = { "parse", "validate", "print" };
+
+// One run of an operation over the whole corpus, lowering the recorded
+// instruction count and wall time where this run beat them. Trees are
+// built and freed outside the measured region.
+static int gate_run(corpus_docs_t *c, int counting, gate_result_t *g) {
+    uint64_t values[PERF_COUNTER_COUNT];
+    int is_parse = strcmp(g->op, "parse") == 0;
+    int is_print = strcmp(g->op, "print") == 0;
+    int ok = 1;
+    
+    for (size_t i = 0; is_print && i < c->count; i++) {
+        c->trees[i] = json_parse_length(c->docs[i], c->lengths[i]);
+    }
+    
+    uint64_t start = now_ns();
+    if (counting) perf_counters_start(&perf);
+    for (size_t i = 0; i < c->count; i++) {
+        if (is_parse) c->trees[i] = json_parse_length(c->docs[i], c->lengths[i]);
+        else if (is_print) free(json_print_compact(c->trees[i]));
+        else ok &= json_validate(c->docs[i], c->lengths[i]);
+    }
+    if (counting) perf_counters_stop(&perf, values);
+    uint64_t elapsed = now_ns() - start;
+    
+    for (size_t i = 0; (is_parse || is_print) && i < c->count; i++) {
+        ok &= c->trees[i] != NULL;
+        json_delete(c->trees[i]);
+    }
+    if (!ok || (counting && values[PERF_INSTRUCTIONS] == PERF_UNAVAILABLE)) return -1;
+    if (counting && values[PERF_INSTRUCTIONS] < g->instructions) g->instructions = values[PERF_INSTRUCTIONS];
+    if (elapsed < g->min_ns) g->min_ns = elapsed;
+    return 0;
+}
+
+static char* read_file(const char *path, size_t *length) {
+    FILE *in = fopen(path, "rb");
+    if (!in) return NULL;
+    
+    char *data = NULL;
+    size_t capacity = 0;
+    *length = 0;
+    while (1) {
+        if (*length == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            char *grown = realloc(data, capacity);
+            if (!grown) break;
+            data = grown;
+        }
+        size_t n = fread(data + *length, 1, capacity - *length, in);
+        *length += n;
+        if (n == 0) break;
+    }
+    
+    int failed = ferror(in) || *length == capacity;
+    fclose(in);
+    if (failed) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+// A positive number recorded for name and op under key, or 0
+static double baseline_find(const json_t *baseline, const char *name, const char *op, const char *key) {
+    const json_t *list = json_object_get(baseline, "results");
+    for (const json_t *e = list ? list->child : NULL; e; e = e->next) {
+        const json_t *c = json_object_get(e, "case");
+        const json_t *o = json_object_get(e, "op");
+        if (c && o && c->type == JSON_STRING && o->type == JSON_STRING &&
+            strcmp(c->valuestring, name) == 0 && strcmp(o->valuestring, op) == 0) {
+            const json_t *value = json_object_get(e, key);
+            return value && value->type == JSON_NUMBER && value->valuenumber > 0 ? value->valuenumber : 0;
+        }
+    }
+    return 0;
+}
+
+// Measure one case: its operations take turns for GATE_RUNS rounds over a
+// freshly generated corpus, skipping those measure marks 0 unless it is
+// NULL. g holds the case's GATE_OPS results.
+static int gate_case(const bench_case_t *bc, size_t size, uint64_t seed, int counting,
+                     gate_result_t *g, const int *measure) {
+    corpus_docs_t c;
+    
+    if (load_corpus(&c, bc->shape, seed, size, bc->format) != 0) {
+        fprintf(stderr, "%s: failed to generate corpus\n", bc->name);
+        return -1;
+    }
+    
+    int status = 0;
+    for (int run = 0; run < GATE_RUNS && status == 0; run++) {
+        for (int op = 0; op < GATE_OPS; op++) {
+            if (measure && !measure[op]) continue;
+            if (gate_run(&c, counting, &g[op]) != 0) {
+                fprintf(stderr, "%s: %s failed\n", bc->name, g[op].op);
+                status = -1;
+                break;
+            }
+        }
+    }
+    free_corpus(&c);
+    return status;
+}
+
+// The figure compared for g: instructions where this run and the baseline
+// both counted them, otherwise wall time. *base is the baseline's figure
+// for the same measure, or 0 when it has none.
+static double gate_value(const gate_result_t *g, const json_t *baseline, int recording,
+                         int *by_instructions, double *base) {
+    *base = baseline ? baseline_find(baseline, g->name, g->op, "instructions") : 0;
+    *by_instructions = g->instructions != PERF_UNAVAILABLE && (recording || *base > 0);
+    if (*by_instructions) return (double)g->instructions;
+    
+    *base = baseline ? baseline_find(baseline, g->name, g->op, "min_ns") : 0;
+    return (double)g->min_ns;
+}
+
+static int write_baseline(const char *path, size_t size, uint64_t seed,
+                          const gate_result_t *gate, size_t count) {
+    FILE *out = fopen(path, "w");
+    if (!out) return -1;
+    
+    json_writer_t *w = json_writer_new(write_file, out, 4096, JSON_PRINT_PRETTY);
+    if (!w) {
+        fclose(out);
+        return -1;
+    }
+    
+    json_writer_begin_object(w);
+    json_writer_key(w, "compiler");
+    json_writer_string(w, __VERSION__);
+    json_writer_key(w, "size");
+    json_writer_integer(w, (long long)size);
+    json_writer_key(w, "seed");
+    json_writer_integer(w, (long long)seed);
+    json_writer_key(w, "results");
+    json_writer_begin_array(w);
+    for (size_t i = 0; i < count; i++) {
+        json_writer_begin_object(w);
+        json_writer_key(w, "case");
+        json_writer_string(w, gate[i].name);
+        json_writer_key(w, "op");
+        json_writer_string(w, gate[i].op);
+        json_writer_key(w, "instructions");
+        if (gate[i].instructions == PERF_UNAVAILABLE) json_writer_null(w);
+        else json_writer_integer(w, (long long)gate[i].instructions);
+        json_writer_key(w, "min_ns");
+        json_writer_integer(w, (long long)gate[i].min_ns);
+        json_writer_end_object(w);
+    }
+    json_writer_end_array(w);
+    json_writer_end_object(w);
+    
+    int status = json_writer_flush(w);
+    json_writer_free(w);
+    if (fputc('\n', out) == EOF) status = -1;
+    if (fclose(out) != 0) status = -1;
+    return status;
+}
+
+// Measure every case and operation, then either record the results as
+// the baseline or compare against it: by instructions where both sides
+// counted them, otherwise by wall time. A negative threshold picks the
+// default for the measure used. Returns 0 when nothing regressed, 1 on a
+// regression or error.
+static int run_gate(const char *path, int recording, double threshold,
+                    size_t size, uint64_t seed, const char *only) {
+    gate_result_t gate[CASE_COUNT * GATE_OPS];
+    size_t count = 0;
+    json_t *baseline = NULL;
+    
+    int counting = perf_counters_open(&perf, PERF_MASK(PERF_INSTRUCTIONS)) > 0;
+    if (!counting) {
+        fprintf(stderr, "Cannot count instructions (%s): comparing wall time\n", perf_counters_error(&perf));
+    }
+    
+    if (!recording) {
+        size_t length;
+        char *text = read_file(path, &length);
+        baseline = text ? json_parse_length(text, length) : NULL;
+        free(text);
+        if (!baseline) {
+            fprintf(stderr, "Cannot read baseline %s (record one with --record-baseline)\n", path);
+            perf_counters_close(&perf);
+            return 1;
+        }
+        
+        // Measure what the baseline measured
+        const json_t *value = json_object_get(baseline, "size");
+        if (value && value->type == JSON_NUMBER) size = (size_t)value->valuenumber;
+        value = json_object_get(baseline, "seed");
+        if (value && value->type == JSON_NUMBER) seed = (uint64_t)value->valuenumber;
+        value = json_object_get(baseline, "compiler");
+        if (value && value->type == JSON_STRING && strcmp(value->valuestring, __VERSION__) != 0) {
+            fprintf(stderr, "Warning: baseline built with compiler %s, this is %s\n",
+                    value->valuestring, __VERSION__);
+        }
+    }
+    
+    const bench_case_t *case_of[CASE_COUNT];
+    size_t case_count = 0;
+    int failed = 0;
+    for (size_t i = 0; i < CASE_COUNT && !failed; i++) {
+        if (only && strcmp(only, cases[i].name) != 0) continue;
+        
+        gate_result_t *g = &gate[count];
+        for (int op = 0; op < GATE_OPS; op++) {
+            g[op].name = cases[i].name;
+            g[op].op = gate_ops[op];
+            g[op].instructions = PERF_UNAVAILABLE;
+            g[op].min_ns = UINT64_MAX;
+        }
+        case_of[case_count++] = &cases[i];
+        count += GATE_OPS;
+        failed = gate_case(&cases[i], size, seed, counting, g, NULL) != 0;
+    }
+    
+    // Wall time that looks regressed is measured again, after a pause,
+    // before it counts: the lowest time only improves with more runs, so
+    // a stretch of contention passes while a real slowdown stays. A
+    // recording gets every pass, so its baseline is as low as a gate can
+    // reach.
+    for (int pass = 0; pass < GATE_RETRIES && !failed; pass++) {
+        struct timespec pause = { GATE_RETRY_PAUSE, 0 };
+        int again = 0;
+        for (size_t i = 0; i < case_count && !failed; i++) {
+            gate_result_t *g = &gate[i * GATE_OPS];
+            int measure[GATE_OPS];
+            int any = 0;
+            
+            for (int op = 0; op < GATE_OPS; op++) {
+                int by_instructions;
+                double base;
+                double value = gate_value(&g[op], baseline, recording, &by_instructions, &base);
+                double limit = threshold >= 0 ? threshold : GATE_TIME_THRESHOLD;
+                measure[op] = !by_instructions && (recording || (base > 0 && 100.0 * (value - base) / base > limit));
+                any |= measure[op];
+            }
+            if (!any) continue;
+            if (!again) nanosleep(&pause, NULL);
+            again = 1;
+            failed = gate_case(case_of[i], size, seed, counting, g, measure) != 0;
+        }
+        if (!again) break;
+    }
+    
+    int regressed = 0;
+    if (!failed) {
+        printf("%-16s %-9s %-12s %14s %14s %9s\n", "case", "op", "measure", "value", "baseline", "change");
+    }
+    for (size_t i = 0; i < count && !failed; i++) {
+        const gate_result_t *g = &gate[i];
+        int by_instructions;
+        double base;
+        double value = gate_value(g, baseline, recording, &by_instructions, &base);
+        
+        printf("%-16s %-9s %-12s %14.0f", g->name, g->op, by_instructions ? "instructions" : "ns", value);
+        if (!baseline) {
+            printf("\n");
+        } else if (base == 0) {
+            printf(" %14s %9s\n", "-", "new");
+        } else {
+            double limit = threshold >= 0 ? threshold : by_instructions ? GATE_THRESHOLD : GATE_TIME_THRESHOLD;
+            double change = 100.0 * (value - base) / base;
+            int worse = change > limit;
+            printf(" %14.0f %+8.2f%%%s\n", base, change, worse ? "  REGRESSED" : "");
+            regressed |= worse;
+        }
+    }
+    
+    perf_counters_close(&perf);
+    json_delete(baseline);
+    if (failed) return 1;
+    
+    if (recording) {
+        if (write_baseline(path, size, seed, gate, count) != 0) {
+            fprintf(stderr, "Cannot write %s\n", path);
+            return 1;
+        }
+        printf("Baseline written to %s\n", path);
+        return 0;
+    }
+    
+    if (regressed) {
+        printf("Some operations grew past the threshold over the baseline\n");
+    }
+    return regressed;
+}
+
+static int write_json(const char *path, size_t size, uint64_t seed) {
+    FILE *out = fopen(path, "w");
+    if (!out) return -1;
+    
+    json_writer_t *w = json_writer_new(write_file, out, 4096, JSON_PRINT_PRETTY);
+    if (!w) {
+        fclose(out);
+        return -1;
+    }
+    
+    json_writer_begin_object(w);
+    json_writer_key(w, "compiler");
+    json_writer_string(w, __VERSION__);
+    json_writer_key(w, "size");
+    json_writer_integer(w, (long long)size);
+    json_writer_key(w, "seed");
+    json_writer_integer(w, (long long)seed);
+    json_writer_key(w, "results");
+    json_writer_begin_array(w);
+    for (size_t i = 0; i < result_count; i++) {
+        const result_t *r = &results[i];
+        json_writer_begin_object(w);
+        json_writer_key(w, "case");
+        json_writer_string(w, r->name);
+        json_writer_key(w, "op");
+        json_writer_string(w, r->op);
+        json_writer_key(w, "bytes");
+        json_writer_integer(w, (long long)r->bytes);
+        json_writer_key(w, "samples");
+        json_writer_integer(w, (long long)r->samples);
+        json_writer_key(w, "min_ns");
+        json_writer_integer(w, (long long)r->min_ns);
+        json_writer_key(w, "median_ns");
+        json_writer_integer(w, (long long)r->median_ns);
+        json_writer_key(w, "mean_ns");
+        json_writer_integer(w, (long long)r->mean_ns);
+        json_writer_key(w, "mb_per_s");
+        json_writer_number(w, mb_per_second(r->bytes, r->median_ns));
+        if (r->counted) {
+            json_writer_key(w, "nodes");
+            json_writer_integer(w, (long long)r->nodes);
+            json_writer_key(w, "counters");
+            json_writer_begin_object(w);
+            for (int j = 0; j < PERF_COUNTER_COUNT; j++) {
+                json_writer_key(w, perf_counter_name(j));
+                if (r->counters[j] == PERF_UNAVAILABLE) json_writer_null(w);
+                else json_writer_integer(w, (long long)r->counters[j]);
+            }
+            json_writer_end_object(w);
+        }
+        json_writer_end_object(w);
+    }
+    json_writer_end_array(w);
+    json_writer_end_object(w);
+    
+    int status = json_writer_flush(w);
+    json_writer_free(w);
+    if (fputc('\n', out) == EOF) status = -1;
+    if (fclose(out) != 0) status = -1;
+    return status;
+}
+
+static int write_csv(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out) return -1;
+    
+    fprintf(out, "case,op,bytes,samples,min_ns,median_ns,mean_ns,mb_per_s");
+    if (use_counters) {
+        fprintf(out, ",nodes");
+        for (int j = 0; j < PERF_COUNTER_COUNT; j++) fprintf(out, ",%s", perf_counter_name(j));
+    }
+    fprintf(out, "\n");
+    
+    for (size_t i = 0; i < result_count; i++) {
+        const result_t *r = &results[i];
+        fprintf(out, "%s,%s,%zu,%zu,%llu,%llu,%llu,%.1f", r->name, r->op, r->bytes, r->samples,
+                (unsigned long long)r->min_ns, (unsigned long long)r->median_ns,
+                (unsigned long long)r->mean_ns, mb_per_second(r->bytes, r->median_ns));
+        if (use_counters) {
+            // Operations without counters (delete) and unavailable counters stay empty
+            if (r->counted) fprintf(out, ",%zu", r->nodes);
+            else fprintf(out, ",");
+            for (int j = 0; j < PERF_COUNTER_COUNT; j++) {
+                if (r->counted && r->counters[j] != PERF_UNAVAILABLE) {
+                    fprintf(out, ",%llu", (unsigned long long)r->counters[j]);
+                } else {
+                    fprintf(out, ",");
+                }
+            }
+        }
+        fprintf(out, "\n");
+    }
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--size BYTES] [--seed N] [--case NAME] [--counters] [--transcode]"
+                    " [--json FILE] [--csv FILE]\n",
+            program);
+    fprintf(stderr, "       %s --scaling SHAPE [--max-size BYTES] [--seed N] [--json FILE] [--csv FILE]\n",
+            program);
+    fprintf(stderr, "       %s --gate BASELINE [--threshold PERCENT] [--case NAME]\n", program);
+    fprintf(stderr, "       %s --record-baseline BASELINE [--size BYTES] [--seed N]\n", program);
+}
+
+int main(int argc, char *argv[]) {
+    size_t size = DEFAULT_SIZE;
+    uint64_t seed = DEFAULT_SEED;
+    const char *only = NULL;
+    const char *json_path = NULL;
+    const char *csv_path = NULL;
+    const char *scaling = NULL;
+    size_t max_size = 64 * 1024 * 1024;
+    const char *gate_path = NULL;
+    int recording = 0;
+    double threshold = -1;  // Default for the measure used
+    int size_given = 0;
+    int transcode = 0;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--counters") == 0) {
+            use_counters = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--transcode") == 0) {
+            transcode = 1;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--size") == 0) {
+            size = strtoull(argv[++i], NULL, 10);
+            size_given = 1;
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--case") == 0) {
+            only = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv_path = argv[++i];
+        } else if (strcmp(argv[i], "--scaling") == 0) {
+            scaling = argv[++i];
+        } else if (strcmp(argv[i], "--max-size") == 0) {
+            max_size = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--gate") == 0) {
+            gate_path = argv[++i];
+            recording = 0;
+        } else if (strcmp(argv[i], "--record-baseline") == 0) {
+            gate_path = argv[++i];
+            recording = 1;
+        } else if (strcmp(argv[i], "--threshold") == 0) {
+            threshold = strtod(argv[++i], NULL);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (gate_path) {
+        return run_gate(gate_path, recording, threshold, size_given ? size : GATE_SIZE, seed, only);
+    }
+    
+    uint64_t *samples = malloc(MAX_SAMPLES * sizeof(uint64_t));
+    uint64_t *extra = malloc(MAX_SAMPLES * sizeof(uint64_t));
+    if (!samples || !extra) return 1;
+    
+    if (use_counters) {
+        if (perf_counters_open(&perf, PERF_ALL) == 0) {
+            fprintf(stderr, "Performance counters unavailable: %s\n", perf_counters_error(&perf));
+            use_counters = 0;
+        } else if (perf.open_count < PERF_COUNTER_COUNT) {
+            fprintf(stderr, "Performance counters not available here:");
+            for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+                if (perf.fds[i] < 0) fprintf(stderr, " %s", perf_counter_name(i));
+            }
+            fprintf(stderr, "\n");
+        }
+    }
+    
+    printf("%-16s %-17s %10s %7s %12s %12s %10s\n",
+           "case", "op", "bytes", "samples", "min_us", "median_us", "MB/s");
+    
+    int failed = 0;
+    if (scaling) {
+        int shape = corpus_shape_from_name(scaling);
+        if (shape < 0) {
+            fprintf(stderr, "Unknown shape: %s\n", scaling);
+            failed = 1;
+        } else {
+            failed = run_scaling(shape, max_size, seed, samples, extra) != 0;
+        }
+    }
+    
+    for (size_t i = 0; i < CASE_COUNT && !failed && !scaling; i++) {
+        const bench_case_t *bc = &cases[i];
+        corpus_docs_t c;
+        
+        if (only && strcmp(only, bc->name) != 0) continue;
+        
+        if (load_corpus(&c, bc->shape, seed, size, bc->format) != 0) {
+            fprintf(stderr, "%s: failed to generate corpus\n", bc->name);
+            failed = 1;
+        } else if (transcode) {
+            failed = bench_transcode(bc->name, &c, samples) != 0;
+        } else {
+            failed = bench_parse(bc->name, &c, samples, extra) != 0 ||
+                     bench_validate(bc->name, &c, samples) != 0 ||
+                     bench_print(bc->name, &c, samples) != 0;
+        }
+        free_corpus(&c);
+    }
+    
+    if (json_path && write_json(json_path, size, seed) != 0) {
+        fprintf(stderr, "Cannot write %s\n", json_path);
+        failed = 1;
+    }
+    if (csv_path && write_csv(csv_path) != 0) {
+        fprintf(stderr, "Cannot write %s\n", csv_path);
+        failed = 1;
+    }
+    
+    if (use_counters) perf_counters_close(&perf);
+    free(samples);
+    free(extra);
+    return failed;
+}
@@ -0,0 +1,131 @@
+// tests/bench_dtoa.c
+// Compares the library number formatters against snprintf
+#define _POSIX_C_SOURCE 200809L
+#include "../include/json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#define VALUE_COUNT 1000000
+
+// Deterministic xorshift so every run formats the same values
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Uniformly random bit patterns (finite only)
+static void fill_random(double *values, int count) {
+    for (int i = 0; i < count; i++) {
+        double v;
+        do {
+            uint64_t bits = next_random();
+            memcpy(&v, &bits, sizeof(v));
+        } while (v != v || v - v != 0);  // Skip NaN and infinity
+        values[i] = v;
+    }
+}
+
+// Values typical of metrics payloads: readings with a couple of decimals,
+// latencies, ratios and fractional epoch timestamps
+static void fill_telemetry(double *values, int count) {
+    for (int i = 0; i < count; i++) {
+        uint64_t r = next_random();
+        switch (i % 4) {
+            case 0: values[i] = (double)(r % 10000) / 100.0; break;
+            case 1: values[i] = (double)(r % 1000000) / 1000.0; break;
+            case 2: values[i] = (double)(r % 1000) / 1000.0; break;
+            default: values[i] = 1700000000.0 + (double)(r % 1000000) / 1000.0; break;
+        }
+    }
+}
+
+static int format_snprintf17(double value, char *buf) {
+    return snprintf(buf, JSON_NUMBER_BUFFER_SIZE, "%.17g", value);
+}
+
+// The classic shortest-%g loop: try 15, 16, then 17 significant digits
+static int format_snprintf_shortest(double value, char *buf) {
+    int len = snprintf(buf, JSON_NUMBER_BUFFER_SIZE, "%.15g", value);
+    if (strtod(buf, NULL) != value) {
+        len = snprintf(buf, JSON_NUMBER_BUFFER_SIZE, "%.16g", value);
+        if (strtod(buf, NULL) != value) {
+            len = snprintf(buf, JSON_NUMBER_BUFFER_SIZE, "%.17g", value);
+        }
+    }
+    return len;
+}
+
+static void run(const char *label, const char *set, int (*format)(double, char *),
+                const double *values, int count) {
+    char buf[JSON_NUMBER_BUFFER_SIZE];
+    size_t bytes = 0;
+    
+    double start = now_seconds();
+    for (int i = 0; i < count; i++) {
+        bytes += (size_t)format(values[i], buf);
+    }
+    double elapsed = now_seconds() - start;
+    
+    printf("%-10s %-20s %8.1f ns/value %6.2f bytes/value\n",
+           set, label, elapsed * 1e9 / count, (double)bytes / count);
+}
+
+static void run_integers(void) {
+    long long *values = malloc(VALUE_COUNT * sizeof(long long));
+    char buf[JSON_NUMBER_BUFFER_SIZE];
+    size_t bytes = 0;
+    
+    for (int i = 0; i < VALUE_COUNT; i++) {
+        values[i] = (long long)(next_random() >> (i % 60));
+    }
+    
+    double start = now_seconds();
+    for (int i = 0; i < VALUE_COUNT; i++) {
+        bytes += (size_t)json_format_integer(values[i], buf);
+    }
+    double lib = now_seconds() - start;
+    
+    start = now_seconds();
+    for (int i = 0; i < VALUE_COUNT; i++) {
+        bytes += (size_t)snprintf(buf, sizeof(buf), "%lld", values[i]);
+    }
+    double libc = now_seconds() - start;
+    
+    printf("%-10s %-20s %8.1f ns/value\n", "integers", "json_format_integer", lib * 1e9 / VALUE_COUNT);
+    printf("%-10s %-20s %8.1f ns/value\n", "integers", "snprintf %lld", libc * 1e9 / VALUE_COUNT);
+    free(values);
+    (void)bytes;
+}
+
+int main(void) {
+    double *values = malloc(VALUE_COUNT * sizeof(double));
+    if (!values) return 1;
+    
+    fill_random(values, VALUE_COUNT);
+    run("json_format_double", "random", json_format_double, values, VALUE_COUNT);
+    run("snprintf %.17g", "random", format_snprintf17, values, VALUE_COUNT);
+    run("snprintf shortest", "random", format_snprintf_shortest, values, VALUE_COUNT);
+    
+    fill_telemetry(values, VALUE_COUNT);
+    run("json_format_double", "telemetry", json_format_double, values, VALUE_COUNT);
+    run("snprintf %.17g", "telemetry", format_snprintf17, values, VALUE_COUNT);
+    run("snprintf shortest", "telemetry", format_snprintf_shortest, values, VALUE_COUNT);
+    
+    run_integers();
+    
+    free(values);
+    return 0;
+}
@@ -0,0 +1,409 @@
+// tests/corpus.c
+// Deterministic synthetic JSON documents for benchmarks. Documents are
+// produced with the library's streaming writer, so any size can be
+// generated in constant memory.
+#define _POSIX_C_SOURCE 200809L
+#include "corpus.h"
+#include "../include/json.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define WRITER_BUFFER_SIZE 4096
+#define NESTED_DEPTH       200
+
+typedef struct {
+    FILE *out;
+    size_t written;
+    uint64_t rng;
+} corpus_t;
+
+static const char *words[] = {
+    "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "json",
+    "parser", "stream", "buffer", "latency", "throughput", "cache", "vector",
+    "record", "status", "update", "release", "build", "server", "client",
+    "request", "response", "metric", "signal", "pipeline", "kernel", "thread"
+};
+#define WORD_COUNT (sizeof(words) / sizeof(words[0]))
+
+static const char *languages[] = { "en", "de", "fr", "es", "ja", "pt" };
+static const char *weekdays[] = { "Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun" };
+static const char *months[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+static const char *levels[] = { "DEBUG", "INFO", "INFO", "INFO", "WARN", "ERROR" };
+
+// Fragments for the unicode shape, already in JSON string syntax: raw
+// UTF-8 of every sequence length, \u escapes (including surrogate
+// pairs) and the short escapes
+static const char *unicode_fragments[] = {
+    "caf\xc3\xa9", "na\xc3\xafve", "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82",
+    "\xe4\xb8\xad\xe6\x96\x87", "\xe3\x81\x93\xe3\x82\x93\xe3\x81\xab\xe3\x81\xa1\xe3\x81\xaf",
+    "\xf0\x9f\x98\x80", "\xf0\x9f\x9a\x80\xf0\x9f\x8c\x8d",
+    "\\u00e9", "\\u4e2d\\u6587", "\\ud83d\\ude00", "\\u0000", "\\u001f",
+    "\\n", "\\t", "\\r", "\\\"", "\\\\", "\\/", "\\b\\f",
+    "plain", "ascii text", "x"
+};
+#define UNICODE_FRAGMENT_COUNT (sizeof(unicode_fragments) / sizeof(unicode_fragments[0]))
+
+static int write_file(void *ctx, const char *data, size_t len) {
+    corpus_t *c = ctx;
+    if (fwrite(data, 1, len, c->out) != len) return -1;
+    c->written += len;
+    return 0;
+}
+
+// xorshift64*: fast, and identical output for a seed on every platform
+static uint64_t next_random(corpus_t *c) {
+    c->rng ^= c->rng >> 12;
+    c->rng ^= c->rng << 25;
+    c->rng ^= c->rng >> 27;
+    return c->rng * 0x2545F4914F6CDD1DULL;
+}
+
+static uint64_t random_below(corpus_t *c, uint64_t limit) {
+    return next_random(c) % limit;
+}
+
+// Space-separated random words, at most capacity - 1 bytes
+static size_t random_text(corpus_t *c, char *buffer, size_t capacity, int word_count) {
+    size_t len = 0;
+    
+    for (int i = 0; i < word_count; i++) {
+        const char *word = words[random_below(c, WORD_COUNT)];
+        size_t word_len = strlen(word);
+        if (len + word_len + 2 > capacity) break;
+        if (i > 0) buffer[len++] = ' ';
+        memcpy(buffer + len, word, word_len);
+        len += word_len;
+    }
+    buffer[len] = '\0';
+    return len;
+}
+
+static void write_user(corpus_t *c, json_writer_t *w) {
+    char name[64];
+    char handle[64];
+    
+    random_text(c, name, sizeof(name), 2);
+    snprintf(handle, sizeof(handle), "%s_%u", words[random_below(c, WORD_COUNT)],
+             (unsigned)random_below(c, 100000));
+    
+    json_writer_begin_object(w);
+    json_writer_key(w, "id");
+    json_writer_integer(w, (long long)random_below(c, 1000000000000LL));
+    json_writer_key(w, "name");
+    json_writer_string(w, name);
+    json_writer_key(w, "screen_name");
+    json_writer_string(w, handle);
+    json_writer_key(w, "followers_count");
+    json_writer_integer(w, (long long)random_below(c, 5000000));
+    json_writer_key(w, "verified");
+    json_writer_bool(w, random_below(c, 10) == 0);
+    json_writer_key(w, "location");
+    if (random_below(c, 3) == 0) {
+        json_writer_null(w);
+    } else {
+        json_writer_string(w, words[random_below(c, WORD_COUNT)]);
+    }
+    json_writer_end_object(w);
+}
+
+static void write_record(corpus_t *c, json_writer_t *w, long long id) {
+    char text[256];
+    char created[40];
+    size_t text_len = random_text(c, text, sizeof(text), 5 + (int)random_below(c, 20));
+    
+    snprintf(created, sizeof(created), "%s %s %02u %02u:%02u:%02u +0000 20%02u",
+             weekdays[random_below(c, 7)], months[random_below(c, 12)],
+             (unsigned)(1 + random_below(c, 28)), (unsigned)random_below(c, 24),
+             (unsigned)random_below(c, 60), (unsigned)random_below(c, 60),
+             (unsigned)(10 + random_below(c, 15)));
+    
+    json_writer_begin_object(w);
+    json_writer_key(w, "id");
+    json_writer_integer(w, id);
+    json_writer_key(w, "created_at");
+    json_writer_string(w, created);
+    json_writer_key(w, "text");
+    json_writer_string_len(w, text, text_len);
+    json_writer_key(w, "user");
+    write_user(c, w);
+    
+    json_writer_key(w, "entities");
+    json_writer_begin_object(w);
+    json_writer_key(w, "hashtags");
+    json_writer_begin_array(w);
+    for (int i = (int)random_below(c, 4); i > 0; i--) {
+        long long start = (long long)random_below(c, text_len + 1);
+        json_writer_begin_object(w);
+        json_writer_key(w, "text");
+        json_writer_string(w, words[random_below(c, WORD_COUNT)]);
+        json_writer_key(w, "indices");
+        json_writer_begin_array(w);
+        json_writer_integer(w, start);
+        json_writer_integer(w, start + 1 + (long long)random_below(c, 12));
+        json_writer_end_array(w);
+        json_writer_end_object(w);
+    }
+    json_writer_end_array(w);
+    json_writer_key(w, "urls");
+    json_writer_begin_array(w);
+    json_writer_end_array(w);
+    json_writer_end_object(w);
+    
+    json_writer_key(w, "retweet_count");
+    json_writer_integer(w, (long long)random_below(c, 10000));
+    json_writer_key(w, "favorite_count");
+    json_writer_integer(w, (long long)random_below(c, 50000));
+    json_writer_key(w, "favorited");
+    json_writer_bool(w, 0);
+    json_writer_key(w, "lang");
+    json_writer_string(w, languages[random_below(c, 6)]);
+    json_writer_key(w, "coordinates");
+    if (random_below(c, 4) == 0) {
+        json_writer_begin_array(w);
+        json_writer_number(w, (double)random_below(c, 360000000) / 1e6 - 180.0);
+        json_writer_number(w, (double)random_below(c, 180000000) / 1e6 - 90.0);
+        json_writer_end_array(w);
+    } else {
+        json_writer_null(w);
+    }
+    json_writer_end_object(w);
+}
+
+static void write_number(corpus_t *c, json_writer_t *w) {
+    switch (random_below(c, 4)) {
+        case 0:  // Counter-like integers
+            json_writer_integer(w, (long long)random_below(c, 1000000));
+            break;
+        case 1:  // Large signed integers
+            json_writer_integer(w, (long long)(next_random(c) >> 12) - (1LL << 51));
+            break;
+        case 2:  // Prices and other fixed-point values
+            json_writer_number(w, (double)random_below(c, 10000000) / 100.0);
+            break;
+        default: {  // Full-precision doubles across a wide exponent range
+            double mantissa = (double)(next_random(c) >> 11) / 9007199254740992.0;
+            int exponent = (int)random_below(c, 21) - 10;
+            double scale = 1.0;
+            for (int i = 0; i < (exponent < 0 ? -exponent : exponent); i++) scale *= 10.0;
+            json_writer_number(w, exponent < 0 ? mantissa / scale : mantissa * scale);
+            break;
+        }
+    }
+}
+
+// A service definition whose "child" chain nests NESTED_DEPTH levels
+static void write_service(corpus_t *c, json_writer_t *w, int index) {
+    char name[32];
+    
+    for (int depth = 0; depth < NESTED_DEPTH; depth++) {
+        snprintf(name, sizeof(name), "%s-%d-%d", words[random_below(c, WORD_COUNT)], index, depth);
+        json_writer_begin_object(w);
+        json_writer_key(w, "name");
+        json_writer_string(w, name);
+        json_writer_key(w, "enabled");
+        json_writer_bool(w, random_below(c, 5) != 0);
+        json_writer_key(w, "limits");
+        json_writer_begin_object(w);
+        json_writer_key(w, "cpu");
+        json_writer_number(w, (double)random_below(c, 1600) / 100.0);
+        json_writer_key(w, "memory_mb");
+        json_writer_integer(w, 64LL << random_below(c, 8));
+        json_writer_end_object(w);
+        json_writer_key(w, "child");
+    }
+    json_writer_null(w);
+    for (int depth = 0; depth < NESTED_DEPTH; depth++) {
+        json_writer_end_object(w);
+    }
+}
+
+// Long strings with the occasional character that needs escaping
+static void write_long_string(corpus_t *c, json_writer_t *w, char *buffer, size_t capacity) {
+    size_t target = 1024 + random_below(c, capacity - 1024);
+    size_t len = 0;
+    
+    while (len + 16 < target) {
+        const char *word = words[random_below(c, WORD_COUNT)];
+        size_t word_len = strlen(word);
+        memcpy(buffer + len, word, word_len);
+        len += word_len;
+        
+        uint64_t r = random_below(c, 64);
+        buffer[len++] = r == 0 ? '\n' : r == 1 ? '"' : r == 2 ? '\t' : ' ';
+    }
+    json_writer_string_len(w, buffer, len);
+}
+
+// One member of the wide object; keys are unique and values vary in type
+static void write_member(corpus_t *c, json_writer_t *w, int index) {
+    char key[48];
+    
+    snprintf(key, sizeof(key), "%s_%08d", words[random_below(c, WORD_COUNT)], index);
+    json_writer_key(w, key);
+    switch (random_below(c, 5)) {
+        case 0:  json_writer_integer(w, (long long)random_below(c, 100000)); break;
+        case 1:  json_writer_number(w, (double)random_below(c, 1000000) / 1000.0); break;
+        case 2:  json_writer_bool(w, (int)random_below(c, 2)); break;
+        case 3:  json_writer_null(w); break;
+        default: json_writer_string(w, words[random_below(c, WORD_COUNT)]); break;
+    }
+}
+
+static void write_log_event(corpus_t *c, json_writer_t *w, char *buffer, size_t capacity) {
+    char timestamp[32];
+    char trace[33];
+    size_t len;
+    
+    snprintf(timestamp, sizeof(timestamp), "2024-%02u-%02uT%02u:%02u:%02u.%03uZ",
+             (unsigned)(1 + random_below(c, 12)), (unsigned)(1 + random_below(c, 28)),
+             (unsigned)random_below(c, 24), (unsigned)random_below(c, 60),
+             (unsigned)random_below(c, 60), (unsigned)random_below(c, 1000));
+    for (int i = 0; i < 32; i++) trace[i] = "0123456789abcdef"[random_below(c, 16)];
+    trace[32] = '\0';
+    
+    // Messages mix prose with paths and quoted values, as real logs do
+    len = random_text(c, buffer, capacity / 2, 10 + (int)random_below(c, 50));
+    len += snprintf(buffer + len, capacity - len, " path=\"/var/lib/%s/%s.json\" status=%u",
+                    words[random_below(c, WORD_COUNT)], words[random_below(c, WORD_COUNT)],
+                    (unsigned)(200 + random_below(c, 400)));
+    
+    json_writer_begin_object(w);
+    json_writer_key(w, "timestamp");
+    json_writer_string(w, timestamp);
+    json_writer_key(w, "level");
+    json_writer_string(w, levels[random_below(c, 6)]);
+    json_writer_key(w, "service");
+    json_writer_string(w, words[random_below(c, WORD_COUNT)]);
+    json_writer_key(w, "trace_id");
+    json_writer_string(w, trace);
+    json_writer_key(w, "message");
+    json_writer_string_len(w, buffer, len);
+    json_writer_end_object(w);
+}
+
+// The writer escapes only what it must, so this shape is written by
+// hand to get \u escapes and surrogate pairs into the document
+static size_t write_unicode(corpus_t *c, size_t target_bytes, int format) {
+    const char *open = format == JSON_PRINT_PRETTY ? "[\n  \"" : "[\"";
+    const char *separator = format == JSON_PRINT_PRETTY ? "\",\n  \"" : "\",\"";
+    const char *close = format == JSON_PRINT_PRETTY ? "\"\n]" : "\"]";
+    
+    if (write_file(c, open, strlen(open)) != 0) return 0;
+    while (1) {
+        for (int i = 4 + (int)random_below(c, 60); i > 0; i--) {
+            const char *fragment = unicode_fragments[random_below(c, UNICODE_FRAGMENT_COUNT)];
+            if (write_file(c, fragment, strlen(fragment)) != 0) return 0;
+        }
+        if (c->written >= target_bytes) break;
+        if (write_file(c, separator, strlen(separator)) != 0) return 0;
+    }
+    if (write_file(c, close, strlen(close)) != 0) return 0;
+    return c->written;
+}
+
+static size_t write_ndjson(corpus_t *c, size_t target_bytes) {
+    long long id = 1;
+    
+    do {
+        json_writer_t *w = json_writer_new(write_file, c, WRITER_BUFFER_SIZE, JSON_PRINT_COMPACT);
+        if (!w) return 0;
+        write_record(c, w, id++);
+        int status = json_writer_flush(w);
+        json_writer_free(w);
+        if (status != 0 || write_file(c, "\n", 1) != 0) return 0;
+    } while (c->written < target_bytes);
+    
+    return c->written;
+}
+
+size_t corpus_write(FILE *out, int shape, uint64_t seed, size_t target_bytes, int format) {
+    corpus_t c = { out, 0, seed ? seed : 1 };
+    
+    if (shape < 0 || shape >= CORPUS_SHAPE_COUNT) return 0;
+    if (shape == CORPUS_NDJSON) return write_ndjson(&c, target_bytes);
+    if (shape == CORPUS_UNICODE) return write_unicode(&c, target_bytes, format);
+    
+    json_writer_t *w = json_writer_new(write_file, &c, WRITER_BUFFER_SIZE, format);
+    if (!w) return 0;
+    
+    char *scratch = NULL;
+    int index = 0;
+    
+    if (shape == CORPUS_NESTED) {
+        json_writer_begin_object(w);
+        json_writer_key(w, "version");
+        json_writer_integer(w, 3);
+        json_writer_key(w, "services");
+    }
+    if (shape == CORPUS_STRINGS || shape == CORPUS_LOGS) {
+        scratch = malloc(64 * 1024);
+        if (!scratch) {
+            json_writer_free(w);
+            return 0;
+        }
+    }
+    
+    // Flushing after every element keeps c.written exact, so the size
+    // check is accurate even for tiny targets; stdio still batches writes
+    if (shape == CORPUS_WIDE) {
+        json_writer_begin_object(w);
+    } else {
+        json_writer_begin_array(w);
+    }
+    do {
+        switch (shape) {
+            case CORPUS_RECORDS: write_record(&c, w, ++index); break;
+            case CORPUS_NUMBERS: write_number(&c, w); break;
+            case CORPUS_NESTED:  write_service(&c, w, index++); break;
+            case CORPUS_STRINGS: write_long_string(&c, w, scratch, 64 * 1024); break;
+            case CORPUS_WIDE:    write_member(&c, w, index++); break;
+            case CORPUS_LOGS:    write_log_event(&c, w, scratch, 64 * 1024); break;
+        }
+        if (json_writer_flush(w) != 0) break;
+    } while (c.written < target_bytes);
+    if (shape == CORPUS_WIDE) {
+        json_writer_end_object(w);
+    } else {
+        json_writer_end_array(w);
+    }
+    
+    if (shape == CORPUS_NESTED) json_writer_end_object(w);
+    
+    int status = json_writer_flush(w);
+    json_writer_free(w);
+    free(scratch);
+    return status == 0 ? c.written : 0;
+}
+
+char* corpus_generate(int shape, uint64_t seed, size_t target_bytes, int format, size_t *length) {
+    char *data = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&data, &size);
+    if (!out) return NULL;
+    
+    size_t written = corpus_write(out, shape, seed, target_bytes, format);
+    if (fclose(out) != 0 || written == 0) {
+        free(data);
+        return NULL;
+    }
+    
+    *length = size;
+    return data;
+}
+
+static const char *shape_names[CORPUS_SHAPE_COUNT] = {
+    "records", "numbers", "nested", "strings", "ndjson", "wide", "logs", "unicode"
+};
+
+const char* corpus_shape_name(int shape) {
+    return shape >= 0 && shape < CORPUS_SHAPE_COUNT ? shape_names[shape] : "unknown";
+}
+
+int corpus_shape_from_name(const char *name) {
+    for (int i = 0; i < CORPUS_SHAPE_COUNT; i++) {
+        if (strcmp(name, shape_names[i]) == 0) return i;
+    }
+    return -1;
+}
@@ -0,0 +1,34 @@
+// tests/corpus.h
+// Deterministic synthetic JSON documents for benchmarks
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+
+// Document shapes
+#define CORPUS_RECORDS 0   // Array of Twitter-like status records
+#define CORPUS_NUMBERS 1   // Flat array of integers and doubles
+#define CORPUS_NESTED  2   // Configuration object with deep nesting
+#define CORPUS_STRINGS 3   // Array of long, mostly plain strings
+#define CORPUS_NDJSON  4   // One record per line
+#define CORPUS_WIDE    5   // Single object with very many members
+#define CORPUS_LOGS    6   // Array of log events with long messages
+#define CORPUS_UNICODE 7   // Strings dense in UTF-8 and escape sequences
+#define CORPUS_SHAPE_COUNT 8
+
+// Write a document of the given shape to out. Output stops at the first
+// element boundary at or past target_bytes, so sizes are approximate but
+// the same seed always produces the same bytes. format is
+// JSON_PRINT_COMPACT or JSON_PRINT_PRETTY (NDJSON is always compact).
+// Returns the number of bytes written, or 0 on a write error.
+size_t corpus_write(FILE *out, int shape, uint64_t seed, size_t target_bytes, int format);
+
+// Generate into a heap buffer; *length receives the size. NULL on failure.
+char* corpus_generate(int shape, uint64_t seed, size_t target_bytes, int format, size_t *length);
+
+const char* corpus_shape_name(int shape);
+int corpus_shape_from_name(const char *name);  // -1 if unknown
+
+#endif
@@ -0,0 +1,78 @@
+// tests/gen_corpus.c
+// Writes a deterministic synthetic JSON document of a given shape and size
+#define _POSIX_C_SOURCE 200809L
+#include "../include/json.h"
+#include "corpus.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s SHAPE SIZE [--seed N] [--pretty] [-o FILE]\n\n", program);
+    fprintf(stderr, "SIZE takes an optional K, M or G suffix (powers of 1024).\n");
+    fprintf(stderr, "Shapes:");
+    for (int i = 0; i < CORPUS_SHAPE_COUNT; i++) fprintf(stderr, " %s", corpus_shape_name(i));
+    fprintf(stderr, "\n\nExample:\n  %s records 64M --seed 7 -o records.json\n", program);
+}
+
+// "64K", "10M", "2G" or a plain byte count; 0 on error
+static size_t parse_size(const char *text) {
+    char *end;
+    unsigned long long value = strtoull(text, &end, 10);
+    
+    if (end == text) return 0;
+    switch (*end) {
+        case 'k': case 'K': value <<= 10; end++; break;
+        case 'm': case 'M': value <<= 20; end++; break;
+        case 'g': case 'G': value <<= 30; end++; break;
+    }
+    if (*end == 'B' || *end == 'b') end++;
+    return *end == '\0' ? (size_t)value : 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *output = NULL;
+    unsigned long long seed = 42;
+    int format = JSON_PRINT_COMPACT;
+    
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    
+    int shape = corpus_shape_from_name(argv[1]);
+    size_t size = parse_size(argv[2]);
+    if (shape < 0 || size == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--pretty") == 0) {
+            format = JSON_PRINT_PRETTY;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Cannot create %s\n", output);
+        return 1;
+    }
+    
+    size_t written = corpus_write(out, shape, seed, size, format);
+    if (fclose(out) != 0) written = 0;
+    if (written == 0) {
+        fprintf(stderr, "Failed to write %s\n", output ? output : "output");
+        return 1;
+    }
+    
+    if (output) fprintf(stderr, "%s: %zu bytes\n", output, written);
+    return 0;
+}
@@ -0,0 +1,339 @@
+// tests/microbench.c
+// Microbenchmarks for the parser's internal primitives. The library
+// source is included directly so the static stages can be timed in
+// isolation, each over a prepared input with warm-up and repeated
+// samples summarised as min/median/p99. Times are read with rdtsc where
+// available (reference cycles) and clock_gettime otherwise.
+#include "../src/json.c"
+#include "corpus.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TICK_UNIT "cycles"
+static uint64_t ticks(void) {
+    return __rdtsc();
+}
+#else
+#define TICK_UNIT "ns"
+static uint64_t ticks(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#define WARMUP_RUNS   20
+#define SAMPLE_RUNS   200
+#define BATCH         1024     // Items per run for the per-token primitives
+#define SPAN_SIZE     (64 * 1024)
+#define OBJECT_KEYS   64
+#define ARRAY_ITEMS   1000
+#define DELETE_SIZE   (256 * 1024)
+
+typedef struct {
+    const char *name;
+    void (*setup)(void);       // Untimed, before every sample
+    void (*run)(void);         // The timed operation
+    void (*teardown)(void);    // Untimed, after every sample
+    size_t *bytes;             // Input bytes per run, 0 for lookups
+    size_t ops;                // Operations per run
+} microbench_t;
+
+// Prepared inputs
+static char *long_space;
+static char *short_space;
+static char *plain_strings;
+static char *escaped_strings;
+static char *numbers;
+static char *literals;
+static size_t long_space_len, short_space_len, plain_strings_len, escaped_strings_len;
+static size_t numbers_len, literals_len, delete_len;
+
+static json_t *object;
+static char object_keys[OBJECT_KEYS][16];
+static json_t *array;
+static char *delete_text;
+static json_t *delete_root;
+static json_t *batch_nodes[BATCH];
+static size_t parse_failures;
+
+// Keeps results observable so the compiler cannot drop the work
+static volatile size_t sink;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Build a comma-separated list of BATCH tokens from a generator
+static char* build_list(void (*token)(char *out, size_t cap), size_t *length) {
+    size_t capacity = BATCH * 96;
+    char *text = malloc(capacity);
+    size_t len = 0;
+    
+    for (int i = 0; i < BATCH; i++) {
+        token(text + len, capacity - len);
+        len += strlen(text + len);
+        text[len++] = ',';
+    }
+    text[len] = '\0';
+    *length = len;
+    return text;
+}
+
+static void plain_string_token(char *out, size_t cap) {
+    static const char *words[] = { "alpha", "beta", "gamma", "delta", "status", "value", "name" };
+    size_t len = 0;
+    
+    out[len++] = '"';
+    for (int i = 1 + (int)(next_random() % 6); i > 0 && len + 12 < cap; i--) {
+        const char *word = words[next_random() % 7];
+        memcpy(out + len, word, strlen(word));
+        len += strlen(word);
+        if (i > 1) out[len++] = ' ';
+    }
+    out[len++] = '"';
+    out[len] = '\0';
+}
+
+static void escaped_string_token(char *out, size_t cap) {
+    static const char *parts[] = { "text", "\\n", "\\\"", "\\u00e9", "\\ud83d\\ude00", "\\\\", "caf\xc3\xa9" };
+    size_t len = 0;
+    
+    out[len++] = '"';
+    for (int i = 2 + (int)(next_random() % 6); i > 0 && len + 16 < cap; i--) {
+        const char *part = parts[next_random() % 7];
+        memcpy(out + len, part, strlen(part));
+        len += strlen(part);
+    }
+    out[len++] = '"';
+    out[len] = '\0';
+}
+
+static void number_token(char *out, size_t cap) {
+    switch (next_random() % 4) {
+        case 0:  snprintf(out, cap, "%u", (unsigned)(next_random() % 100000)); break;
+        case 1:  snprintf(out, cap, "-%llu", (unsigned long long)(next_random() >> 12)); break;
+        case 2:  snprintf(out, cap, "%u.%02u", (unsigned)(next_random() % 10000),
+                          (unsigned)(next_random() % 100)); break;
+        default: snprintf(out, cap, "%.17g", (double)(next_random() >> 11) * 1e-9); break;
+    }
+}
+
+static void literal_token(char *out, size_t cap) {
+    static const char *names[] = { "true", "false", "null" };
+    snprintf(out, cap, "%s", names[next_random() % 3]);
+}
+
+static void prepare_inputs(void) {
+    long_space_len = SPAN_SIZE;
+    long_space = malloc(long_space_len + 1);
+    for (size_t i = 0; i < long_space_len; i++) long_space[i] = " \t\n\r"[next_random() % 4];
+    long_space[long_space_len] = 'x';
+    
+    // Pretty-printed layout: a newline and indentation before each token
+    short_space = malloc(SPAN_SIZE + 64);
+    short_space_len = 0;
+    while (short_space_len < SPAN_SIZE) {
+        short_space[short_space_len++] = '\n';
+        for (int i = (int)(next_random() % 8) * 2; i > 0; i--) short_space[short_space_len++] = ' ';
+        short_space[short_space_len++] = 'x';
+    }
+    
+    plain_strings = build_list(plain_string_token, &plain_strings_len);
+    escaped_strings = build_list(escaped_string_token, &escaped_strings_len);
+    numbers = build_list(number_token, &numbers_len);
+    literals = build_list(literal_token, &literals_len);
+    
+    char text[OBJECT_KEYS * 32];
+    size_t len = 0;
+    text[len++] = '{';
+    for (int i = 0; i < OBJECT_KEYS; i++) {
+        snprintf(object_keys[i], sizeof(object_keys[i]), "key_%03d", i);
+        len += (size_t)snprintf(text + len, sizeof(text) - len, "%s\"%s\":%d",
+                                i ? "," : "", object_keys[i], i);
+    }
+    text[len++] = '}';
+    object = json_parse_length(text, len);
+    
+    char *items = malloc(ARRAY_ITEMS * 8 + 2);
+    len = 0;
+    items[len++] = '[';
+    for (int i = 0; i < ARRAY_ITEMS; i++) {
+        len += (size_t)sprintf(items + len, "%s%d", i ? "," : "", i);
+    }
+    items[len++] = ']';
+    array = json_parse_length(items, len);
+    free(items);
+    
+    delete_text = corpus_generate(CORPUS_RECORDS, 42, DELETE_SIZE, JSON_PRINT_COMPACT, &delete_len);
+}
+
+static void run_skip_long(void) {
+    parse_context_t ctx = { .json = long_space, .length = long_space_len + 1, .alloc = &global_allocator };
+    skip_whitespace(&ctx);
+    sink = ctx.pos;
+}
+
+static void run_skip_short(void) {
+    parse_context_t ctx = { .json = short_space, .length = short_space_len, .alloc = &global_allocator };
+    while (ctx.pos < ctx.length) {
+        skip_whitespace(&ctx);
+        ctx.pos++;  // The token
+    }
+    sink = ctx.pos;
+}
+
+// Parse BATCH comma-separated tokens with one primitive
+static void run_tokens(json_t* (*parse)(parse_context_t *), const char *text, size_t length) {
+    parse_context_t ctx = { .json = text, .length = length, .alloc = &global_allocator };
+    for (int i = 0; i < BATCH; i++) {
+        batch_nodes[i] = parse(&ctx);
+        ctx.pos++;  // Comma
+    }
+    sink = ctx.pos;
+}
+
+static void run_plain_strings(void) {
+    run_tokens(parse_string, plain_strings, plain_strings_len);
+}
+
+static void run_escaped_strings(void) {
+    run_tokens(parse_string, escaped_strings, escaped_strings_len);
+}
+
+static void run_numbers(void) {
+    run_tokens(parse_number, numbers, numbers_len);
+}
+
+static void run_literals(void) {
+    run_tokens(parse_literal, literals, literals_len);
+}
+
+static void free_batch(void) {
+    for (int i = 0; i < BATCH; i++) {
+        parse_failures += batch_nodes[i] == NULL;
+        json_delete(batch_nodes[i]);
+        batch_nodes[i] = NULL;
+    }
+}
+
+static void run_object_get(void) {
+    size_t found = 0;
+    for (int i = 0; i < OBJECT_KEYS; i++) {
+        found += json_object_get(object, object_keys[i]) != NULL;
+    }
+    sink = found;
+}
+
+static void run_array_get(void) {
+    size_t found = 0;
+    for (int i = 0; i < ARRAY_ITEMS; i++) {
+        found += json_array_get(array, (i * 7919) % ARRAY_ITEMS) != NULL;
+    }
+    sink = found;
+}
+
+static void parse_delete_tree(void) {
+    delete_root = json_parse_length(delete_text, delete_len);
+}
+
+static void run_delete(void) {
+    json_delete(delete_root);
+    delete_root = NULL;
+}
+
+static size_t no_bytes = 0;
+
+static const microbench_t benches[] = {
+    { "skip_whitespace/run",    NULL, run_skip_long,       NULL,       &long_space_len,      1 },
+    { "skip_whitespace/indent", NULL, run_skip_short,      NULL,       &short_space_len,     1 },
+    { "parse_string/plain",     NULL, run_plain_strings,   free_batch, &plain_strings_len,   BATCH },
+    { "parse_string/escaped",   NULL, run_escaped_strings, free_batch, &escaped_strings_len, BATCH },
+    { "parse_number",           NULL, run_numbers,         free_batch, &numbers_len,         BATCH },
+    { "parse_literal",          NULL, run_literals,        free_batch, &literals_len,        BATCH },
+    { "json_object_get",        NULL, run_object_get,      NULL,       &no_bytes,            OBJECT_KEYS },
+    { "json_array_get",         NULL, run_array_get,       NULL,       &no_bytes,            ARRAY_ITEMS },
+    { "json_delete",            parse_delete_tree, run_delete, NULL,   &delete_len,          1 },
+};
+#define BENCH_COUNT (sizeof(benches) / sizeof(benches[0]))
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+    const char *filter = argc > 1 ? argv[1] : NULL;
+    uint64_t samples[SAMPLE_RUNS];
+    
+    prepare_inputs();
+    if (!object || !array || !delete_text) {
+        fprintf(stderr, "Failed to prepare inputs\n");
+        return 1;
+    }
+    
+    // Calibrate ticks against wall time so every row can show ns/op
+    uint64_t ns_start = now_ns();
+    uint64_t tick_start = ticks();
+    while (now_ns() - ns_start < 50000000) {}
+    double ticks_per_ns = (double)(ticks() - tick_start) / (double)(now_ns() - ns_start);
+    
+    printf("%-24s %9s %12s %12s %12s %12s %10s\n", "primitive", "bytes", "min", "median",
+           "p99", TICK_UNIT "/byte", "ns/op");
+    
+    for (size_t b = 0; b < BENCH_COUNT; b++) {
+        const microbench_t *mb = &benches[b];
+        if (filter && !strstr(mb->name, filter)) continue;
+        
+        for (int i = 0; i < WARMUP_RUNS + SAMPLE_RUNS; i++) {
+            if (mb->setup) mb->setup();
+            uint64_t start = ticks();
+            mb->run();
+            uint64_t elapsed = ticks() - start;
+            if (mb->teardown) mb->teardown();
+            if (i >= WARMUP_RUNS) samples[i - WARMUP_RUNS] = elapsed;
+        }
+        
+        qsort(samples, SAMPLE_RUNS, sizeof(uint64_t), compare_u64);
+        
+        uint64_t median = samples[SAMPLE_RUNS / 2];
+        size_t bytes = *mb->bytes;
+        char per_byte[32] = "-";
+        if (bytes) snprintf(per_byte, sizeof(per_byte), "%.3f", (double)median / bytes);
+        
+        printf("%-24s %9zu %12llu %12llu %12llu %12s %10.1f\n", mb->name, bytes,
+               (unsigned long long)samples[0], (unsigned long long)median,
+               (unsigned long long)samples[SAMPLE_RUNS * 99 / 100], per_byte,
+               (double)median / ticks_per_ns / (double)mb->ops);
+    }
+    
+    if (parse_failures) {
+        fprintf(stderr, "%zu tokens failed to parse; results are not meaningful\n", parse_failures);
+    }
+    
+    json_delete(object);
+    json_delete(array);
+    free(delete_text);
+    free(long_space);
+    free(short_space);
+    free(plain_strings);
+    free(escaped_strings);
+    free(numbers);
+    free(literals);
+    return parse_failures != 0;
+}
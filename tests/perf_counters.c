@@ -0,0 +1,161 @@
+// tests/perf_counters.c
+#define _GNU_SOURCE
+#include "perf_counters.h"
+#include <string.h>
+#include <errno.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char *names[PERF_COUNTER_COUNT] = {
+    "cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses", "dTLB-misses"
+};
+
+static int open_errno;
+
+const char* perf_counter_name(int counter) {
+    return counter >= 0 && counter < PERF_COUNTER_COUNT ? names[counter] : "unknown";
+}
+
+#if defined(__linux__) && defined(SYS_perf_event_open)
+
+static unsigned long long cache_miss(unsigned long long cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+static int open_counter(int counter) {
+    struct perf_event_attr attr;
+    
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    
+    switch (counter) {
+        case PERF_CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PERF_INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PERF_BRANCH_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case PERF_L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cache_miss(PERF_COUNT_HW_CACHE_L1D);
+            break;
+        case PERF_LLC_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cache_miss(PERF_COUNT_HW_CACHE_LL);
+            break;
+        case PERF_DTLB_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cache_miss(PERF_COUNT_HW_CACHE_DTLB);
+            break;
+    }
+    
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+int perf_counters_open(perf_counters_t *p, unsigned mask) {
+    p->open_count = 0;
+    open_errno = 0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        p->fds[i] = -1;
+        if (!(mask & PERF_MASK(i))) continue;
+        p->fds[i] = open_counter(i);
+        if (p->fds[i] >= 0) {
+            p->open_count++;
+        } else if (!open_errno) {
+            open_errno = errno;
+        }
+    }
+    return p->open_count;
+}
+
+void perf_counters_close(perf_counters_t *p) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (p->fds[i] >= 0) close(p->fds[i]);
+        p->fds[i] = -1;
+    }
+    p->open_count = 0;
+}
+
+void perf_counters_start(perf_counters_t *p) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (p->fds[i] < 0) continue;
+        ioctl(p->fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(p->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void perf_counters_stop(perf_counters_t *p, uint64_t *values) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (p->fds[i] >= 0) ioctl(p->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        uint64_t data[3];  // value, time enabled, time running
+        
+        values[i] = PERF_UNAVAILABLE;
+        if (p->fds[i] < 0 || read(p->fds[i], data, sizeof(data)) != sizeof(data)) continue;
+        if (data[2] == 0) {
+            values[i] = 0;  // Never scheduled: the region was too short to sample
+        } else if (data[2] < data[1]) {
+            values[i] = (uint64_t)((double)data[0] * data[1] / data[2]);
+        } else {
+            values[i] = data[0];
+        }
+    }
+}
+
+const char* perf_counters_error(const perf_counters_t *p) {
+    if (p->open_count > 0) return NULL;
+    switch (open_errno) {
+        case ENOENT:
+        case EOPNOTSUPP: return "no hardware counters (virtual machine or unsupported CPU)";
+        case EACCES:
+        case EPERM:      return "not permitted (see /proc/sys/kernel/perf_event_paranoid)";
+        case ENOSYS:     return "perf_event_open is not supported by this kernel";
+        default:         return strerror(open_errno);
+    }
+}
+
+#else
+
+int perf_counters_open(perf_counters_t *p, unsigned mask) {
+    (void)mask;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) p->fds[i] = -1;
+    p->open_count = 0;
+    return 0;
+}
+
+void perf_counters_close(perf_counters_t *p) {
+    p->open_count = 0;
+}
+
+void perf_counters_start(perf_counters_t *p) {
+    (void)p;
+}
+
+void perf_counters_stop(perf_counters_t *p, uint64_t *values) {
+    (void)p;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) values[i] = PERF_UNAVAILABLE;
+}
+
+const char* perf_counters_error(const perf_counters_t *p) {
+    (void)p;
+    (void)open_errno;
+    return "performance counters need Linux";
+}
+
+#endif
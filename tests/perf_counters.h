@@ -0,0 +1,51 @@
+// tests/perf_counters.h
+// Linux hardware performance counters for the benchmarks
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+
+// Counters, in report order
+#define PERF_CYCLES        0
+#define PERF_INSTRUCTIONS  1
+#define PERF_BRANCH_MISSES 2
+#define PERF_L1D_MISSES    3
+#define PERF_LLC_MISSES    4
+#define PERF_DTLB_MISSES   5
+#define PERF_COUNTER_COUNT 6
+
+// Masks selecting counters to open
+#define PERF_MASK(counter) (1u << (counter))
+#define PERF_ALL           (PERF_MASK(PERF_COUNTER_COUNT) - 1)
+
+// Value reported for a counter that could not be opened
+#define PERF_UNAVAILABLE UINT64_MAX
+
+// One file descriptor per counter, counting user space of this thread
+// only. Counters the kernel or CPU cannot provide (no PMU in a VM,
+// perf_event_paranoid, non-Linux) stay closed with fd -1.
+typedef struct {
+    int fds[PERF_COUNTER_COUNT];
+    int open_count;
+} perf_counters_t;
+
+// Open what is available of the counters in mask. Returns the number
+// opened; 0 is not an error for callers, which should report counters as
+// unavailable. Open only what is needed when exact counts matter: more
+// counters than the PMU has are multiplexed and scaled estimates.
+int perf_counters_open(perf_counters_t *p, unsigned mask);
+void perf_counters_close(perf_counters_t *p);
+
+// Zero and start every open counter
+void perf_counters_start(perf_counters_t *p);
+
+// Stop and read into values[PERF_COUNTER_COUNT]; closed counters read as
+// PERF_UNAVAILABLE. Counts are scaled up if the kernel had to multiplex.
+void perf_counters_stop(perf_counters_t *p, uint64_t *values);
+
+const char* perf_counter_name(int counter);
+
+// Why nothing opened, for a one-line diagnostic; NULL if something did
+const char* perf_counters_error(const perf_counters_t *p);
+
+#endif
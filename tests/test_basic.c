@@ -1,6 +1,8 @@
 // tests/test_basic.c
 #include "unity/unity.h"
 #include "../include/json.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 // Unity setup/teardown
@@ -101,6 +103,213 @@ void test_parse_invalid_json(void) {
     TEST_ASSERT_NULL(result);
 }
 
+// The parser rejects exactly what json_validate rejects
+void test_parse_strict_grammar(void) {
+    const char *invalid[] = {
+        "01", "-01", "00.5", "1 2", "{} []", "true false", "1\v", "\f1",
+        "\"\xff\"", "\"\xc0\xaf\"", "\"\xed\xa0\x80\"", "\"\xe2\x82\"", "[\"\xf4\x90\x80\x80\"]"
+    };
+    const char *valid[] = {
+        "0", "-0", "0.5", " [1, 2] \n", "\"\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\"",
+        "{\"k\xc3\xa9y\": \"the quick brown fox jumps over \xe2\x82\xac\"}"
+    };
+    
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        TEST_ASSERT_FALSE_MESSAGE(json_validate(invalid[i], strlen(invalid[i])), invalid[i]);
+        TEST_ASSERT_NULL_MESSAGE(json_parse(invalid[i]), invalid[i]);
+    }
+    for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++) {
+        json_t *result = json_parse(valid[i]);
+        TEST_ASSERT_TRUE_MESSAGE(json_validate(valid[i], strlen(valid[i])), valid[i]);
+        TEST_ASSERT_NOT_NULL_MESSAGE(result, valid[i]);
+        json_delete(result);
+    }
+}
+
+// Nesting is bounded at JSON_MAX_DEPTH, as in json_validate, so deep
+// input fails instead of overflowing the stack
+void test_parse_depth(void) {
+    static char deep[2 * 100000 + 1];
+    
+    for (size_t depth = JSON_MAX_DEPTH; depth <= JSON_MAX_DEPTH + 1; depth++) {
+        memset(deep, '[', depth);
+        memset(deep + depth, ']', depth);
+        json_t *result = json_parse_length(deep, 2 * depth);
+        TEST_ASSERT_EQUAL(depth <= JSON_MAX_DEPTH, result != NULL);
+        TEST_ASSERT_EQUAL(depth <= JSON_MAX_DEPTH, json_validate(deep, 2 * depth));
+        json_delete(result);
+    }
+    
+    // Objects count too, and depth far past the limit only costs the scan
+    // up to it
+    char *objects = malloc(5 * (JSON_MAX_DEPTH + 1) + JSON_MAX_DEPTH + 2);
+    size_t len = 0;
+    for (int i = 0; i <= JSON_MAX_DEPTH; i++) len += (size_t)sprintf(objects + len, "{\"k\":");
+    objects[len++] = '1';
+    for (int i = 0; i <= JSON_MAX_DEPTH; i++) objects[len++] = '}';
+    TEST_ASSERT_NULL(json_parse_length(objects, len));
+    json_t *result = json_parse_length(objects + 5, len - 6);  // One level less
+    TEST_ASSERT_NOT_NULL(result);
+    json_delete(result);
+    free(objects);
+    
+    memset(deep, '[', 100000);
+    memset(deep + 100000, ']', 100000);
+    TEST_ASSERT_NULL(json_parse_length(deep, sizeof(deep) - 1));
+}
+
+// Test length-delimited parsing of text that is not NUL-terminated
+void test_parse_length(void) {
+    const char text[] = { '[', '1', ',', '2', ']', 't', 'r', 'u' };
+    
+    json_t *result = json_parse_length(text, 5);
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL(JSON_ARRAY, result->type);
+    json_delete(result);
+    
+    // A literal cut off by the length must not be read past the end
+    TEST_ASSERT_NULL(json_parse_length(&text[5], 3));
+    TEST_ASSERT_NULL(json_parse_length(text, 4));
+}
+
+// Allocator that counts calls and live blocks, and can fail on demand
+typedef struct {
+    int calls;
+    int live;
+    int fail_after;  // Calls that succeed before failing; -1 never fails
+} counting_t;
+
+static void* counting_malloc(void *ctx, size_t size) {
+    counting_t *c = ctx;
+    if (c->fail_after >= 0 && c->calls >= c->fail_after) return NULL;
+    c->calls++;
+    c->live++;
+    return malloc(size);
+}
+
+static void* counting_realloc(void *ctx, void *ptr, size_t size) {
+    counting_t *c = ctx;
+    if (c->fail_after >= 0 && c->calls >= c->fail_after) return NULL;
+    c->calls++;
+    if (!ptr) c->live++;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void *ctx, void *ptr) {
+    counting_t *c = ctx;
+    c->live--;
+    free(ptr);
+}
+
+static const char allocator_text[] =
+    "{\"name\": \"caf\\u00e9\", \"list\": [1, true, null],"
+    " \"long\": 1.0000000000000000000000000000000000000000000000000000000000000000001}";
+
+// Parsing and deleting with a per-call allocator
+void test_parse_with_allocator(void) {
+    counting_t counts = { 0, 0, -1 };
+    json_allocator_t allocator = { counting_malloc, counting_realloc, counting_free, &counts };
+    json_parse_options_t options = { &allocator, NULL, 0 };
+    
+    json_t *result = json_parse_ex(allocator_text, strlen(allocator_text), &options);
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_STRING("caf\xc3\xa9", json_object_get(result, "name")->valuestring);
+    TEST_ASSERT_TRUE(counts.calls > 0);
+    
+    json_delete_ex(result, &allocator);
+    TEST_ASSERT_EQUAL(0, counts.live);
+}
+
+// Every allocation failure returns NULL without leaking
+void test_allocator_failure(void) {
+    counting_t counts = { 0, 0, -1 };
+    json_allocator_t allocator = { counting_malloc, counting_realloc, counting_free, &counts };
+    json_parse_options_t options = { &allocator, NULL, 0 };
+    
+    json_delete_ex(json_parse_ex(allocator_text, strlen(allocator_text), &options), &allocator);
+    int needed = counts.calls;
+    
+    for (int limit = 0; limit < needed; limit++) {
+        counts.calls = 0;
+        counts.live = 0;
+        counts.fail_after = limit;
+        TEST_ASSERT_NULL(json_parse_ex(allocator_text, strlen(allocator_text), &options));
+        TEST_ASSERT_EQUAL(0, counts.live);
+    }
+}
+
+// The global allocator covers parsing, printing and the writer
+void test_global_allocator(void) {
+    counting_t counts = { 0, 0, -1 };
+    json_allocator_t allocator = { counting_malloc, counting_realloc, counting_free, &counts };
+    
+    json_set_allocator(&allocator);
+    json_t *result = json_parse(allocator_text);
+    char *text = json_print_compact(result);
+    json_writer_t *w = json_writer_new_fd(-1, 64, JSON_PRINT_COMPACT);
+    json_set_allocator(NULL);
+    
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_NOT_NULL(text);
+    TEST_ASSERT_NOT_NULL(w);
+    int calls = counts.calls;
+    TEST_ASSERT_TRUE(counts.live >= 3);
+    
+    // Restoring the default stops routing through the hooks
+    json_delete(json_parse("[1]"));
+    TEST_ASSERT_EQUAL(calls, counts.calls);
+    
+    // Releasing goes back through the same allocator
+    json_set_allocator(&allocator);
+    json_free(text);
+    json_writer_free(w);
+    json_delete(result);
+    json_set_allocator(NULL);
+    TEST_ASSERT_EQUAL(0, counts.live);
+}
+
+// Parse statistics describe the tree and match the allocator's view
+void test_parse_stats(void) {
+    const char *text = "{\"a\": [1, 2.5, true, null, \"x\\u00e9\"], \"b\": {\"c\": false}}";
+    counting_t counts = { 0, 0, -1 };
+    json_allocator_t allocator = { counting_malloc, counting_realloc, counting_free, &counts };
+    json_parse_stats_t stats = { 0 };
+    json_parse_options_t options = { &allocator, &stats, 0 };
+    
+    stats.timing = 1;
+    json_t *result = json_parse_ex(text, strlen(text), &options);
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL(2, stats.objects);
+    TEST_ASSERT_EQUAL(1, stats.arrays);
+    TEST_ASSERT_EQUAL(1, stats.strings);
+    TEST_ASSERT_EQUAL(2, stats.numbers);
+    TEST_ASSERT_EQUAL(2, stats.booleans);
+    TEST_ASSERT_EQUAL(1, stats.nulls);
+    TEST_ASSERT_EQUAL(3, stats.keys);
+    TEST_ASSERT_EQUAL(6, stats.string_bytes);  // "x\xc3\xa9" plus a, b, c
+    TEST_ASSERT_EQUAL(2, stats.max_depth);
+    TEST_ASSERT_EQUAL(counts.calls, stats.allocations);
+    TEST_ASSERT_TRUE(stats.allocated_bytes > 0);
+    TEST_ASSERT_TRUE(stats.total_ns >= stats.string_ns + stats.number_ns);
+    
+    // Trees parsed with stats are freed with the caller's allocator
+    json_delete_ex(result, &allocator);
+    TEST_ASSERT_EQUAL(0, counts.live);
+    
+    // A failed parse reports its allocations but no tree
+    stats.timing = 0;
+    TEST_ASSERT_NULL(json_parse_ex("[1, 2", 5, &options));
+    TEST_ASSERT_EQUAL(0, stats.numbers);
+    TEST_ASSERT_EQUAL(0, stats.max_depth);
+    TEST_ASSERT_EQUAL(3, stats.allocations);
+    TEST_ASSERT_EQUAL(0, stats.total_ns);
+    
+    TEST_ASSERT_NOT_NULL(result = json_parse_ex("7", 1, &options));
+    TEST_ASSERT_EQUAL(1, stats.numbers);
+    TEST_ASSERT_EQUAL(0, stats.max_depth);
+    json_delete_ex(result, &allocator);
+}
+
 // Main test runner
 int main(void) {
     UNITY_BEGIN();
@@ -132,6 +341,16 @@ int main(void) {
     RUN_TEST(test_parse_empty_string);
     RUN_TEST(test_parse_null_input);
     RUN_TEST(test_parse_invalid_json);
+    RUN_TEST(test_parse_strict_grammar);
+    RUN_TEST(test_parse_depth);
+    RUN_TEST(test_parse_length);
+    
+    // Allocator tests
+    printf("Running allocator tests...\n");
+    RUN_TEST(test_parse_with_allocator);
+    RUN_TEST(test_allocator_failure);
+    RUN_TEST(test_global_allocator);
+    RUN_TEST(test_parse_stats);
     
     return UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,203 @@
+// tests/test_binary.c
+#define _POSIX_C_SOURCE 200809L
+#include "unity/unity.h"
+#include "../include/json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Saved images, kept 8-byte aligned as json_load_binary requires
+static uint64_t image_words[4096];
+static unsigned char *image = (unsigned char *)image_words;
+static size_t image_len;
+
+static int collect(void *ctx, const char *data, size_t len) {
+    (void)ctx;
+    if (image_len + len > sizeof(image_words)) return -1;
+    memcpy(&image[image_len], data, len);
+    image_len += len;
+    return 0;
+}
+
+static const char document[] =
+    "{\"name\": \"caf\\u00e9\", \"ok\": true, \"none\": null, \"off\": false,"
+    " \"scores\": [1, -2.5, 1e300], \"mixed\": [\"a\", 2, {\"name\": \"inner\"}],"
+    " \"empty\": {}, \"list\": []}";
+
+// Parse text and save it into image
+static void save(const char *text) {
+    json_t *json = json_parse(text);
+    TEST_ASSERT_NOT_NULL(json);
+    image_len = 0;
+    TEST_ASSERT_EQUAL_INT(0, json_save_binary(json, collect, NULL));
+    json_delete(json);
+}
+
+void setUp(void) {
+    image_len = 0;
+}
+
+void tearDown(void) {}
+
+// Every value type reads back from the image
+void test_binary_round_trip(void) {
+    json_view_t root, value, element;
+    size_t length;
+    
+    save(document);
+    TEST_ASSERT_EQUAL_INT(0, json_load_binary(image, image_len, &root));
+    TEST_ASSERT_EQUAL(JSON_OBJECT, root.type);
+    TEST_ASSERT_EQUAL(8, json_view_size(&root));
+    
+    TEST_ASSERT_EQUAL_INT(0, json_view_object_get(&root, "name", &value));
+    TEST_ASSERT_EQUAL_STRING("caf\xc3\xa9", json_view_string(&value, &length));
+    TEST_ASSERT_EQUAL(5, length);
+    
+    TEST_ASSERT_EQUAL_INT(0, json_view_object_get(&root, "ok", &value));
+    TEST_ASSERT_EQUAL(JSON_TRUE, value.type);
+    TEST_ASSERT_EQUAL_INT(0, json_view_object_get(&root, "off", &value));
+    TEST_ASSERT_EQUAL(JSON_FALSE, value.type);
+    TEST_ASSERT_EQUAL_INT(0, json_view_object_get(&root, "none", &value));
+    TEST_ASSERT_EQUAL(JSON_NULL, value.type);
+    
+    TEST_ASSERT_EQUAL_INT(0, json_view_object_get(&root, "mixed", &value));
+    TEST_ASSERT_EQUAL(3, json_view_size(&value));
+    TEST_ASSERT_EQUAL_INT(0, json_view_array_get(&value, 1, &element));
+    TEST_ASSERT_EQUAL_DOUBLE(2, json_view_number(&element));
+    TEST_ASSERT_EQUAL_INT(0, json_view_array_get(&value, 2, &element));
+    TEST_ASSERT_EQUAL_INT(0, json_view_object_get(&element, "name", &element));
+    TEST_ASSERT_EQUAL_STRING("inner", json_view_string(&element, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, json_view_array_get(&value, 3, &element));
+    
+    TEST_ASSERT_EQUAL_INT(0, json_view_object_get(&root, "empty", &value));
+    TEST_ASSERT_EQUAL(JSON_OBJECT, value.type);
+    TEST_ASSERT_EQUAL(0, json_view_size(&value));
+    TEST_ASSERT_EQUAL_INT(-1, json_view_object_get(&root, "missing", &value));
+    TEST_ASSERT_EQUAL_INT(-1, json_view_object_get(&root, "nam", &value));
+}
+
+// Arrays of numbers are packed and still read element by element
+void test_binary_typed_array(void) {
+    json_view_t root, scores, element;
+    
+    save(document);
+    json_load_binary(image, image_len, &root);
+    TEST_ASSERT_EQUAL_INT(0, json_view_object_get(&root, "scores", &scores));
+    TEST_ASSERT_EQUAL(3, json_view_size(&scores));
+    
+    TEST_ASSERT_EQUAL_INT(0, json_view_array_get(&scores, 1, &element));
+    TEST_ASSERT_EQUAL(JSON_NUMBER, element.type);
+    TEST_ASSERT_EQUAL_DOUBLE(-2.5, json_view_number(&element));
+    TEST_ASSERT_EQUAL_INT(0, json_view_array_get(&scores, 2, &element));
+    TEST_ASSERT_EQUAL_DOUBLE(1e300, json_view_number(&element));
+    TEST_ASSERT_EQUAL(0, json_view_size(&element));
+}
+
+// Members iterate in document order and repeated strings are stored once
+void test_binary_members_and_strings(void) {
+    json_view_t root, value;
+    const char *key;
+    
+    save("{\"b\": \"shared\", \"a\": \"shared\", \"shared\": 1}");
+    size_t shared_len = image_len;
+    json_load_binary(image, image_len, &root);
+    
+    TEST_ASSERT_EQUAL_INT(0, json_view_member(&root, 1, &key, &value));
+    TEST_ASSERT_EQUAL_STRING("a", key);
+    TEST_ASSERT_EQUAL_STRING("shared", json_view_string(&value, NULL));
+    TEST_ASSERT_EQUAL_INT(0, json_view_member(&root, 2, &key, &value));
+    TEST_ASSERT_EQUAL_STRING("shared", key);
+    TEST_ASSERT_EQUAL_INT(-1, json_view_member(&root, 3, &key, &value));
+    
+    save("{\"b\": \"shared\", \"a\": \"unique\", \"third\": 1}");
+    TEST_ASSERT_TRUE(image_len > shared_len);
+}
+
+// Scalars can be the root too
+void test_binary_scalar_root(void) {
+    json_view_t root;
+    
+    save("\"just text\"");
+    TEST_ASSERT_EQUAL_INT(0, json_load_binary(image, image_len, &root));
+    TEST_ASSERT_EQUAL_STRING("just text", json_view_string(&root, NULL));
+    TEST_ASSERT_NULL(json_view_string(&(json_view_t){ .type = JSON_NUMBER }, NULL));
+    
+    save("42");
+    TEST_ASSERT_EQUAL_INT(0, json_load_binary(image, image_len, &root));
+    TEST_ASSERT_EQUAL_DOUBLE(42, json_view_number(&root));
+}
+
+// Damaged images are refused or fail lookups; they are never read past
+void test_binary_rejects_damage(void) {
+    json_view_t root, value;
+    
+    save(document);
+    TEST_ASSERT_EQUAL_INT(-1, json_load_binary(image, image_len - 1, &root));
+    TEST_ASSERT_EQUAL_INT(-1, json_load_binary(image, 16, &root));
+    TEST_ASSERT_EQUAL_INT(-1, json_load_binary(image + 8, image_len - 8, &root));
+    
+    image[0] = 'X';
+    TEST_ASSERT_EQUAL_INT(-1, json_load_binary(image, image_len, &root));
+    image[0] = 'J';
+    
+    // Point the root's block past the end of the node area
+    save("[[1, 2], [3]]");
+    image[40] = 0xff;
+    image[41] = 0xff;
+    TEST_ASSERT_EQUAL_INT(-1, json_load_binary(image, image_len, &root));
+    
+    // Point an element's block past the node area: only that lookup fails
+    save("[[\"x\"], [\"y\"]]");
+    TEST_ASSERT_EQUAL_INT(0, json_load_binary(image, image_len, &root));
+    image[48 + 16 + 8] = 0xff;
+    TEST_ASSERT_EQUAL_INT(0, json_view_array_get(&root, 0, &value));
+    TEST_ASSERT_EQUAL_INT(-1, json_view_array_get(&root, 1, &value));
+}
+
+// An image on disk is used straight from mmap
+void test_binary_from_mmap(void) {
+    char path[] = "/tmp/test_binary_XXXXXX";
+    json_view_t root, value;
+    
+    save(document);
+    int fd = mkstemp(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    unlink(path);
+    TEST_ASSERT_EQUAL(image_len, (size_t)write(fd, image, image_len));
+    
+    void *map = mmap(NULL, image_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    TEST_ASSERT_TRUE(map != MAP_FAILED);
+    TEST_ASSERT_EQUAL_INT(0, json_load_binary(map, image_len, &root));
+    TEST_ASSERT_EQUAL_INT(0, json_view_object_get(&root, "mixed", &value));
+    TEST_ASSERT_EQUAL_INT(0, json_view_array_get(&value, 0, &value));
+    TEST_ASSERT_EQUAL_STRING("a", json_view_string(&value, NULL));
+    
+    munmap(map, image_len);
+    close(fd);
+}
+
+// Sink failures are reported
+void test_binary_sink_error(void) {
+    json_t *json = json_parse(document);
+    image_len = sizeof(image_words) - 8;
+    TEST_ASSERT_EQUAL_INT(-1, json_save_binary(json, collect, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, json_save_binary(NULL, collect, NULL));
+    json_delete(json);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_binary_round_trip);
+    RUN_TEST(test_binary_typed_array);
+    RUN_TEST(test_binary_members_and_strings);
+    RUN_TEST(test_binary_scalar_root);
+    RUN_TEST(test_binary_rejects_damage);
+    RUN_TEST(test_binary_from_mmap);
+    RUN_TEST(test_binary_sink_error);
+    
+    return UNITY_END();
+}
@@ -0,0 +1,324 @@
+// tests/test_document.c
+#include "unity/unity.h"
+#include "../include/json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The current text, edited in place the way an editor buffer would be
+static char text[262144];
+static size_t text_len;
+
+void setUp(void) {
+    text_len = 0;
+}
+
+void tearDown(void) {}
+
+static json_document_t* open_text(const char *initial) {
+    text_len = strlen(initial);
+    memcpy(text, initial, text_len + 1);
+    return json_document_parse(text, text_len);
+}
+
+// Replace old_len bytes at start and re-parse
+static int edit(json_document_t *doc, size_t start, size_t old_len, const char *insert) {
+    size_t new_len = strlen(insert);
+    memmove(&text[start + new_len], &text[start + old_len], text_len - start - old_len + 1);
+    memcpy(&text[start], insert, new_len);
+    text_len = text_len - old_len + new_len;
+    return json_reparse_range(doc, text, start, old_len, new_len);
+}
+
+// The tree must print like a fresh parse of the whole text
+static void assert_matches_text(json_document_t *doc) {
+    json_t *fresh = json_parse_length(text, text_len);
+    char *expected = json_print_compact(fresh);
+    char *actual = json_print_compact(json_document_root(doc));
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+    json_free(expected);
+    json_free(actual);
+    json_delete(fresh);
+}
+
+// Every value's span must hold exactly the text of that value
+static void assert_spans(json_document_t *doc, const json_t *json, size_t start, size_t length) {
+    size_t found_start, found_length;
+    TEST_ASSERT_TRUE(json_document_at(doc, start, &found_start, &found_length) != NULL);
+    
+    json_t *alone = json_parse_length(&text[start], length);
+    char *a = json_print_compact(alone);
+    char *b = json_print_compact(json);
+    TEST_ASSERT_EQUAL_STRING(a, b);
+    json_free(a);
+    json_free(b);
+    json_delete(alone);
+}
+
+// Look every value up by the first offset that finds it, which must be
+// where its span starts
+static void check_all_spans(json_document_t *doc, const json_t *json) {
+    for (; json; json = json->next) {
+        size_t offset = 0;
+        size_t start = 0, length = 0;
+        while (offset < text_len && json_document_at(doc, offset, &start, &length) != json) offset++;
+        TEST_ASSERT_TRUE(offset < text_len);
+        TEST_ASSERT_EQUAL(offset, start);
+        assert_spans(doc, json, start, length);
+        check_all_spans(doc, json->child);
+    }
+}
+
+// Test spans right after parsing
+void test_document_spans(void) {
+    json_document_t *doc = open_text(" {\"a\": [1, \"two\"], \"b\": {\"c\": null}} ");
+    size_t start, length;
+    
+    TEST_ASSERT_NOT_NULL(doc);
+    json_t *root = json_document_root(doc);
+    TEST_ASSERT_EQUAL_PTR(root, json_document_at(doc, 1, &start, &length));
+    TEST_ASSERT_EQUAL(1, start);
+    TEST_ASSERT_EQUAL(35, length);
+    
+    json_t *two = json_document_at(doc, 12, &start, &length);
+    TEST_ASSERT_EQUAL_STRING("two", two->valuestring);
+    TEST_ASSERT_EQUAL(11, start);
+    TEST_ASSERT_EQUAL(5, length);
+    
+    // Keys are not part of a value's span
+    TEST_ASSERT_EQUAL_PTR(root, json_document_at(doc, 3, NULL, NULL));
+    TEST_ASSERT_NULL(json_document_at(doc, 0, NULL, NULL));
+    TEST_ASSERT_NULL(json_document_at(doc, 36, NULL, NULL));
+    
+    check_all_spans(doc, root);
+    json_document_free(doc);
+    
+    TEST_ASSERT_NULL(open_text("[1, 2"));
+    TEST_ASSERT_NULL(open_text("[1] 2"));
+}
+
+// Test edits at JSON_MAX_DEPTH, the deepest documents go, and edits that
+// would nest past it
+void test_reparse_deep(void) {
+    static char deep[2 * JSON_MAX_DEPTH + 4];
+    size_t len = 0;
+    
+    for (int i = 0; i <= JSON_MAX_DEPTH; i++) deep[len++] = '[';
+    deep[len++] = '5';
+    for (int i = 0; i <= JSON_MAX_DEPTH; i++) deep[len++] = ']';
+    deep[len] = '\0';
+    TEST_ASSERT_NULL(open_text(deep));
+    
+    deep[len - 1] = '\0';  // Without the outermost array
+    json_document_t *doc = open_text(deep + 1);
+    TEST_ASSERT_NOT_NULL(doc);
+    json_t *root = json_document_root(doc);
+    
+    TEST_ASSERT_EQUAL_INT(0, edit(doc, JSON_MAX_DEPTH, 1, "6666"));
+    TEST_ASSERT_EQUAL_PTR(root, json_document_root(doc));
+    json_t *leaf = json_document_at(doc, JSON_MAX_DEPTH, NULL, NULL);
+    TEST_ASSERT_NOT_NULL(leaf);
+    TEST_ASSERT_EQUAL_DOUBLE(6666, leaf->valuenumber);
+    
+    // A new element at the bottom, and a value near the root
+    TEST_ASSERT_EQUAL_INT(0, edit(doc, JSON_MAX_DEPTH + 4, 0, ", 7"));
+    TEST_ASSERT_EQUAL_INT(0, edit(doc, 2, 0, "true, "));
+    assert_matches_text(doc);
+    
+    // One more level at the bottom fails however far the reparse widens
+    TEST_ASSERT_EQUAL_INT(-1, edit(doc, JSON_MAX_DEPTH + 6, 4, "[6666]"));
+    TEST_ASSERT_EQUAL_INT(0, edit(doc, JSON_MAX_DEPTH + 6, 6, "8"));
+    assert_matches_text(doc);
+    json_document_free(doc);
+}
+
+// Test that editing one value leaves the rest of the tree in place
+void test_reparse_scalar(void) {
+    json_document_t *doc = open_text("{\"list\": [10, 20, 30], \"name\": \"x\"}");
+    json_t *root = json_document_root(doc);
+    json_t *list = json_object_get(root, "list");
+    json_t *first = json_array_get(list, 0);
+    json_t *last = json_array_get(list, 2);
+    json_t *name = json_object_get(root, "name");
+    
+    TEST_ASSERT_EQUAL_INT(0, edit(doc, (size_t)(strstr(text, "20") - text), 2, "2222"));
+    TEST_ASSERT_EQUAL_PTR(root, json_document_root(doc));
+    TEST_ASSERT_EQUAL_PTR(list, json_object_get(root, "list"));
+    TEST_ASSERT_EQUAL_PTR(first, json_array_get(list, 0));
+    TEST_ASSERT_EQUAL_PTR(last, json_array_get(list, 2));
+    TEST_ASSERT_EQUAL_PTR(name, json_object_get(root, "name"));
+    TEST_ASSERT_EQUAL_DOUBLE(2222, json_array_get(list, 1)->valuenumber);
+    
+    // Typing inside a string
+    TEST_ASSERT_EQUAL_INT(0, edit(doc, (size_t)(strstr(text, "\"x\"") - text) + 2, 0, "yz"));
+    TEST_ASSERT_EQUAL_STRING("xyz", json_object_get(root, "name")->valuestring);
+    TEST_ASSERT_EQUAL_PTR(list, json_object_get(root, "list"));
+    
+    assert_matches_text(doc);
+    check_all_spans(doc, root);
+    json_document_free(doc);
+}
+
+// Test edits that change structure, which widen to the container
+void test_reparse_structure(void) {
+    json_document_t *doc = open_text("{\"a\": [1, 2], \"b\": {\"c\": true}, \"d\": 4}");
+    json_t *root = json_document_root(doc);
+    json_t *b = json_object_get(root, "b");
+    
+    // A new element is not a single value: the array is re-parsed
+    TEST_ASSERT_EQUAL_INT(0, edit(doc, (size_t)(strstr(text, "2]") - text) + 1, 0, ", 3"));
+    TEST_ASSERT_EQUAL_INT(3, json_array_size(json_object_get(root, "a")));
+    TEST_ASSERT_EQUAL_PTR(b, json_object_get(root, "b"));
+    
+    // Renaming a key re-parses the object holding it
+    TEST_ASSERT_EQUAL_INT(0, edit(doc, (size_t)(strstr(text, "\"c\"") - text) + 1, 1, "renamed"));
+    TEST_ASSERT_NULL(json_object_get(json_object_get(root, "b"), "c"));
+    TEST_ASSERT_TRUE(json_is_true(json_object_get(json_object_get(root, "b"), "renamed")));
+    
+    // Replacing the whole root
+    TEST_ASSERT_EQUAL_INT(0, edit(doc, 0, text_len, "[\"new\"]"));
+    TEST_ASSERT_EQUAL(JSON_ARRAY, json_document_root(doc)->type);
+    
+    assert_matches_text(doc);
+    check_all_spans(doc, json_document_root(doc));
+    json_document_free(doc);
+}
+
+// Test that invalid intermediate text keeps the last tree until fixed
+void test_reparse_invalid(void) {
+    json_document_t *doc = open_text("{\"a\": \"text\"}");
+    json_t *root = json_document_root(doc);
+    
+    TEST_ASSERT_EQUAL_INT(-1, edit(doc, 8, 0, "\""));  // "t"ext"
+    TEST_ASSERT_EQUAL_PTR(root, json_document_root(doc));
+    TEST_ASSERT_NULL(json_document_at(doc, 0, NULL, NULL));
+    
+    TEST_ASSERT_EQUAL_INT(-1, edit(doc, 9, 0, " more"));  // "t" moreext"
+    TEST_ASSERT_EQUAL_INT(0, edit(doc, 8, 0, "\\"));    // "t\" moreext"
+    assert_matches_text(doc);
+    check_all_spans(doc, json_document_root(doc));
+    
+    // Ranges outside the text are rejected without touching the document
+    TEST_ASSERT_EQUAL_INT(-1, json_reparse_range(doc, text, text_len + 1, 0, 0));
+    TEST_ASSERT_EQUAL_INT(-1, json_reparse_range(doc, text, 2, text_len, 0));
+    TEST_ASSERT_NOT_NULL(json_document_at(doc, 0, NULL, NULL));
+    json_document_free(doc);
+}
+
+// Allocator that counts calls, to show the work an edit does
+static int alloc_calls;
+
+static void* counting_malloc(void *ctx, size_t size) {
+    (void)ctx;
+    alloc_calls++;
+    return malloc(size);
+}
+
+static void* counting_realloc(void *ctx, void *ptr, size_t size) {
+    (void)ctx;
+    alloc_calls++;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void *ctx, void *ptr) {
+    (void)ctx;
+    free(ptr);
+}
+
+// Test that an edit in a large document only allocates for what it replaces
+void test_reparse_cost(void) {
+    json_allocator_t allocator = { counting_malloc, counting_realloc, counting_free, NULL };
+    size_t len = 0;
+    
+    text[len++] = '[';
+    for (int i = 0; i < 5000; i++) {
+        len += (size_t)sprintf(&text[len], "%s{\"id\": %d, \"tags\": [\"a\", \"b\"]}", i ? ", " : "", i);
+    }
+    text[len++] = ']';
+    text[len] = '\0';
+    text_len = len;
+    
+    json_set_allocator(&allocator);
+    json_document_t *doc = json_document_parse(text, text_len);
+    TEST_ASSERT_NOT_NULL(doc);
+    
+    char *middle = strstr(text, "\"id\": 2500,");
+    alloc_calls = 0;
+    TEST_ASSERT_EQUAL_INT(0, edit(doc, (size_t)(middle - text) + 6, 4, "99999"));
+    TEST_ASSERT_EQUAL_INT(1, alloc_calls);
+    
+    // A new member re-parses just the one object
+    alloc_calls = 0;
+    TEST_ASSERT_EQUAL_INT(0, edit(doc, (size_t)(middle - text) + 12, 0, " \"x\": 1,"));
+    TEST_ASSERT_TRUE(alloc_calls < 20);
+    
+    json_t *record = json_array_get(json_document_root(doc), 2500);
+    TEST_ASSERT_EQUAL_DOUBLE(99999, json_object_get(record, "id")->valuenumber);
+    TEST_ASSERT_EQUAL_DOUBLE(1, json_object_get(record, "x")->valuenumber);
+    assert_matches_text(doc);
+    
+    // Spans after the edit moved with it, in later blocks of siblings too
+    size_t start, length;
+    const int later[] = { 2501, 2600, 4999 };
+    for (int i = 0; i < 3; i++) {
+        char needle[32];
+        sprintf(needle, "{\"id\": %d,", later[i]);
+        size_t offset = (size_t)(strstr(text, needle) - text);
+        json_t *found = json_document_at(doc, offset, &start, &length);
+        TEST_ASSERT_EQUAL_PTR(json_array_get(json_document_root(doc), later[i]), found);
+        TEST_ASSERT_EQUAL(offset, start);
+        assert_spans(doc, found, start, length);
+    }
+    
+    json_document_free(doc);
+    json_set_allocator(NULL);
+}
+
+// Test random small edits against a full parse after each one; edits
+// that break the text are undone, which must recover the document
+void test_reparse_random(void) {
+    const char *alphabet[] = { "1", "-", "\"", "a", ",", ":", "[", "]", "{", "}", " ", "null", "\\", "2.5" };
+    json_document_t *doc = open_text("{\"a\": [1, 2, {\"b\": \"str\"}], \"c\": {\"d\": [true, [3]]}, \"e\": -1.5}");
+    int applied = 0;
+    
+    srand(7);
+    for (int i = 0; i < 3000; i++) {
+        char removed[4];
+        size_t start = (size_t)rand() % (text_len + 1);
+        size_t old_len = (size_t)rand() % 3;
+        if (old_len > text_len - start) old_len = text_len - start;
+        const char *insert = rand() % 3 == 0 ? "" : alphabet[rand() % 14];
+        memcpy(removed, &text[start], old_len);
+        removed[old_len] = '\0';
+        
+        int status = edit(doc, start, old_len, insert);
+        json_document_t *fresh = json_document_parse(text, text_len);
+        TEST_ASSERT_EQUAL_INT(fresh ? 0 : -1, status);
+        json_document_free(fresh);
+        
+        if (status != 0) {
+            TEST_ASSERT_EQUAL_INT(0, edit(doc, start, strlen(insert), removed));
+        } else {
+            applied++;
+        }
+        assert_matches_text(doc);
+        if (i % 50 == 0) check_all_spans(doc, json_document_root(doc));
+    }
+    
+    TEST_ASSERT_TRUE(applied > 100);
+    json_document_free(doc);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_document_spans);
+    RUN_TEST(test_reparse_scalar);
+    RUN_TEST(test_reparse_structure);
+    RUN_TEST(test_reparse_invalid);
+    RUN_TEST(test_reparse_deep);
+    RUN_TEST(test_reparse_cost);
+    RUN_TEST(test_reparse_random);
+    
+    return UNITY_END();
+}
@@ -0,0 +1,170 @@
+// tests/test_duplicate.c
+#include "unity/unity.h"
+#include "../include/json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// Allocator that counts calls, to show a copy is one block
+static int alloc_calls;
+
+static void* counting_malloc(void *ctx, size_t size) {
+    (void)ctx;
+    alloc_calls++;
+    return malloc(size);
+}
+
+static void* counting_realloc(void *ctx, void *ptr, size_t size) {
+    (void)ctx;
+    alloc_calls++;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void *ctx, void *ptr) {
+    (void)ctx;
+    free(ptr);
+}
+
+static void assert_same_text(const json_t *a, const json_t *b) {
+    char *x = json_print_compact(a);
+    char *y = json_print_compact(b);
+    TEST_ASSERT_EQUAL_STRING(x, y);
+    json_free(x);
+    json_free(y);
+}
+
+// Test a whole-tree copy, which must share nothing with the original
+void test_duplicate_tree(void) {
+    json_t *json = json_parse("{\"name\": \"copy\", \"list\": [1, -2.5, true, null, \"\", [], {}], \"nested\": {\"k\": \"v\"}}");
+    json_t *copy = json_duplicate(json, NULL);
+    
+    TEST_ASSERT_NOT_NULL(copy);
+    TEST_ASSERT_TRUE(json_equal(json, copy));
+    assert_same_text(json, copy);
+    TEST_ASSERT_TRUE(copy->child != json->child);
+    TEST_ASSERT_TRUE(json_object_get(copy, "name")->valuestring != json_object_get(json, "name")->valuestring);
+    
+    // Siblings are linked both ways
+    json_t *list = json_object_get(copy, "list");
+    json_t *last = json_array_get(list, 6);
+    TEST_ASSERT_EQUAL_PTR(json_array_get(list, 5), last->prev);
+    TEST_ASSERT_NULL(last->next);
+    TEST_ASSERT_EQUAL_PTR(last, list->child->prev);  // The head links to the tail
+    
+    json_delete(json);
+    TEST_ASSERT_EQUAL_STRING("v", json_object_get(json_object_get(copy, "nested"), "k")->valuestring);
+    json_free(copy);
+    
+    TEST_ASSERT_NULL(json_duplicate(NULL, NULL));
+}
+
+// Test keeping a subtree after the document it came from is gone
+void test_duplicate_subtree(void) {
+    json_t *doc = json_parse("{\"meta\": {\"id\": 7}, \"payload\": {\"items\": [\"a\", \"b\"], \"count\": 2}}");
+    json_t *payload = json_duplicate(json_object_get(doc, "payload"), NULL);
+    json_delete(doc);
+    
+    TEST_ASSERT_EQUAL_STRING("payload", payload->string);
+    TEST_ASSERT_NULL(payload->next);
+    TEST_ASSERT_NULL(payload->prev);
+    TEST_ASSERT_EQUAL_INT(2, json_array_size(json_object_get(payload, "items")));
+    TEST_ASSERT_EQUAL_DOUBLE(2, json_object_get(payload, "count")->valuenumber);
+    
+    char *text = json_print_compact(payload);
+    TEST_ASSERT_EQUAL_STRING("{\"items\":[\"a\",\"b\"],\"count\":2}", text);
+    json_free(text);
+    json_free(payload);
+}
+
+// Test that a copy is one allocation with its nodes in document order
+void test_duplicate_layout(void) {
+    json_allocator_t allocator = { counting_malloc, counting_realloc, counting_free, NULL };
+    json_t *json = json_parse("[{\"a\": [1, 2]}, \"str\", 3]");
+    
+    json_set_allocator(&allocator);
+    alloc_calls = 0;
+    json_t *copy = json_duplicate(json, NULL);
+    TEST_ASSERT_EQUAL_INT(1, alloc_calls);
+    
+    json_t *object = copy->child;
+    json_t *inner = object->child;
+    TEST_ASSERT_EQUAL_PTR(copy + 1, object);
+    TEST_ASSERT_EQUAL_PTR(copy + 2, inner);
+    TEST_ASSERT_EQUAL_PTR(copy + 3, inner->child);
+    TEST_ASSERT_EQUAL_PTR(copy + 5, object->next);
+    
+    // Strings follow the nodes
+    TEST_ASSERT_TRUE((char *)object->next->valuestring >= (char *)(copy + 7));
+    
+    json_free(copy);
+    json_set_allocator(NULL);
+    json_delete(json);
+}
+
+// Test several copies sharing an arena, released together
+void test_duplicate_arena(void) {
+    json_t *json = json_parse("{\"k\": [1, 2, 3], \"s\": \"text\"}");
+    json_arena_t *arena = json_arena_new(1024);
+    json_t *copies[50];
+    
+    TEST_ASSERT_NOT_NULL(arena);
+    for (int i = 0; i < 50; i++) {
+        copies[i] = json_duplicate(i % 2 ? json : json_object_get(json, "k"), arena);
+        TEST_ASSERT_NOT_NULL(copies[i]);
+    }
+    
+    // Larger than a block
+    static char big[8192];
+    size_t len = 0;
+    big[len++] = '[';
+    for (int i = 0; i < 500; i++) len += (size_t)sprintf(&big[len], "%s%d", i ? "," : "", i);
+    big[len++] = ']';
+    json_t *large = json_parse(big);
+    json_t *large_copy = json_duplicate(large, arena);
+    json_delete(large);
+    
+    for (int i = 0; i < 50; i++) {
+        TEST_ASSERT_TRUE(json_equal(i % 2 ? json : json_object_get(json, "k"), copies[i]));
+    }
+    TEST_ASSERT_EQUAL_INT(500, json_array_size(large_copy));
+    TEST_ASSERT_EQUAL_DOUBLE(499, json_array_get(large_copy, 499)->valuenumber);
+    
+    // Copies made after the large one still share blocks
+    json_t *after = json_duplicate(json, arena);
+    TEST_ASSERT_TRUE(json_equal(json, after));
+    
+    json_delete(json);
+    json_arena_free(arena);
+    json_arena_free(NULL);
+}
+
+// Test that cached hashes travel with the copy
+void test_duplicate_hashes(void) {
+    json_t *json = json_parse("{\"a\": [1, {\"b\": null}]}");
+    uint32_t hash = json_hash(json);
+    json_t *copy = json_duplicate(json, NULL);
+    
+    TEST_ASSERT_EQUAL_UINT32(hash, copy->hash);
+    TEST_ASSERT_EQUAL_UINT32(json_object_get(json, "a")->hash, json_object_get(copy, "a")->hash);
+    json_hash_clear(copy);
+    TEST_ASSERT_EQUAL_UINT32(hash, json_hash(copy));
+    
+    json_free(copy);
+    json_delete(json);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_duplicate_tree);
+    RUN_TEST(test_duplicate_subtree);
+    RUN_TEST(test_duplicate_layout);
+    RUN_TEST(test_duplicate_arena);
+    RUN_TEST(test_duplicate_hashes);
+    
+    return UNITY_END();
+}
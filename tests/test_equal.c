@@ -0,0 +1,174 @@
+// tests/test_equal.c
+#include "unity/unity.h"
+#include "../include/json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static int equal_text(const char *a, const char *b) {
+    json_t *x = json_parse(a);
+    json_t *y = json_parse(b);
+    TEST_ASSERT_NOT_NULL(x);
+    TEST_ASSERT_NOT_NULL(y);
+    int equal = json_equal(x, y);
+    
+    // Hashing must not change the answer, and equal values hash alike
+    json_hash(x);
+    json_hash(y);
+    TEST_ASSERT_EQUAL_INT(equal, json_equal(x, y));
+    if (equal) TEST_ASSERT_EQUAL_UINT32(json_hash(x), json_hash(y));
+    
+    json_delete(x);
+    json_delete(y);
+    return equal;
+}
+
+// Test equality of scalars and arrays
+void test_equal_values(void) {
+    TEST_ASSERT_TRUE(equal_text("null", "null"));
+    TEST_ASSERT_TRUE(equal_text("1.5", "1.50"));
+    TEST_ASSERT_TRUE(equal_text("0", "-0"));
+    TEST_ASSERT_TRUE(equal_text("100", "1e2"));
+    TEST_ASSERT_TRUE(equal_text("\"a\\u0062\"", "\"ab\""));
+    TEST_ASSERT_TRUE(equal_text("[1, [2, {}], []]", "[1,[2,{}],[]]"));
+    
+    TEST_ASSERT_FALSE(equal_text("true", "false"));
+    TEST_ASSERT_FALSE(equal_text("0", "false"));
+    TEST_ASSERT_FALSE(equal_text("\"1\"", "1"));
+    TEST_ASSERT_FALSE(equal_text("[1, 2]", "[2, 1]"));
+    TEST_ASSERT_FALSE(equal_text("[1, 2]", "[1, 2, 3]"));
+    TEST_ASSERT_FALSE(equal_text("[[]]", "[{}]"));
+    
+    TEST_ASSERT_TRUE(json_equal(NULL, NULL));
+    TEST_ASSERT_EQUAL_UINT32(0, json_hash(NULL));
+}
+
+// Test that objects compare regardless of member order
+void test_equal_objects(void) {
+    TEST_ASSERT_TRUE(equal_text("{\"a\": 1, \"b\": [true]}", "{\"b\": [true], \"a\": 1}"));
+    TEST_ASSERT_TRUE(equal_text("{\"x\": {\"p\": 1, \"q\": 2}}", "{\"x\": {\"q\": 2, \"p\": 1}}"));
+    TEST_ASSERT_TRUE(equal_text("{\"a\": 1, \"a\": 2}", "{\"a\": 2, \"a\": 1}"));
+    
+    TEST_ASSERT_FALSE(equal_text("{\"a\": 1}", "{\"b\": 1}"));
+    TEST_ASSERT_FALSE(equal_text("{\"a\": 1, \"b\": 2}", "{\"a\": 2, \"b\": 1}"));
+    TEST_ASSERT_FALSE(equal_text("{\"a\": 1, \"b\": 2}", "{\"b\": 2}"));
+    TEST_ASSERT_FALSE(equal_text("{\"a\": 1, \"a\": 1}", "{\"a\": 1, \"b\": 1}"));
+    TEST_ASSERT_FALSE(equal_text("{\"k\": \"v\"}", "{\"v\": \"k\"}"));
+}
+
+// Test large objects whose members are shuffled, which are sorted by key
+void test_equal_shuffled(void) {
+    static char a[65536], b[65536];
+    size_t la = 0, lb = 0;
+    int order[1000];
+    
+    for (int i = 0; i < 1000; i++) order[i] = i;
+    srand(3);
+    for (int i = 999; i > 0; i--) {
+        int j = rand() % (i + 1);
+        int t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    
+    la += (size_t)sprintf(&a[la], "{");
+    lb += (size_t)sprintf(&b[lb], "{");
+    for (int i = 0; i < 1000; i++) {
+        la += (size_t)sprintf(&a[la], "%s\"k%d\": [%d]", i ? ", " : "", i, i);
+        lb += (size_t)sprintf(&b[lb], "%s\"k%d\": [%d]", i ? ", " : "", order[i], order[i]);
+    }
+    sprintf(&a[la], "}");
+    sprintf(&b[lb], "}");
+    TEST_ASSERT_TRUE(equal_text(a, b));
+    
+    // One value changed, far from the front
+    char *changed = strstr(b, "\"k500\": [500]");
+    changed[10] = '6';
+    TEST_ASSERT_FALSE(equal_text(a, b));
+}
+
+// Test that hashes cached while parsing match lazy ones and reject early
+void test_hash_cached(void) {
+    const char *text = "{\"name\": \"svc\", \"ports\": [80, 443], \"env\": {\"A\": \"1\"}}";
+    json_parse_options_t options = { NULL, NULL, 1 };
+    json_t *parsed = json_parse_ex(text, strlen(text), &options);
+    json_t *plain = json_parse(text);
+    
+    TEST_ASSERT_NOT_EQUAL(0, parsed->hash);
+    TEST_ASSERT_NOT_EQUAL(0, json_object_get(parsed, "ports")->child->hash);
+    TEST_ASSERT_EQUAL(0, plain->hash);
+    TEST_ASSERT_EQUAL_UINT32(parsed->hash, json_hash(plain));
+    TEST_ASSERT_EQUAL_UINT32(json_object_get(parsed, "env")->hash, json_object_get(plain, "env")->hash);
+    TEST_ASSERT_TRUE(json_equal(parsed, plain));
+    
+    // A changed value, with its ancestors' caches dropped, hashes anew
+    json_t *port = json_object_get(plain, "ports")->child;
+    port->valuenumber = 8080;
+    port->hash = 0;
+    json_object_get(plain, "ports")->hash = 0;
+    plain->hash = 0;
+    TEST_ASSERT_NOT_EQUAL(parsed->hash, json_hash(plain));
+    TEST_ASSERT_EQUAL_UINT32(json_object_get(parsed, "env")->hash, json_object_get(plain, "env")->hash);
+    TEST_ASSERT_FALSE(json_equal(parsed, plain));
+    
+    json_hash_clear(plain);
+    TEST_ASSERT_EQUAL(0, plain->hash);
+    TEST_ASSERT_EQUAL(0, json_object_get(plain, "env")->child->hash);
+    
+    json_delete(parsed);
+    json_delete(plain);
+}
+
+// Test that json_equal trusts a hash mismatch without walking the values
+void test_hash_short_circuit(void) {
+    json_t *a = json_parse("[1, 2, 3]");
+    json_t *b = json_parse("[1, 2, 3]");
+    
+    TEST_ASSERT_TRUE(json_equal(a, b));
+    json_hash(a);
+    json_hash(b);
+    b->hash ^= 1;  // A stale cache is believed
+    TEST_ASSERT_FALSE(json_equal(a, b));
+    b->hash = 0;   // Only one side cached: compared in full
+    TEST_ASSERT_TRUE(json_equal(a, b));
+    
+    json_delete(a);
+    json_delete(b);
+}
+
+// Test that edits to a document drop the hashes of the values containing them
+void test_hash_document(void) {
+    char text[] = "{\"a\": [1, 2], \"b\": {\"c\": 3}}";
+    json_document_t *doc = json_document_parse(text, strlen(text));
+    json_t *root = json_document_root(doc);
+    uint32_t before = json_hash(root);
+    uint32_t b = json_hash(json_object_get(root, "b"));
+    
+    text[7] = '5';
+    TEST_ASSERT_EQUAL_INT(0, json_reparse_range(doc, text, 7, 1, 1));
+    TEST_ASSERT_NOT_EQUAL(before, json_hash(root));
+    TEST_ASSERT_EQUAL_UINT32(b, json_object_get(root, "b")->hash);
+    
+    json_t *fresh = json_parse(text);
+    TEST_ASSERT_EQUAL_UINT32(json_hash(fresh), json_hash(root));
+    TEST_ASSERT_TRUE(json_equal(fresh, root));
+    json_delete(fresh);
+    json_document_free(doc);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_equal_values);
+    RUN_TEST(test_equal_objects);
+    RUN_TEST(test_equal_shuffled);
+    RUN_TEST(test_hash_cached);
+    RUN_TEST(test_hash_short_circuit);
+    RUN_TEST(test_hash_document);
+    
+    return UNITY_END();
+}
@@ -0,0 +1,250 @@
+// tests/test_mutate.c
+#include "unity/unity.h"
+#include "../include/json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void assert_text(const char *expected, const json_t *json) {
+    char *text = json_print_compact(json);
+    TEST_ASSERT_EQUAL_STRING(expected, text);
+    json_free(text);
+}
+
+// The head's prev must be the tail and every other prev the node before
+static void assert_links(const json_t *container) {
+    const json_t *head = container->child;
+    const json_t *before = NULL;
+    for (const json_t *child = head; child; child = child->next) {
+        if (child != head) TEST_ASSERT_EQUAL_PTR(before, child->prev);
+        before = child;
+    }
+    if (head) TEST_ASSERT_EQUAL_PTR(before, head->prev);
+}
+
+// Test building a tree from nothing
+void test_build_tree(void) {
+    json_t *root = json_create_object(NULL);
+    json_t *list = json_create_array(NULL);
+    
+    TEST_ASSERT_EQUAL_INT(0, json_object_add(root, "name", json_create_string("build", NULL), NULL));
+    TEST_ASSERT_EQUAL_INT(0, json_array_append(list, json_create_number(1, NULL)));
+    TEST_ASSERT_EQUAL_INT(0, json_array_append(list, json_create_bool(1, NULL)));
+    TEST_ASSERT_EQUAL_INT(0, json_array_append(list, json_create_null(NULL)));
+    TEST_ASSERT_EQUAL_INT(0, json_array_append(list, json_create_object(NULL)));
+    TEST_ASSERT_EQUAL_INT(0, json_object_add(root, "list", list, NULL));
+    TEST_ASSERT_EQUAL_INT(0, json_object_add(root, "off", json_create_bool(0, NULL), NULL));
+    
+    assert_text("{\"name\":\"build\",\"list\":[1,true,null,{}],\"off\":false}", root);
+    assert_links(root);
+    assert_links(list);
+    
+    json_t *parsed = json_parse("{\"name\":\"build\",\"list\":[1,true,null,{}],\"off\":false}");
+    TEST_ASSERT_TRUE(json_equal(parsed, root));
+    json_delete(parsed);
+    json_delete(root);
+}
+
+// Test appending to parsed containers, whose heads also link to the tail
+void test_append_parsed(void) {
+    json_t *json = json_parse("{\"a\": [1, 2], \"b\": []}");
+    json_t *a = json_object_get(json, "a");
+    json_t *b = json_object_get(json, "b");
+    
+    assert_links(json);
+    assert_links(a);
+    TEST_ASSERT_EQUAL_INT(0, json_array_append(a, json_create_number(3, NULL)));
+    TEST_ASSERT_EQUAL_INT(0, json_array_append(b, json_create_string("x", NULL)));
+    TEST_ASSERT_EQUAL_INT(0, json_object_add(json, "c", json_create_null(NULL), NULL));
+    assert_text("{\"a\":[1,2,3],\"b\":[\"x\"],\"c\":null}", json);
+    assert_links(a);
+    assert_links(b);
+    json_delete(json);
+}
+
+// Test that no insertion can make a container its own descendant
+void test_reject_cycles(void) {
+    json_t *a = json_create_array(NULL);
+    json_t *b = json_create_array(NULL);
+    json_t *c = json_create_object(NULL);
+    
+    TEST_ASSERT_EQUAL_INT(-1, json_array_append(a, a));
+    TEST_ASSERT_EQUAL_INT(0, json_array_append(a, b));
+    TEST_ASSERT_EQUAL_INT(0, json_object_add(c, "x", json_create_number(1, NULL), NULL));
+    TEST_ASSERT_EQUAL_INT(0, json_array_append(b, c));
+    
+    // a holds b holds c: a cannot go into either, at any position
+    TEST_ASSERT_EQUAL_INT(-1, json_array_append(b, a));
+    TEST_ASSERT_EQUAL_INT(-1, json_object_add(c, "a", a, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, json_object_set(c, "x", a, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, json_array_replace(b, 0, a, NULL));
+    assert_text("[[{\"x\":1}]]", a);
+    
+    // Detached, b still holds c, but goes into any container outside it
+    TEST_ASSERT_EQUAL_PTR(b, json_array_detach(a, 0));
+    TEST_ASSERT_EQUAL_INT(-1, json_object_add(c, "b", b, NULL));
+    json_t *doc = json_parse("{\"list\": [1]}");
+    json_t *list = json_object_get(doc, "list");
+    TEST_ASSERT_EQUAL_INT(0, json_array_append(list, b));
+    TEST_ASSERT_EQUAL_INT(0, json_array_append(list, a));
+    assert_text("{\"list\":[1,[{\"x\":1}],[]]}", doc);
+    assert_links(list);
+    json_delete(doc);
+}
+
+// Test replacing values in place, at the head, middle and tail
+void test_replace(void) {
+    json_t *json = json_parse("{\"a\": 1, \"b\": [10, 20, 30], \"c\": 3}");
+    json_t *list = json_object_get(json, "b");
+    
+    TEST_ASSERT_EQUAL_INT(0, json_object_set(json, "a", json_create_string("one", NULL), NULL));
+    TEST_ASSERT_EQUAL_INT(0, json_object_set(json, "c", json_create_number(33, NULL), NULL));
+    TEST_ASSERT_EQUAL_INT(0, json_object_set(json, "d", json_create_null(NULL), NULL));
+    TEST_ASSERT_EQUAL_INT(0, json_array_replace(list, 0, json_create_number(11, NULL), NULL));
+    TEST_ASSERT_EQUAL_INT(0, json_array_replace(list, 1, json_create_number(22, NULL), NULL));
+    TEST_ASSERT_EQUAL_INT(0, json_array_replace(list, 2, json_create_number(33, NULL), NULL));
+    TEST_ASSERT_EQUAL_PTR(list, json_object_get(json, "b"));
+    
+    assert_text("{\"a\":\"one\",\"b\":[11,22,33],\"c\":33,\"d\":null}", json);
+    assert_links(json);
+    assert_links(list);
+    
+    // The only element
+    json_t *single = json_parse("[1]");
+    TEST_ASSERT_EQUAL_INT(0, json_array_replace(single, 0, json_create_number(2, NULL), NULL));
+    assert_text("[2]", single);
+    assert_links(single);
+    TEST_ASSERT_EQUAL_INT(0, json_array_append(single, json_create_number(3, NULL)));
+    assert_text("[2,3]", single);
+    json_delete(single);
+    
+    // Refused: a missing index, the wrong container type, and values
+    // that are already in a container
+    json_t *spare = json_create_null(NULL);
+    TEST_ASSERT_EQUAL_INT(-1, json_array_replace(list, 3, spare, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, json_array_append(json, spare));
+    TEST_ASSERT_EQUAL_INT(-1, json_object_add(list, "k", spare, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, json_array_append(list, list->child));
+    TEST_ASSERT_EQUAL_INT(-1, json_array_append(list, list));
+    TEST_ASSERT_EQUAL_INT(-1, json_object_set(json, "a", json_object_get(json, "c"), NULL));
+    assert_text("{\"a\":\"one\",\"b\":[11,22,33],\"c\":33,\"d\":null}", json);
+    json_delete(spare);
+    json_delete(json);
+}
+
+// Test removing and detaching values from every position
+void test_remove(void) {
+    json_t *json = json_parse("[1, 2, 3, 4, 5]");
+    
+    TEST_ASSERT_EQUAL_INT(0, json_array_remove(json, 0, NULL));
+    TEST_ASSERT_EQUAL_INT(0, json_array_remove(json, 3, NULL));
+    TEST_ASSERT_EQUAL_INT(0, json_array_remove(json, 1, NULL));
+    assert_text("[2,4]", json);
+    assert_links(json);
+    TEST_ASSERT_EQUAL_INT(-1, json_array_remove(json, 2, NULL));
+    
+    json_t *two = json_array_detach(json, 0);
+    json_t *four = json_array_detach(json, 0);
+    assert_text("[]", json);
+    TEST_ASSERT_NULL(json->child);
+    TEST_ASSERT_NULL(two->next);
+    TEST_ASSERT_NULL(two->prev);
+    
+    // Detached values can go back in
+    TEST_ASSERT_EQUAL_INT(0, json_array_append(json, four));
+    TEST_ASSERT_EQUAL_INT(0, json_array_append(json, two));
+    assert_text("[4,2]", json);
+    assert_links(json);
+    json_delete(json);
+    
+    json = json_parse("{\"a\": 1, \"b\": {\"c\": 2}, \"d\": 3}");
+    json_t *b = json_object_detach(json, "b");
+    TEST_ASSERT_EQUAL_STRING("b", b->string);
+    TEST_ASSERT_EQUAL_INT(0, json_object_remove(json, "d", NULL));
+    TEST_ASSERT_EQUAL_INT(-1, json_object_remove(json, "d", NULL));
+    TEST_ASSERT_EQUAL_INT(0, json_object_add(json, "moved", b, NULL));
+    assert_text("{\"a\":1,\"moved\":{\"c\":2}}", json);
+    assert_links(json);
+    json_delete(json);
+}
+
+// Test that changes clear the cached hash of the container changed
+void test_mutate_hash(void) {
+    json_t *json = json_parse("{\"list\": [1, 2]}");
+    json_t *list = json_object_get(json, "list");
+    json_hash(json);
+    
+    TEST_ASSERT_EQUAL_INT(0, json_array_append(list, json_create_number(3, NULL)));
+    TEST_ASSERT_EQUAL(0, list->hash);
+    json->hash = 0;  // The ancestor is the caller's to clear
+    
+    json_t *expected = json_parse("{\"list\": [1, 2, 3]}");
+    TEST_ASSERT_EQUAL_UINT32(json_hash(expected), json_hash(json));
+    TEST_ASSERT_TRUE(json_equal(expected, json));
+    json_delete(expected);
+    json_delete(json);
+}
+
+// Test building a million-element array in an arena, which must take
+// linear time and only allocate arena blocks
+static int alloc_calls;
+
+static void* counting_malloc(void *ctx, size_t size) {
+    (void)ctx;
+    alloc_calls++;
+    return malloc(size);
+}
+
+static void* counting_realloc(void *ctx, void *ptr, size_t size) {
+    (void)ctx;
+    alloc_calls++;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void *ctx, void *ptr) {
+    (void)ctx;
+    free(ptr);
+}
+
+void test_build_arena(void) {
+    json_allocator_t allocator = { counting_malloc, counting_realloc, counting_free, NULL };
+    json_set_allocator(&allocator);
+    alloc_calls = 0;
+    
+    json_arena_t *arena = json_arena_new(1 << 20);
+    json_t *root = json_create_object(arena);
+    json_t *array = json_create_array(arena);
+    TEST_ASSERT_EQUAL_INT(0, json_object_add(root, "values", array, arena));
+    for (int i = 0; i < 1000000; i++) {
+        TEST_ASSERT_EQUAL_INT(0, json_array_append(array, json_create_number(i, arena)));
+    }
+    TEST_ASSERT_EQUAL_INT(0, json_object_set(root, "name", json_create_string("big", arena), arena));
+    TEST_ASSERT_EQUAL_INT(0, json_object_set(root, "name", json_create_string("bigger", arena), arena));
+    TEST_ASSERT_EQUAL_INT(0, json_array_remove(array, 0, arena));
+    
+    TEST_ASSERT_TRUE(alloc_calls < 100);
+    TEST_ASSERT_EQUAL_INT(999999, json_array_size(array));
+    TEST_ASSERT_EQUAL_DOUBLE(999999, array->child->prev->valuenumber);
+    TEST_ASSERT_EQUAL_STRING("bigger", json_object_get(root, "name")->valuestring);
+    
+    json_arena_free(arena);
+    json_set_allocator(NULL);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_build_tree);
+    RUN_TEST(test_append_parsed);
+    RUN_TEST(test_reject_cycles);
+    RUN_TEST(test_replace);
+    RUN_TEST(test_remove);
+    RUN_TEST(test_mutate_hash);
+    RUN_TEST(test_build_arena);
+    
+    return UNITY_END();
+}
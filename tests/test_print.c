@@ -0,0 +1,263 @@
+// tests/test_print.c
+#include "unity/unity.h"
+#include "../include/json.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Parse, print compactly and compare against the expected text
+static void assert_compact(const char *input, const char *expected) {
+    json_t *json = json_parse(input);
+    TEST_ASSERT_NOT_NULL(json);
+    
+    char *text = json_print_compact(json);
+    TEST_ASSERT_NOT_NULL(text);
+    TEST_ASSERT_EQUAL_STRING(expected, text);
+    
+    free(text);
+    json_delete(json);
+}
+
+// Test scalar values
+void test_print_scalars(void) {
+    assert_compact("null", "null");
+    assert_compact("true", "true");
+    assert_compact("false", "false");
+    assert_compact("\"hello\"", "\"hello\"");
+    assert_compact("42", "42");
+    assert_compact("-123", "-123");
+}
+
+// Test compact containers
+void test_print_compact_containers(void) {
+    assert_compact("{}", "{}");
+    assert_compact("[]", "[]");
+    assert_compact("[1, 2, 3]", "[1,2,3]");
+    assert_compact("{ \"a\" : [true, null], \"b\" : {} }", "{\"a\":[true,null],\"b\":{}}");
+}
+
+// Test pretty output
+void test_print_pretty(void) {
+    json_t *json = json_parse("{\"name\": \"John\", \"tags\": [1, 2], \"empty\": []}");
+    TEST_ASSERT_NOT_NULL(json);
+    
+    char *text = json_print(json);
+    TEST_ASSERT_NOT_NULL(text);
+    TEST_ASSERT_EQUAL_STRING(
+        "{\n"
+        "  \"name\": \"John\",\n"
+        "  \"tags\": [\n"
+        "    1,\n"
+        "    2\n"
+        "  ],\n"
+        "  \"empty\": []\n"
+        "}", text);
+    
+    free(text);
+    json_delete(json);
+}
+
+// Test that numbers read back exactly
+void test_print_number_round_trip(void) {
+    assert_compact("3.14", "3.14");
+    assert_compact("0.1", "0.1");
+    assert_compact("1e300", "1e300");
+    assert_compact("-2.5E-3", "-0.0025");
+    
+    json_t *json = json_parse("0.30000000000000004");
+    char *text = json_print_compact(json);
+    json_t *back = json_parse(text);
+    TEST_ASSERT_TRUE(back->valuenumber == json->valuenumber);
+    
+    free(text);
+    json_delete(json);
+    json_delete(back);
+}
+
+// Test the public number formatters
+void test_format_numbers(void) {
+    char buf[JSON_NUMBER_BUFFER_SIZE];
+    
+    TEST_ASSERT_EQUAL_INT(3, json_format_double(0.1, buf));
+    TEST_ASSERT_EQUAL_STRING("0.1", buf);
+    json_format_double(5e-324, buf);
+    TEST_ASSERT_EQUAL_STRING("5e-324", buf);
+    json_format_double(1.7976931348623157e308, buf);
+    TEST_ASSERT_EQUAL_STRING("1.7976931348623157e308", buf);
+    json_format_double(-0.0, buf);
+    TEST_ASSERT_EQUAL_STRING("-0", buf);
+    json_format_double(0.0 / 0.0, buf);
+    TEST_ASSERT_EQUAL_STRING("null", buf);
+    
+    TEST_ASSERT_EQUAL_INT(20, json_format_integer(-9223372036854775807LL - 1, buf));
+    TEST_ASSERT_EQUAL_STRING("-9223372036854775808", buf);
+    json_format_integer(1234567, buf);
+    TEST_ASSERT_EQUAL_STRING("1234567", buf);
+}
+
+// Significant digits of a formatted number, ignoring leading and
+// trailing zeros
+static int significant_digits(const char *text) {
+    int count = 0, zeros = 0, started = 0;
+    for (; *text && *text != 'e'; text++) {
+        if (*text < '0' || *text > '9') continue;
+        if (*text == '0') {
+            if (started) zeros++;
+            continue;
+        }
+        started = 1;
+        count += zeros + 1;
+        zeros = 0;
+    }
+    return count;
+}
+
+// Format value and check it reads back with no more digits than the
+// fewest correctly rounded ones that do
+static void assert_shortest(double value) {
+    char buf[JSON_NUMBER_BUFFER_SIZE];
+    char ref[32];
+    int precision;
+    
+    json_format_double(value, buf);
+    TEST_ASSERT_TRUE(strtod(buf, NULL) == value);
+    for (precision = 1; precision < 17; precision++) {
+        snprintf(ref, sizeof(ref), "%.*e", precision - 1, value);
+        if (strtod(ref, NULL) == value) break;
+    }
+    TEST_ASSERT_TRUE(significant_digits(buf) <= precision);
+}
+
+// Test that doubles get their shortest text, including those Grisu's
+// 64-bit arithmetic cannot settle
+void test_format_shortest(void) {
+    char buf[JSON_NUMBER_BUFFER_SIZE];
+    
+    json_format_double(5.9392807835734704e16, buf);
+    TEST_ASSERT_EQUAL_STRING("5.93928078357347e16", buf);
+    json_format_double(1e23, buf);
+    TEST_ASSERT_EQUAL_STRING("1e23", buf);
+    json_format_double(9007199254740993.0, buf);
+    TEST_ASSERT_EQUAL_STRING("9.007199254740992e15", buf);
+    
+    // Powers of two, whose interval is narrower below
+    for (int e = -1074; e <= 1023; e++) assert_shortest(ldexp(1.0, e));
+    
+    // Random bit patterns
+    uint64_t x = 88172645463325252ULL;
+    for (int i = 0; i < 20000; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        uint64_t bits = x & ~((uint64_t)1 << 63);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if (isfinite(value) && value != 0) assert_shortest(value);
+    }
+}
+
+// Test string escaping in both directions
+void test_print_escapes(void) {
+    assert_compact("\"a\\\"b\\\\c\"", "\"a\\\"b\\\\c\"");
+    assert_compact("\"line\\nbreak\\ttab\"", "\"line\\nbreak\\ttab\"");
+    assert_compact("\"\\u0001\"", "\"\\u0001\"");
+    assert_compact("\"\\/\"", "\"/\"");
+    
+    // Unicode escapes decode to UTF-8 and are printed verbatim
+    json_t *json = json_parse("\"\\u00e9\\ud83d\\ude00\"");
+    TEST_ASSERT_NOT_NULL(json);
+    TEST_ASSERT_EQUAL_STRING("\xc3\xa9\xf0\x9f\x98\x80", json->valuestring);
+    json_delete(json);
+    
+    // Malformed escapes are rejected
+    TEST_ASSERT_NULL(json_parse("\"\\x\""));
+    TEST_ASSERT_NULL(json_parse("\"\\ud83d\""));
+}
+
+// Test escapes at every offset of strings spanning several vector blocks
+void test_print_escape_positions(void) {
+    const char specials[] = { '"', '\\', '\n', 0x1F };
+    char input[80];
+    
+    for (size_t k = 0; k < sizeof(specials); k++) {
+        for (int pos = 0; pos < 70; pos++) {
+            memset(input, 'a', 70);
+            input[70] = '\0';
+            input[pos] = specials[k];
+            
+            json_t item = { 0 };
+            item.type = JSON_STRING;
+            item.valuestring = input;
+            
+            char *text = json_print_compact(&item);
+            json_t *back = json_parse(text);
+            TEST_ASSERT_NOT_NULL(back);
+            TEST_ASSERT_EQUAL_STRING(input, back->valuestring);
+            
+            // Exactly one escape sequence was inserted
+            size_t escaped = specials[k] == 0x1F ? 6 : 2;
+            TEST_ASSERT_EQUAL_INT((int)(70 - 1 + escaped + 2), (int)strlen(text));
+            
+            free(text);
+            json_delete(back);
+        }
+    }
+}
+
+// Test printing into caller memory
+void test_print_buffered(void) {
+    json_t *json = json_parse("[1, \"two\", {\"three\": 3}]");
+    char buf[64];
+    
+    size_t len = json_print_buffered(json, buf, sizeof(buf), JSON_PRINT_COMPACT);
+    TEST_ASSERT_EQUAL_INT(21, (int)len);
+    TEST_ASSERT_EQUAL_STRING("[1,\"two\",{\"three\":3}]", buf);
+    TEST_ASSERT_EQUAL_INT((int)strlen(buf), (int)len);
+    
+    // Too small: nothing is written and 0 is returned
+    TEST_ASSERT_EQUAL_INT(0, (int)json_print_buffered(json, buf, 10, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_STRING("", buf);
+    
+    json_delete(json);
+}
+
+// Test that print output parses back to the same structure
+void test_print_round_trip(void) {
+    const char *input = "{\"users\": [{\"name\": \"J\\\"ohn\", \"age\": 30, \"active\": true}], \"score\": -0.5}";
+    json_t *json = json_parse(input);
+    
+    char *pretty = json_print(json);
+    char *compact = json_print_compact(json);
+    json_t *reparsed = json_parse(pretty);
+    char *again = json_print_compact(reparsed);
+    
+    TEST_ASSERT_EQUAL_STRING(compact, again);
+    
+    free(pretty);
+    free(compact);
+    free(again);
+    json_delete(json);
+    json_delete(reparsed);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_print_scalars);
+    RUN_TEST(test_print_compact_containers);
+    RUN_TEST(test_print_pretty);
+    RUN_TEST(test_print_number_round_trip);
+    RUN_TEST(test_format_numbers);
+    RUN_TEST(test_format_shortest);
+    RUN_TEST(test_print_escapes);
+    RUN_TEST(test_print_escape_positions);
+    RUN_TEST(test_print_buffered);
+    RUN_TEST(test_print_round_trip);
+    
+    return UNITY_END();
+}
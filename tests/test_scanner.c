@@ -0,0 +1,263 @@
+// tests/test_scanner.c
+#include "unity/unity.h"
+#include "../include/json.h"
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Scan text to the end, returns 1 if it is a complete valid document
+static int scans_clean(const char *text) {
+    json_scanner_t s;
+    json_scanner_init(&s, text, strlen(text));
+    
+    int token;
+    while ((token = json_scanner_next(&s)) > 0) {
+    }
+    return token == JSON_TOKEN_END;
+}
+
+// Test the token sequence and token text of a small document
+void test_scanner_tokens(void) {
+    const char *text = " {\"a\": [1, -2.5e3, \"x\\\"y\"], \"b\": {}, \"c\": null} ";
+    json_scanner_t s;
+    json_scanner_init(&s, text, strlen(text));
+    
+    static const int expected[] = {
+        JSON_TOKEN_OBJECT_BEGIN,
+        JSON_TOKEN_KEY, JSON_TOKEN_ARRAY_BEGIN,
+        JSON_TOKEN_NUMBER, JSON_TOKEN_NUMBER, JSON_TOKEN_STRING,
+        JSON_TOKEN_ARRAY_END,
+        JSON_TOKEN_KEY, JSON_TOKEN_OBJECT_BEGIN, JSON_TOKEN_OBJECT_END,
+        JSON_TOKEN_KEY, JSON_TOKEN_NULL,
+        JSON_TOKEN_OBJECT_END,
+        JSON_TOKEN_END
+    };
+    static const char *texts[] = {
+        "{", "\"a\"", "[", "1", "-2.5e3", "\"x\\\"y\"", "]",
+        "\"b\"", "{", "}", "\"c\"", "null", "}"
+    };
+    
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        int token = json_scanner_next(&s);
+        TEST_ASSERT_EQUAL_INT(expected[i], token);
+        if (token != JSON_TOKEN_END) {
+            TEST_ASSERT_EQUAL_INT((int)strlen(texts[i]), (int)s.token_length);
+            TEST_ASSERT_EQUAL_INT(0, memcmp(texts[i], s.token, s.token_length));
+        }
+    }
+}
+
+// Test documents the scanner accepts
+void test_scanner_valid(void) {
+    TEST_ASSERT_TRUE(scans_clean("0"));
+    TEST_ASSERT_TRUE(scans_clean("-0.0e-0"));
+    TEST_ASSERT_TRUE(scans_clean("\"\\u00e9\\n\""));
+    TEST_ASSERT_TRUE(scans_clean("[[[]], {}]"));
+    TEST_ASSERT_TRUE(scans_clean("\t{ \"k\" :\r\n true }\n"));
+}
+
+// Test grammar errors
+void test_scanner_invalid(void) {
+    TEST_ASSERT_FALSE(scans_clean(""));
+    TEST_ASSERT_FALSE(scans_clean("   "));
+    TEST_ASSERT_FALSE(scans_clean("1 2"));
+    TEST_ASSERT_FALSE(scans_clean("01"));
+    TEST_ASSERT_FALSE(scans_clean("1."));
+    TEST_ASSERT_FALSE(scans_clean("-"));
+    TEST_ASSERT_FALSE(scans_clean("tru"));
+    TEST_ASSERT_FALSE(scans_clean("nullx"));
+    TEST_ASSERT_FALSE(scans_clean("[1,]"));
+    TEST_ASSERT_FALSE(scans_clean("[1 2]"));
+    TEST_ASSERT_FALSE(scans_clean("{\"a\" 1}"));
+    TEST_ASSERT_FALSE(scans_clean("{\"a\": 1,}"));
+    TEST_ASSERT_FALSE(scans_clean("{1: 2}"));
+    TEST_ASSERT_FALSE(scans_clean("[}"));
+    TEST_ASSERT_FALSE(scans_clean("{]"));
+    TEST_ASSERT_FALSE(scans_clean("[1"));
+    TEST_ASSERT_FALSE(scans_clean("\"abc"));
+    TEST_ASSERT_FALSE(scans_clean("\"\\x\""));
+    TEST_ASSERT_FALSE(scans_clean("\"\\u12\""));
+    TEST_ASSERT_FALSE(scans_clean("\"tab\there\""));
+}
+
+// Test that \u surrogates must pair up, as json_parse requires
+void test_scanner_surrogates(void) {
+    const char *valid[] = { "\"\\ud83d\\ude00\"", "\"a\\uD83D\\uDE00b\"", "\"\\ud7ff\\ue000\"" };
+    const char *invalid[] = {
+        "\"\\ud83d\"",             // Lone high surrogate
+        "\"\\udc00\"",             // Lone low surrogate
+        "\"\\ude00\\ud83d\"",      // Reversed pair
+        "\"\\ud83d\\ud83d\"",      // High followed by high
+        "\"\\ud83d\\n\"",          // High followed by another escape
+        "\"\\ud83dx\\ude00\""      // Not adjacent
+    };
+    
+    for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++) {
+        TEST_ASSERT_TRUE(scans_clean(valid[i]));
+        TEST_ASSERT_TRUE(json_validate(valid[i], strlen(valid[i])));
+        json_t *json = json_parse(valid[i]);
+        TEST_ASSERT_NOT_NULL(json);
+        json_delete(json);
+    }
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        TEST_ASSERT_FALSE(scans_clean(invalid[i]));
+        TEST_ASSERT_FALSE(json_validate(invalid[i], strlen(invalid[i])));
+        TEST_ASSERT_NULL(json_parse(invalid[i]));
+    }
+}
+
+// Test json_validate, including UTF-8 checking inside strings
+void test_validate(void) {
+    const char *valid_utf8 = "[\"caf\xc3\xa9\", \"\xe2\x82\xac\", \"\xf0\x9f\x98\x80\"]";
+    TEST_ASSERT_TRUE(json_validate(valid_utf8, strlen(valid_utf8)));
+    TEST_ASSERT_TRUE(json_validate("{\"a\": [1, 2]}", 13));
+    
+    // Length-delimited: trailing bytes past length are ignored
+    TEST_ASSERT_TRUE(json_validate("[1]garbage", 3));
+    TEST_ASSERT_FALSE(json_validate("[1]garbage", 10));
+    TEST_ASSERT_FALSE(json_validate(NULL, 0));
+    
+    TEST_ASSERT_FALSE(json_validate("\"\xc3\"", 4));              // Truncated sequence
+    TEST_ASSERT_FALSE(json_validate("\"\xc0\xaf\"", 5));          // Overlong
+    TEST_ASSERT_FALSE(json_validate("\"\xed\xa0\x80\"", 6));      // Surrogate
+    TEST_ASSERT_FALSE(json_validate("\"\xf4\x90\x80\x80\"", 7));  // Above U+10FFFF
+    TEST_ASSERT_FALSE(json_validate("\"\xff\"", 4));
+    TEST_ASSERT_FALSE(json_validate("\xc3\xa9", 2));                // Outside a string
+    
+    // Non-ASCII bytes in long strings cross the vector paths
+    char text[100];
+    memset(text, 'a', sizeof(text));
+    text[0] = '"';
+    text[98] = '"';
+    text[40] = (char)0xC3;
+    text[41] = (char)0xA9;
+    TEST_ASSERT_TRUE(json_validate(text, 99));
+    text[41] = 'a';
+    TEST_ASSERT_FALSE(json_validate(text, 99));
+}
+
+// Test UTF-8 checks at every position relative to the vector blocks, so
+// sequences start, end and break across block boundaries
+void test_validate_utf8_positions(void) {
+    const char *valid[] = {
+        "\xc2\x80", "\xdf\xbf", "\xe0\xa0\x80", "\xed\x9f\xbf", "\xef\xbf\xbf",
+        "\xf0\x90\x80\x80", "\xf4\x8f\xbf\xbf", "\xe4\xb8\xad\xe6\x96\x87"
+    };
+    const char *invalid[] = {
+        "\x80", "\xbf", "\xc0\x80", "\xc1\xbf", "\xc3", "\xc3\xc3\xa9", "\xe0\x9f\xbf",
+        "\xed\xa0\x80", "\xe4\xb8", "\xf0\x8f\xbf\xbf", "\xf4\x90\x80\x80", "\xf5\x80\x80\x80",
+        "\xf0\x9f\x98", "\xff", "\xc3\xa9\xa9"
+    };
+    char text[100];
+    
+    for (int at = 1; at < 60; at++) {
+        for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++) {
+            memset(text, 'a', sizeof(text));
+            text[0] = '"';
+            text[98] = '"';
+            memcpy(&text[at], valid[i], strlen(valid[i]));
+            TEST_ASSERT_TRUE(json_validate(text, 99));
+            
+            // Cut short by the closing quote
+            text[at + 1] = '"';
+            TEST_ASSERT_FALSE(json_validate(text, at + 2));
+        }
+        for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+            memset(text, 'a', sizeof(text));
+            text[0] = '"';
+            text[98] = '"';
+            memcpy(&text[at], invalid[i], strlen(invalid[i]));
+            TEST_ASSERT_FALSE(json_validate(text, 99));
+        }
+    }
+}
+
+// Scan text delivered in blocks of block_size bytes, carrying incomplete
+// tokens over; returns the final token and concatenates token texts
+static int scan_in_blocks(const char *text, size_t block_size, char *tokens_out) {
+    char buffer[256];
+    size_t length = 0;
+    size_t offset = 0;
+    size_t total = strlen(text);
+    json_scanner_t s;
+    int token;
+    
+    json_scanner_init(&s, "", 0);
+    tokens_out[0] = '\0';
+    
+    do {
+        size_t n = total - offset < block_size ? total - offset : block_size;
+        memcpy(buffer + length, text + offset, n);
+        length += n;
+        offset += n;
+        json_scanner_feed(&s, buffer, length, offset == total);
+        
+        while ((token = json_scanner_next(&s)) > 0) {
+            strncat(tokens_out, s.token, s.token_length);
+            strcat(tokens_out, " ");
+        }
+        
+        // Keep the unconsumed tail for the next block
+        length -= s.pos;
+        memmove(buffer, buffer + s.pos, length);
+    } while (token == JSON_TOKEN_INCOMPLETE);
+    
+    return token;
+}
+
+// Test that block boundaries anywhere give the same tokens as one buffer
+void test_scanner_incremental(void) {
+    const char *docs[] = {
+        "{\"key\": [12345, -6.5e-7, true, false, null], \"s\": \"a\\u00e9\\\"b\xc3\xa9\"}",
+        "  [ 1 , \"two\" , { } , [ ] ]  ",
+        "-0.25",
+        "[\"\\ud83d\\ude00\", \"\\ud83d\\u0041\"]",
+        "[\"\xe4\xb8\xad\xe6\x96\x87 long enough for a vector \xf0\x9f\x98\x80 and more \xc3\xa9\"]",
+        "[\"a vector's worth of text, then \xe4\xb8\"]",
+        "[1, tru]",
+        "[1 2]",
+        "\"unterminated"
+    };
+    
+    for (size_t d = 0; d < sizeof(docs) / sizeof(docs[0]); d++) {
+        char whole[256];
+        int expected = scan_in_blocks(docs[d], 1000, whole);
+        
+        for (size_t block = 1; block < 12; block++) {
+            char pieces[256];
+            TEST_ASSERT_EQUAL_INT(expected, scan_in_blocks(docs[d], block, pieces));
+            TEST_ASSERT_EQUAL_STRING(whole, pieces);
+        }
+    }
+}
+
+// Test the nesting limit
+void test_scanner_depth_limit(void) {
+    static char text[2 * (JSON_MAX_DEPTH + 1) + 1];
+    
+    memset(text, '[', JSON_MAX_DEPTH);
+    memset(text + JSON_MAX_DEPTH, ']', JSON_MAX_DEPTH);
+    text[2 * JSON_MAX_DEPTH] = '\0';
+    TEST_ASSERT_TRUE(scans_clean(text));
+    
+    memset(text, '[', JSON_MAX_DEPTH + 1);
+    memset(text + JSON_MAX_DEPTH + 1, ']', JSON_MAX_DEPTH + 1);
+    text[2 * (JSON_MAX_DEPTH + 1)] = '\0';
+    TEST_ASSERT_FALSE(scans_clean(text));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_scanner_tokens);
+    RUN_TEST(test_scanner_valid);
+    RUN_TEST(test_scanner_invalid);
+    RUN_TEST(test_scanner_surrogates);
+    RUN_TEST(test_validate);
+    RUN_TEST(test_validate_utf8_positions);
+    RUN_TEST(test_scanner_incremental);
+    RUN_TEST(test_scanner_depth_limit);
+    
+    return UNITY_END();
+}
@@ -0,0 +1,286 @@
+// tests/test_transcode.c
+#include "unity/unity.h"
+#include "../include/json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Collects transcoder output, binary or text
+static unsigned char output[131072];
+static size_t output_len;
+
+static int collect(void *ctx, const char *data, size_t len) {
+    (void)ctx;
+    if (output_len + len >= sizeof(output)) return -1;
+    memcpy(&output[output_len], data, len);
+    output_len += len;
+    output[output_len] = '\0';
+    return 0;
+}
+
+void setUp(void) {
+    output_len = 0;
+    output[0] = '\0';
+}
+
+void tearDown(void) {}
+
+static void assert_bytes(const unsigned char *expected, size_t len) {
+    TEST_ASSERT_EQUAL(len, output_len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, output, len);
+}
+
+// Test MessagePack for a small document, byte by byte
+void test_to_msgpack(void) {
+    const char *text = "{\"a\": [1, -1, true, null], \"b\": \"x\\n\"}";
+    const unsigned char expected[] = {
+        0x82, 0xa1, 'a', 0x94, 0x01, 0xff, 0xc3, 0xc0,
+        0xa1, 'b', 0xa2, 'x', '\n'
+    };
+    
+    TEST_ASSERT_EQUAL_INT(0, json_to_msgpack(text, strlen(text), collect, NULL));
+    assert_bytes(expected, sizeof(expected));
+}
+
+// Test CBOR for the same document
+void test_to_cbor(void) {
+    const char *text = "{\"a\": [1, -1, true, null], \"b\": \"x\\n\"}";
+    const unsigned char expected[] = {
+        0xa2, 0x61, 'a', 0x84, 0x01, 0x20, 0xf5, 0xf6,
+        0x61, 'b', 0x62, 'x', '\n'
+    };
+    
+    TEST_ASSERT_EQUAL_INT(0, json_to_cbor(text, strlen(text), collect, NULL));
+    assert_bytes(expected, sizeof(expected));
+}
+
+// Test that numbers take the smallest encoding and fractions stay doubles
+void test_number_encodings(void) {
+    const char *text = "[127, 128, -32, -33, 65536, -9223372036854775808, 18446744073709551615, 1.5, 1e2]";
+    const unsigned char msgpack[] = {
+        0x99, 0x7f, 0xcc, 0x80, 0xe0, 0xd0, 0xdf, 0xce, 0x00, 0x01, 0x00, 0x00,
+        0xd3, 0x80, 0, 0, 0, 0, 0, 0, 0,
+        0xcf, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xcb, 0x3f, 0xf8, 0, 0, 0, 0, 0, 0,
+        0xcb, 0x40, 0x59, 0, 0, 0, 0, 0, 0
+    };
+    const unsigned char cbor[] = {
+        0x89, 0x18, 0x7f, 0x18, 0x80, 0x38, 0x1f, 0x38, 0x20, 0x1a, 0x00, 0x01, 0x00, 0x00,
+        0x3b, 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0x1b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xfb, 0x3f, 0xf8, 0, 0, 0, 0, 0, 0,
+        0xfb, 0x40, 0x59, 0, 0, 0, 0, 0, 0
+    };
+    
+    TEST_ASSERT_EQUAL_INT(0, json_to_msgpack(text, strlen(text), collect, NULL));
+    assert_bytes(msgpack, sizeof(msgpack));
+    
+    output_len = 0;
+    TEST_ASSERT_EQUAL_INT(0, json_to_cbor(text, strlen(text), collect, NULL));
+    assert_bytes(cbor, sizeof(cbor));
+}
+
+// Test JSON -> binary -> JSON against the tree printer
+void test_round_trip(void) {
+    const char *text =
+        "{\"name\": \"caf\\u00e9 \\\"x\\\"\", \"list\": [0, -5, 3.25, 1e300, false, null, [], {}],"
+        " \"nested\": {\"deep\": [[[1]]], \"big\": 12345678901}, \"empty\": \"\"}";
+    static unsigned char binary[4096];
+    json_t *tree = json_parse(text);
+    char *expected = json_print_compact(tree);
+    
+    for (int cbor = 0; cbor <= 1; cbor++) {
+        output_len = 0;
+        int status = cbor ? json_to_cbor(text, strlen(text), collect, NULL)
+                          : json_to_msgpack(text, strlen(text), collect, NULL);
+        TEST_ASSERT_EQUAL_INT(0, status);
+        size_t binary_len = output_len;
+        memcpy(binary, output, binary_len);
+        
+        output_len = 0;
+        status = cbor ? json_from_cbor(binary, binary_len, collect, NULL, JSON_PRINT_COMPACT)
+                      : json_from_msgpack(binary, binary_len, collect, NULL, JSON_PRINT_COMPACT);
+        TEST_ASSERT_EQUAL_INT(0, status);
+        TEST_ASSERT_EQUAL_STRING(expected, (const char *)output);
+    }
+    
+    json_free(expected);
+    json_delete(tree);
+}
+
+// Test strings longer than the internal buffer and containers past 16 bits
+void test_large_values(void) {
+    size_t count = 70000;
+    char *text = malloc(count * 2 + 64);
+    size_t len = 0;
+    
+    text[len++] = '[';
+    for (size_t i = 0; i < count; i++) {
+        if (i) text[len++] = ',';
+        text[len++] = '0';
+    }
+    text[len++] = ']';
+    TEST_ASSERT_EQUAL_INT(0, json_to_msgpack(text, len, collect, NULL));
+    TEST_ASSERT_EQUAL(5 + count, output_len);
+    TEST_ASSERT_EQUAL_HEX8(0xdd, output[0]);
+    
+    len = 0;
+    text[len++] = '"';
+    memset(&text[len], 'y', 40000);
+    len += 40000;
+    text[len++] = '"';
+    output_len = 0;
+    TEST_ASSERT_EQUAL_INT(0, json_to_cbor(text, len, collect, NULL));
+    TEST_ASSERT_EQUAL(3 + 40000, output_len);
+    TEST_ASSERT_EQUAL_HEX8(0x79, output[0]);
+    TEST_ASSERT_EQUAL_HEX8('y', output[output_len - 1]);
+    
+    free(text);
+}
+
+// Test that invalid JSON fails before anything is written
+void test_invalid_json(void) {
+    const char *bad[] = { "[1, 2", "{\"a\" 1}", "[1,]", "\"\\x\"", "" };
+    
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        TEST_ASSERT_EQUAL_INT(-1, json_to_msgpack(bad[i], strlen(bad[i]), collect, NULL));
+        TEST_ASSERT_EQUAL_INT(-1, json_to_cbor(bad[i], strlen(bad[i]), collect, NULL));
+        TEST_ASSERT_EQUAL(0, output_len);
+    }
+}
+
+// Test MessagePack input that has no JSON form or is malformed
+void test_from_msgpack_errors(void) {
+    const unsigned char bin[] = { 0xc4, 0x01, 0x00 };
+    const unsigned char ext[] = { 0xd4, 0x01, 0x00 };
+    const unsigned char int_key[] = { 0x81, 0x01, 0x02 };
+    const unsigned char truncated[] = { 0x92, 0x01 };
+    const unsigned char short_string[] = { 0xa5, 'a', 'b' };
+    const unsigned char trailing[] = { 0x01, 0x02 };
+    const unsigned char huge[] = { 0xdd, 0xff, 0xff, 0xff, 0xff };
+    const unsigned char bad_utf8[] = { 0x91, 0xa2, 0xc3, 0x28 };
+    const unsigned char surrogate_key[] = { 0x81, 0xa3, 0xed, 0xa0, 0x80, 0x01 };
+    
+    TEST_ASSERT_EQUAL_INT(-1, json_from_msgpack(bin, sizeof(bin), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_msgpack(ext, sizeof(ext), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_msgpack(int_key, sizeof(int_key), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_msgpack(truncated, sizeof(truncated), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_msgpack(short_string, sizeof(short_string), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_msgpack(trailing, sizeof(trailing), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_msgpack(huge, sizeof(huge), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_msgpack(bad_utf8, sizeof(bad_utf8), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_msgpack(surrogate_key, sizeof(surrogate_key), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_msgpack(NULL, 0, collect, NULL, JSON_PRINT_COMPACT));
+}
+
+// Test MessagePack forms the encoder never produces
+void test_from_msgpack_other_forms(void) {
+    const unsigned char data[] = {
+        0x94, 0xd1, 0xff, 0x00, 0xca, 0x3f, 0xc0, 0x00, 0x00,
+        0xd9, 0x02, 'h', 'i', 0xdc, 0x00, 0x00
+    };
+    
+    TEST_ASSERT_EQUAL_INT(0, json_from_msgpack(data, sizeof(data), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_STRING("[-256,1.5,\"hi\",[]]", (const char *)output);
+}
+
+// Test CBOR forms the encoder never produces: open-ended containers and
+// text, half and single floats, tags, and 64-bit negatives
+void test_from_cbor_other_forms(void) {
+    const unsigned char data[] = {
+        0xbf, 0x61, 'a', 0x9f, 0xf9, 0x3e, 0x00, 0xfa, 0x3f, 0xc0, 0x00, 0x00, 0xff,
+        0x61, 'b', 0xc1, 0x1a, 0x00, 0x00, 0x00, 0x64,
+        0x61, 'c', 0x3b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0x7f, 0x62, 'k', 'e', 0x60, 0x61, 'y', 0xff,
+        0x7f, 0x63, 'a', '"', 'b', 0x78, 0x02, 0xc3, 0xa9, 0xff, 0xff
+    };
+    
+    TEST_ASSERT_EQUAL_INT(0, json_from_cbor(data, sizeof(data), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_STRING("{\"a\":[1.5,1.5],\"b\":100,\"c\":-1.8446744073709552e19,"
+                             "\"key\":\"a\\\"b\xc3\xa9\"}", (const char *)output);
+    
+    // Empty, and joined across more chunks than fit the first buffer
+    static unsigned char many[3 + 300 * 2];
+    size_t len = 0;
+    many[len++] = 0x81;
+    many[len++] = 0x7f;
+    for (int i = 0; i < 300; i++) {
+        many[len++] = 0x61;
+        many[len++] = (unsigned char)('a' + i % 26);
+    }
+    many[len++] = 0xff;
+    output_len = 0;
+    TEST_ASSERT_EQUAL_INT(0, json_from_cbor(many, len, collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_size_t(2 + 2 + 300, output_len);
+    TEST_ASSERT_EQUAL_MEMORY("[\"abc", output, 5);
+    
+    const unsigned char empty[] = { 0x7f, 0xff };
+    output_len = 0;
+    TEST_ASSERT_EQUAL_INT(0, json_from_cbor(empty, sizeof(empty), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_STRING("\"\"", (const char *)output);
+}
+
+// Test CBOR input that has no JSON form or is malformed
+void test_from_cbor_errors(void) {
+    const unsigned char bytes[] = { 0x41, 0x00 };
+    const unsigned char undefined[] = { 0xf7 };
+    const unsigned char bad_utf8[] = { 0x62, 0xe2, 0x82 };
+    const unsigned char split_char[] = { 0x7f, 0x61, 0xc3, 0x61, 0xa9, 0xff };
+    const unsigned char byte_chunk[] = { 0x7f, 0x41, 'a', 0xff };
+    const unsigned char nested_chunk[] = { 0x7f, 0x7f, 0xff, 0xff };
+    const unsigned char unclosed_text[] = { 0x7f, 0x61, 'a' };
+    const unsigned char open_integer[] = { 0x1f };
+    const unsigned char dangling_key[] = { 0xbf, 0x61, 'a', 0xff };
+    const unsigned char unclosed[] = { 0x9f, 0x01 };
+    const unsigned char stray_break[] = { 0x82, 0x01, 0xff };
+    const unsigned char trailing[] = { 0x80, 0x80 };
+    
+    TEST_ASSERT_EQUAL_INT(-1, json_from_cbor(bytes, sizeof(bytes), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_cbor(undefined, sizeof(undefined), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_cbor(bad_utf8, sizeof(bad_utf8), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_cbor(split_char, sizeof(split_char), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_cbor(byte_chunk, sizeof(byte_chunk), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_cbor(nested_chunk, sizeof(nested_chunk), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_cbor(unclosed_text, sizeof(unclosed_text), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_cbor(open_integer, sizeof(open_integer), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_cbor(dangling_key, sizeof(dangling_key), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_cbor(unclosed, sizeof(unclosed), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_cbor(stray_break, sizeof(stray_break), collect, NULL, JSON_PRINT_COMPACT));
+    TEST_ASSERT_EQUAL_INT(-1, json_from_cbor(trailing, sizeof(trailing), collect, NULL, JSON_PRINT_COMPACT));
+}
+
+// Test that pretty output matches json_print
+void test_from_binary_pretty(void) {
+    const char *text = "{\"a\": [1, {\"b\": null}], \"c\": {}}";
+    static unsigned char binary[256];
+    json_t *tree = json_parse(text);
+    char *expected = json_print(tree);
+    
+    TEST_ASSERT_EQUAL_INT(0, json_to_msgpack(text, strlen(text), collect, NULL));
+    size_t binary_len = output_len;
+    memcpy(binary, output, binary_len);
+    output_len = 0;
+    TEST_ASSERT_EQUAL_INT(0, json_from_msgpack(binary, binary_len, collect, NULL, JSON_PRINT_PRETTY));
+    TEST_ASSERT_EQUAL_STRING(expected, (const char *)output);
+    
+    json_free(expected);
+    json_delete(tree);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_to_msgpack);
+    RUN_TEST(test_to_cbor);
+    RUN_TEST(test_number_encodings);
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_large_values);
+    RUN_TEST(test_invalid_json);
+    RUN_TEST(test_from_msgpack_errors);
+    RUN_TEST(test_from_msgpack_other_forms);
+    RUN_TEST(test_from_cbor_other_forms);
+    RUN_TEST(test_from_cbor_errors);
+    RUN_TEST(test_from_binary_pretty);
+    
+    return UNITY_END();
+}
@@ -0,0 +1,177 @@
+// tests/test_writer.c
+#define _POSIX_C_SOURCE 200809L
+#include "unity/unity.h"
+#include "../include/json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Collects writer output so it can be compared
+static char output[4096];
+static size_t output_len;
+static int flush_count;
+
+static int collect(void *ctx, const char *data, size_t len) {
+    (void)ctx;
+    if (output_len + len >= sizeof(output)) return -1;
+    memcpy(&output[output_len], data, len);
+    output_len += len;
+    output[output_len] = '\0';
+    flush_count++;
+    return 0;
+}
+
+void setUp(void) {
+    output_len = 0;
+    output[0] = '\0';
+    flush_count = 0;
+}
+
+void tearDown(void) {}
+
+// Test a nested document in compact form
+void test_writer_compact(void) {
+    json_writer_t *w = json_writer_new(collect, NULL, 64, JSON_PRINT_COMPACT);
+    TEST_ASSERT_NOT_NULL(w);
+    
+    TEST_ASSERT_EQUAL_INT(0, json_writer_begin_object(w));
+    json_writer_key(w, "id");
+    json_writer_number(w, 7);
+    json_writer_key(w, "name");
+    json_writer_string(w, "a \"quoted\" name");
+    json_writer_key(w, "tags");
+    json_writer_begin_array(w);
+    json_writer_bool(w, 1);
+    json_writer_null(w);
+    json_writer_begin_object(w);
+    json_writer_end_object(w);
+    json_writer_end_array(w);
+    TEST_ASSERT_EQUAL_INT(0, json_writer_end_object(w));
+    TEST_ASSERT_EQUAL_INT(0, json_writer_flush(w));
+    
+    TEST_ASSERT_EQUAL_STRING("{\"id\":7,\"name\":\"a \\\"quoted\\\" name\",\"tags\":[true,null,{}]}", output);
+    json_writer_free(w);
+}
+
+// Test that pretty output matches json_print
+void test_writer_pretty_matches_print(void) {
+    json_writer_t *w = json_writer_new(collect, NULL, 64, JSON_PRINT_PRETTY);
+    
+    json_writer_begin_object(w);
+    json_writer_key(w, "list");
+    json_writer_begin_array(w);
+    json_writer_number(w, 1.5);
+    json_writer_string(w, "x");
+    json_writer_end_array(w);
+    json_writer_key(w, "empty");
+    json_writer_begin_array(w);
+    json_writer_end_array(w);
+    json_writer_end_object(w);
+    json_writer_flush(w);
+    json_writer_free(w);
+    
+    json_t *json = json_parse(output);
+    TEST_ASSERT_NOT_NULL(json);
+    char *printed = json_print(json);
+    TEST_ASSERT_EQUAL_STRING(printed, output);
+    
+    free(printed);
+    json_delete(json);
+}
+
+// Test that output larger than the buffer is flushed in pieces
+void test_writer_flushes_when_full(void) {
+    char long_string[300];
+    memset(long_string, 'x', sizeof(long_string));
+    
+    json_writer_t *w = json_writer_new(collect, NULL, 64, JSON_PRINT_COMPACT);
+    json_writer_begin_array(w);
+    for (int i = 0; i < 20; i++) {
+        json_writer_number(w, i);
+    }
+    json_writer_string_len(w, long_string, sizeof(long_string));
+    json_writer_end_array(w);
+    json_writer_flush(w);
+    json_writer_free(w);
+    
+    TEST_ASSERT_TRUE(flush_count > 1);
+    json_t *json = json_parse(output);
+    TEST_ASSERT_NOT_NULL(json);
+    TEST_ASSERT_EQUAL_INT(21, json_array_size(json));
+    TEST_ASSERT_EQUAL_INT(300, (int)strlen(json_array_get(json, 20)->valuestring));
+    json_delete(json);
+}
+
+// Test writing to a file descriptor
+void test_writer_fd(void) {
+    FILE *file = tmpfile();
+    TEST_ASSERT_NOT_NULL(file);
+    
+    json_writer_t *w = json_writer_new_fd(fileno(file), 64, JSON_PRINT_COMPACT);
+    json_writer_begin_array(w);
+    json_writer_string(w, "tab\there");
+    json_writer_end_array(w);
+    TEST_ASSERT_EQUAL_INT(0, json_writer_flush(w));
+    json_writer_free(w);
+    
+    char buf[64] = {0};
+    rewind(file);
+    size_t n = fread(buf, 1, sizeof(buf) - 1, file);
+    fclose(file);
+    
+    TEST_ASSERT_EQUAL_STRING("[\"tab\\there\"]", buf);
+    TEST_ASSERT_EQUAL_INT(13, (int)n);
+}
+
+// Test that a failing sink is reported
+void test_writer_sink_error(void) {
+    json_writer_t *w = json_writer_new(collect, NULL, 64, JSON_PRINT_COMPACT);
+    char big[sizeof(output)];
+    memset(big, 'y', sizeof(big));
+    
+    json_writer_begin_array(w);
+    json_writer_string_len(w, big, sizeof(big));
+    TEST_ASSERT_EQUAL_INT(-1, json_writer_end_array(w));
+    TEST_ASSERT_EQUAL_INT(-1, json_writer_flush(w));
+    json_writer_free(w);
+}
+
+#ifdef DEBUG
+// Test structural checks (debug builds only)
+void test_writer_structure_checks(void) {
+    json_writer_t *w = json_writer_new(collect, NULL, 64, JSON_PRINT_COMPACT);
+    json_writer_begin_object(w);
+    TEST_ASSERT_EQUAL_INT(-1, json_writer_number(w, 1));  // Value without key
+    json_writer_free(w);
+    
+    w = json_writer_new(collect, NULL, 64, JSON_PRINT_COMPACT);
+    json_writer_begin_array(w);
+    TEST_ASSERT_EQUAL_INT(-1, json_writer_key(w, "k"));  // Key in array
+    json_writer_free(w);
+    
+    w = json_writer_new(collect, NULL, 64, JSON_PRINT_COMPACT);
+    json_writer_begin_array(w);
+    TEST_ASSERT_EQUAL_INT(-1, json_writer_end_object(w));  // Mismatched end
+    json_writer_free(w);
+    
+    w = json_writer_new(collect, NULL, 64, JSON_PRINT_COMPACT);
+    json_writer_null(w);
+    TEST_ASSERT_EQUAL_INT(-1, json_writer_null(w));  // Second root value
+    json_writer_free(w);
+}
+#endif
+
+int main(void) {
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_writer_compact);
+    RUN_TEST(test_writer_pretty_matches_print);
+    RUN_TEST(test_writer_flushes_when_full);
+    RUN_TEST(test_writer_fd);
+    RUN_TEST(test_writer_sink_error);
+#ifdef DEBUG
+    RUN_TEST(test_writer_structure_checks);
+#endif
+    
+    return UNITY_END();
+}
@@ -123,76 +123,117 @@ passed=0
 total=0
 
 # Basic values
-test_json '"hello world"' "simple string" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '42' "positive integer" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '-123' "negative integer" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '3.14159' "decimal number" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json 'true' "boolean true" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json 'false' "boolean false" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json 'null' "null value" true; ((total++)); [ $? -eq 0 ] && ((passed++))
+test_json '"hello world"' "simple string" true && passed=$((passed+1)); total=$((total+1))
+test_json '42' "positive integer" true && passed=$((passed+1)); total=$((total+1))
+test_json '-123' "negative integer" true && passed=$((passed+1)); total=$((total+1))
+test_json '3.14159' "decimal number" true && passed=$((passed+1)); total=$((total+1))
+test_json 'true' "boolean true" true && passed=$((passed+1)); total=$((total+1))
+test_json 'false' "boolean false" true && passed=$((passed+1)); total=$((total+1))
+test_json 'null' "null value" true && passed=$((passed+1)); total=$((total+1))
 
 echo
 
 # Objects
-test_json '{}' "empty object" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '{"name": "John"}' "simple object" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '{"name": "John", "age": 30}' "multi-property object" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '{"name": "John", "age": 30, "active": true, "score": null}' "complex object" true; ((total++)); [ $? -eq 0 ] && ((passed++))
+test_json '{}' "empty object" true && passed=$((passed+1)); total=$((total+1))
+test_json '{"name": "John"}' "simple object" true && passed=$((passed+1)); total=$((total+1))
+test_json '{"name": "John", "age": 30}' "multi-property object" true && passed=$((passed+1)); total=$((total+1))
+test_json '{"name": "John", "age": 30, "active": true, "score": null}' "complex object" true && passed=$((passed+1)); total=$((total+1))
 
 echo
 
 # Arrays
-test_json '[]' "empty array" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '[1]' "single element array" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '[1, 2, 3, 4, 5]' "number array" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '["hello", "world"]' "string array" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '[1, "hello", true, null, false]' "mixed type array" true; ((total++)); [ $? -eq 0 ] && ((passed++))
+test_json '[]' "empty array" true && passed=$((passed+1)); total=$((total+1))
+test_json '[1]' "single element array" true && passed=$((passed+1)); total=$((total+1))
+test_json '[1, 2, 3, 4, 5]' "number array" true && passed=$((passed+1)); total=$((total+1))
+test_json '["hello", "world"]' "string array" true && passed=$((passed+1)); total=$((total+1))
+test_json '[1, "hello", true, null, false]' "mixed type array" true && passed=$((passed+1)); total=$((total+1))
 
 echo
 
 # Nested structures
-test_json '{"users": ["John", "Jane"]}' "object with array" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '[{"name": "John"}, {"name": "Jane"}]' "array of objects" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '{"data": {"users": [{"name": "John", "active": true}]}}' "deeply nested" true; ((total++)); [ $? -eq 0 ] && ((passed++))
+test_json '{"users": ["John", "Jane"]}' "object with array" true && passed=$((passed+1)); total=$((total+1))
+test_json '[{"name": "John"}, {"name": "Jane"}]' "array of objects" true && passed=$((passed+1)); total=$((total+1))
+test_json '{"data": {"users": [{"name": "John", "active": true}]}}' "deeply nested" true && passed=$((passed+1)); total=$((total+1))
 
 echo
 
 # Real-world-ish examples
-test_json '{"id": 1, "name": "John Doe", "email": "john@example.com", "age": 30, "active": true}' "user object" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '{"products": [{"id": 1, "name": "Widget", "price": 19.99}, {"id": 2, "name": "Gadget", "price": 29.99}]}' "product catalog" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '{"config": {"debug": true, "timeout": 5000, "servers": ["srv1", "srv2", "srv3"]}}' "configuration object" true; ((total++)); [ $? -eq 0 ] && ((passed++))
+test_json '{"id": 1, "name": "John Doe", "email": "john@example.com", "age": 30, "active": true}' "user object" true && passed=$((passed+1)); total=$((total+1))
+test_json '{"products": [{"id": 1, "name": "Widget", "price": 19.99}, {"id": 2, "name": "Gadget", "price": 29.99}]}' "product catalog" true && passed=$((passed+1)); total=$((total+1))
+test_json '{"config": {"debug": true, "timeout": 5000, "servers": ["srv1", "srv2", "srv3"]}}' "configuration object" true && passed=$((passed+1)); total=$((total+1))
 
 echo
 
 # Error cases - these should fail
 print_status "Testing error cases (should fail)..."
-test_json '' "empty string" false; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json 'invalid' "invalid literal" false; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '{"key": }' "missing value" false; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '{"key" "value"}' "missing colon" false; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '{"key": "value",}' "trailing comma in object" false; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '[1, 2,]' "trailing comma in array" false; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '{"key": "unclosed string}' "unclosed string" false; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '{unclosed object' "unclosed object" false; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '[unclosed array' "unclosed array" false; ((total++)); [ $? -eq 0 ] && ((passed++))
+test_json '' "empty string" false && passed=$((passed+1)); total=$((total+1))
+test_json 'invalid' "invalid literal" false && passed=$((passed+1)); total=$((total+1))
+test_json '{"key": }' "missing value" false && passed=$((passed+1)); total=$((total+1))
+test_json '{"key" "value"}' "missing colon" false && passed=$((passed+1)); total=$((total+1))
+test_json '{"key": "value",}' "trailing comma in object" false && passed=$((passed+1)); total=$((total+1))
+test_json '[1, 2,]' "trailing comma in array" false && passed=$((passed+1)); total=$((total+1))
+test_json '{"key": "unclosed string}' "unclosed string" false && passed=$((passed+1)); total=$((total+1))
+test_json '{unclosed object' "unclosed object" false && passed=$((passed+1)); total=$((total+1))
+test_json '[unclosed array' "unclosed array" false && passed=$((passed+1)); total=$((total+1))
 
 echo
 
 # Whitespace tolerance
 print_status "Testing whitespace tolerance..."
-test_json ' { "key" : "value" } ' "spaced object" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json ' [ 1 , 2 , 3 ] ' "spaced array" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json $'{\n  "name": "John",\n  "age": 30\n}' "multiline object" true; ((total++)); [ $? -eq 0 ] && ((passed++))
+test_json ' { "key" : "value" } ' "spaced object" true && passed=$((passed+1)); total=$((total+1))
+test_json ' [ 1 , 2 , 3 ] ' "spaced array" true && passed=$((passed+1)); total=$((total+1))
+test_json $'{\n  "name": "John",\n  "age": 30\n}' "multiline object" true && passed=$((passed+1)); total=$((total+1))
 
 echo
 
 # Edge cases
 print_status "Testing edge cases..."
-test_json '0' "zero" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '-0' "negative zero" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '""' "empty string" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '{}' "empty object" true; ((total++)); [ $? -eq 0 ] && ((passed++))
-test_json '[]' "empty array" true; ((total++)); [ $? -eq 0 ] && ((passed++))
+test_json '0' "zero" true && passed=$((passed+1)); total=$((total+1))
+test_json '-0' "negative zero" true && passed=$((passed+1)); total=$((total+1))
+test_json '""' "empty string" true && passed=$((passed+1)); total=$((total+1))
+test_json '{}' "empty object" true && passed=$((passed+1)); total=$((total+1))
+test_json '[]' "empty array" true && passed=$((passed+1)); total=$((total+1))
+
+# The default run parses leniently and -v validates strictly, so a
+# verdict cached by one mode must not answer the other
+test_cache_modes() {
+    local json="$1"
+    local description="$2"
+    local cache_dir=$(mktemp -d)
+    local file="$cache_dir/input.json"
+    local parsed validated result status=0
+    
+    echo -n "Testing cache modes with $description... "
+    printf '%s' "$json" > "$file"
+    ./build/json-parser "$file" >/dev/null 2>&1 && parsed=0 || parsed=1
+    ./build/json-parser -v "$file" >/dev/null 2>&1 && validated=0 || validated=1
+    # Parsing and validating apply the same grammar
+    [ $parsed -eq $validated ] || status=1
+    
+    # Fill the cache from each mode in turn, then ask the other one
+    for first in "" "-v"; do
+        rm -rf "$cache_dir/cache"
+        ./build/json-parser $first --cache "$cache_dir/cache" "$file" >/dev/null 2>&1 || true
+        ./build/json-parser --cache "$cache_dir/cache" "$file" >/dev/null 2>&1 && result=0 || result=1
+        [ $result -eq $parsed ] || status=1
+        ./build/json-parser -v --cache "$cache_dir/cache" "$file" >/dev/null 2>&1 && result=0 || result=1
+        [ $result -eq $validated ] || status=1
+    done
+    rm -rf "$cache_dir"
+    
+    if [ $status -eq 0 ]; then
+        echo -e "${GREEN}PASS${NC}"
+    else
+        echo -e "${RED}FAIL${NC} (the modes or their cached verdicts disagree)"
+    fi
+    return $status
+}
+
+print_status "Testing the parse cache..."
+test_cache_modes '1 2' "trailing content" && passed=$((passed+1)); total=$((total+1))
+test_cache_modes '01' "a leading zero" && passed=$((passed+1)); total=$((total+1))
+test_cache_modes $'"\xff"' "invalid UTF-8" && passed=$((passed+1)); total=$((total+1))
+test_cache_modes '{"key": [1, 2]}' "a valid document" && passed=$((passed+1)); total=$((total+1))
 
 echo
 echo "=================================================="
@@ -209,7 +250,7 @@ if [ $passed -eq $total ]; then
     # Show some example usage
     print_status "Example usage:"
     echo './build/json-parser file.json'
-    echo 'echo \'{"test": "data"}\' | ./build/json-parser -'
+    echo "echo '{\"test\": \"data\"}' | ./build/json-parser -"
     echo './build/json-parser -v file.json  # validation only'
     
     exit 0